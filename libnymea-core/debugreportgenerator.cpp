@@ -59,14 +59,19 @@ DebugReportGenerator::~DebugReportGenerator()
     cleanupReport();
 }
 
-QByteArray DebugReportGenerator::reportFileData() const
+QString DebugReportGenerator::reportFileName()
 {
-    return m_reportFileData;
+    return m_reportFileName;
 }
 
-QString DebugReportGenerator::reportFileName()
+QString DebugReportGenerator::reportFilePath() const
 {
-    return m_reportFileName;
+    return QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName;
+}
+
+qint64 DebugReportGenerator::reportFileSize() const
+{
+    return m_reportFileSize;
 }
 
 QString DebugReportGenerator::md5Sum() const
@@ -233,7 +238,7 @@ void DebugReportGenerator::saveEnv()
 
 void DebugReportGenerator::cleanupReport()
 {
-    QFile reportFile(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName);
+    QFile reportFile(reportFilePath());
     if (reportFile.exists()) {
         qCDebug(dcDebugServer()) << "Delete report file" << reportFile.fileName();
         if (!reportFile.remove()) {
@@ -326,17 +331,19 @@ void DebugReportGenerator::onCompressProcessFinished(int exitCode, QProcess::Exi
         qCWarning(dcDebugServer()) << "Could not delete report directory" << m_reportDirectory.path();
     }
 
-    // Read the file
-    QFile reportFile(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/" + m_reportFileName);
+    // Verify the file. It stays on disk and gets streamed from there when downloaded
+    QFile reportFile(reportFilePath());
     if (!reportFile.open(QIODevice::ReadOnly)) {
         qCWarning(dcDebugServer()) << "Could not open report file name for reading" << reportFile.fileName();
         m_isReady = true;
         m_isValid = false;
         emit finished(false);
     } else {
-        m_reportFileData = reportFile.readAll();
-        m_md5Sum =  QString::fromUtf8(QCryptographicHash::hash(m_reportFileData, QCryptographicHash::Md5).toHex());
-        qCDebug(dcDebugServer()) << "File generated successfully" << reportFile.fileName() << m_reportFileData.size() << "B" << m_md5Sum;
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(&reportFile);
+        m_reportFileSize = reportFile.size();
+        m_md5Sum =  QString::fromUtf8(hash.result().toHex());
+        qCDebug(dcDebugServer()) << "File generated successfully" << reportFile.fileName() << m_reportFileSize << "B" << m_md5Sum;
         m_isReady = true;
         m_isValid = true;
         emit finished(true);
@@ -44,8 +44,9 @@ public:
     explicit DebugReportGenerator(QObject *parent = nullptr);
     ~DebugReportGenerator();
 
-    QByteArray reportFileData() const;
     QString reportFileName();
+    QString reportFilePath() const;
+    qint64 reportFileSize() const;
     QString md5Sum() const;
 
     bool isReady() const;
@@ -62,7 +63,7 @@ private:
     QProcess *m_compressProcess = nullptr;
     QList<QProcess *> m_runningProcesses;
 
-    QByteArray m_reportFileData;
+    qint64 m_reportFileSize = 0;
     QString m_md5Sum;
 
     void copyFileToReportDirectory(const QString &fileName, const QString &subDirectory = QString());
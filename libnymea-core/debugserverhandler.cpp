@@ -35,6 +35,8 @@
 #include "loggingcategories.h"
 #include "debugserverhandler.h"
 #include "nymeaconfiguration.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+#include "logging/logengine.h"
 #include "stdio.h"
 #include "version.h"
 
@@ -48,6 +50,9 @@
 #include <QWebSocket>
 #include <QPair>
 #include <QHostInfo>
+#include <QTemporaryFile>
+#include <QPointer>
+#include <QDir>
 
 
 namespace nymeaserver {
@@ -78,31 +83,57 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
     // Check if this is a logdb requested
     if (requestPath.startsWith("/debug/logdb.sql")) {
         qCDebug(dcDebugServer()) << "Loading" << NymeaCore::instance()->configuration()->logDBName();
-        QFile logDatabaseFile(NymeaCore::instance()->configuration()->logDBName());
-        if (!logDatabaseFile.exists()) {
+        QFile *logDatabaseFile = new QFile(NymeaCore::instance()->configuration()->logDBName());
+        if (!logDatabaseFile->exists()) {
             qCWarning(dcDebugServer()) << "Could not read log database file for debug download" << NymeaCore::instance()->configuration()->logDBName() << "file does not exist.";
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
             //: The HTTP error message of the debug interface. The %1 represents the file name.
-            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(logDatabaseFile.fileName())));
+            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(logDatabaseFile->fileName())));
+            delete logDatabaseFile;
             return reply;
         }
 
-        if (!logDatabaseFile.open(QFile::ReadOnly)) {
-            qCWarning(dcDebugServer()) << "Could not read log database file for debug download" << NymeaCore::instance()->configuration()->logDBName();
-            HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
-            reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
-            //: The HTTP error message of the debug interface. The %1 represents the file name.
-            reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(logDatabaseFile.fileName())));
-            return reply;
-        }
+        delete logDatabaseFile;
 
-        QByteArray logDatabaseRawData = logDatabaseFile.readAll();
-        logDatabaseFile.close();
+        // The database is written while it is being sent, so a consistent copy is made by the
+        // log engine and sent instead. The copy is deleted once it has been sent.
+        QTemporaryFile snapshotFile(QDir::tempPath() + "/nymea-logdb-XXXXXX.sqlite");
+        snapshotFile.setAutoRemove(false);
+        if (!snapshotFile.open()) {
+            qCWarning(dcDebugServer()) << "Could not create temporary file for the log database download:" << snapshotFile.errorString();
+            return HttpReply::createErrorReply(HttpReply::InternalServerError);
+        }
+        snapshotFile.close();
+
+        QPointer<HttpReply> reply = HttpReply::createAsyncReply();
+        DatabaseSnapshotJob *job = NymeaCore::instance()->logEngine()->createSnapshot(snapshotFile.fileName());
+        connect(job, &DatabaseSnapshotJob::finished, this, [this, job, reply](){
+            QFile *snapshot = new QFile(job->fileName());
+            if (!reply) {
+                // Timed out meanwhile
+                snapshot->remove();
+                delete snapshot;
+                return;
+            }
+            if (!job->success() || !snapshot->open(QFile::ReadOnly)) {
+                qCWarning(dcDebugServer()) << "Could not create a copy of the log database for debug download";
+                snapshot->remove();
+                delete snapshot;
+                reply->setHttpStatusCode(HttpReply::InternalServerError);
+                reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
+                //: The HTTP error message of the debug interface.
+                reply->setPayload(createErrorXmlDocument(HttpReply::InternalServerError, tr("Could not create a copy of the log database.")));
+                reply->finished();
+                return;
+            }
 
-        HttpReply *reply = HttpReply::createSuccessReply();
-        reply->setHeader(HttpReply::ContentTypeHeader, "application/sql");
-        reply->setPayload(logDatabaseRawData);
+            // The open file stays readable until it is closed after sending it
+            QFile::remove(snapshot->fileName());
+            reply->setHeader(HttpReply::ContentTypeHeader, "application/sql");
+            reply->setPayloadDevice(snapshot, snapshot->size());
+            reply->finished();
+        });
         return reply;
     }
 
@@ -111,29 +142,29 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
     if (requestPath.startsWith("/debug/syslog")) {
         QString syslogFileName = "/var/log/syslog";
         qCDebug(dcDebugServer()) << "Loading" << syslogFileName;
-        QFile syslogFile(syslogFileName);
-        if (!syslogFile.exists()) {
+        QFile *syslogFile = new QFile(syslogFileName);
+        if (!syslogFile->exists()) {
             qCWarning(dcDebugServer()) << "Could not read log database file for debug download" << syslogFileName << "file does not exist.";
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
             reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not find file \"%1\".").arg(syslogFileName)));
+            delete syslogFile;
             return reply;
         }
 
-        if (!syslogFile.open(QFile::ReadOnly)) {
+        if (!syslogFile->open(QFile::ReadOnly)) {
             qCWarning(dcDebugServer()) << "Could not read syslog file for debug download" << syslogFileName;
             HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
             reply->setHeader(HttpReply::ContentTypeHeader, "text/html");
             reply->setPayload(createErrorXmlDocument(HttpReply::NotFound, tr("Could not open file \"%1\".").arg(syslogFileName)));
+            delete syslogFile;
             return reply;
         }
 
-        QByteArray syslogFileData = syslogFile.readAll();
-        syslogFile.close();
-
+        // The syslog keeps growing while it is sent, only the current size will be sent
         HttpReply *reply = HttpReply::createSuccessReply();
         reply->setHeader(HttpReply::ContentTypeHeader, "text/plain");
-        reply->setPayload(syslogFileData);
+        reply->setPayloadDevice(syslogFile, syslogFile->size());
         return reply;
     }
 
@@ -494,9 +525,16 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
 
             }
 
+            QFile *reportFile = new QFile(m_debugReportGenerator->reportFilePath());
+            if (!reportFile->open(QFile::ReadOnly)) {
+                qCWarning(dcDebugServer()) << "Could not open debug report file" << reportFile->fileName() << reportFile->errorString();
+                delete reportFile;
+                return HttpReply::createErrorReply(HttpReply::NotFound);
+            }
+
             // Everything looks good, send the requested debug report
             HttpReply *downloadReportReply = HttpReply::createSuccessReply();
-            downloadReportReply->setPayload(m_debugReportGenerator->reportFileData());
+            downloadReportReply->setPayloadDevice(reportFile, reportFile->size());
             downloadReportReply->setHeader(HttpReply::ContentTypeHeader, "application/tar+gzip;");
             return downloadReportReply;
         } else {
@@ -520,7 +558,7 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
                         // Success, the debug report is ready and valid
                         QVariantMap reportInformation;
                         reportInformation.insert("fileName", m_debugReportGenerator->reportFileName());
-                        reportInformation.insert("fileSize", m_debugReportGenerator->reportFileData().size());
+                        reportInformation.insert("fileSize", m_debugReportGenerator->reportFileSize());
                         reportInformation.insert("md5sum", m_debugReportGenerator->md5Sum());
 
                         HttpReply * httpReply = HttpReply::createSuccessReply();
@@ -990,6 +1028,17 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
     writer.writeTextElement("td", JSON_PROTOCOL_VERSION);
     writer.writeEndElement(); // tr
 
+    JsonValidator::Statistics validationStatistics = NymeaCore::instance()->jsonRPCServer()->validationStatistics();
+    writer.writeStartElement("tr");
+    //: The JSON-RPC validation statistics description in the server infromation section of the debug interface
+    writer.writeTextElement("th", tr("JSON-RPC validation"));
+    writer.writeTextElement("td", tr("%1 messages validated, %2 invalid, %3 µs average, replies %4")
+                            .arg(validationStatistics.validations)
+                            .arg(validationStatistics.failures)
+                            .arg(validationStatistics.validations > 0 ? validationStatistics.totalTime / validationStatistics.validations / 1000 : 0)
+                            .arg(NymeaCore::instance()->jsonRPCServer()->replyValidationEnabled() ? tr("validated") : tr("not validated")));
+    writer.writeEndElement(); // tr
+
     writer.writeStartElement("tr");
     //: The language description in the server infromation section of the debug interface
     writer.writeTextElement("th", tr("Language"));
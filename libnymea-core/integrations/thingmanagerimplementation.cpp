@@ -77,6 +77,10 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
         m_supportedInterfaces.insert(interface.name(), interface);
     }
 
+    m_thingStatesSyncTimer.setSingleShot(true);
+    m_thingStatesSyncTimer.setInterval(10000);
+    connect(&m_thingStatesSyncTimer, &QTimer::timeout, this, &ThingManagerImplementation::syncThingStates);
+
     // Migrate config from devices.conf (<0.20) to things.conf
     QString settingsPath = NymeaSettings::settingsPath();
     if (QFile::exists(settingsPath + "/devices.conf") && !QFile::exists(settingsPath + "/things.conf")) {
@@ -100,10 +104,8 @@ ThingManagerImplementation::~ThingManagerImplementation()
 {
     delete m_translator;
 
-    foreach (Thing *thing, m_configuredThings) {
-        storeThingStates(thing);
-        delete thing;
-    }
+    syncThingStates();
+    qDeleteAll(m_configuredThings);
 
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
         if (plugin->parent() == this) {
@@ -645,7 +647,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
 
             if (addNewThing) {
                 qCDebug(dcThingManager()) << "Thing added:" << info->thing();
-                m_configuredThings.insert(info->thing()->id(), info->thing());
+                addToConfiguredThings(info->thing());
                 emit thingAdded(info->thing());
                 connect(info->thing(), &Thing::eventTriggered, this, &ThingManagerImplementation::onEventTriggered);
             } else {
@@ -727,7 +729,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
         info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
 
         qCDebug(dcThingManager) << "Thing setup complete.";
-        m_configuredThings.insert(info->thing()->id(), info->thing());
+        addToConfiguredThings(info->thing());
         storeConfiguredThings();
 
         emit thingAdded(info->thing());
@@ -740,7 +742,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
 
 Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingId &thingId)
 {
-    Thing *thing = m_configuredThings.take(thingId);
+    Thing *thing = takeFromConfiguredThings(thingId);
     if (!thing) {
         return Thing::ThingErrorThingNotFound;
     }
@@ -759,6 +761,7 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
     settings.remove("");
     settings.endGroup();
 
+    m_dirtyThingStates.remove(thingId);
     NymeaSettings stateCache(NymeaSettings::SettingsRoleThingStates);
     stateCache.remove(thingId.toString());
 
@@ -1126,12 +1129,7 @@ Vendor ThingManagerImplementation::translateVendor(const Vendor &vendor, const Q
 
 Thing *ThingManagerImplementation::findConfiguredThing(const ThingId &id) const
 {
-    foreach (Thing *thing, m_configuredThings) {
-        if (thing->id() == id) {
-            return thing;
-        }
-    }
-    return nullptr;
+    return m_configuredThings.value(id);
 }
 
 Things ThingManagerImplementation::configuredThings() const
@@ -1141,46 +1139,36 @@ Things ThingManagerImplementation::configuredThings() const
 
 Things ThingManagerImplementation::findConfiguredThings(const ThingClassId &thingClassId) const
 {
-    QList<Thing*> ret;
-    foreach (Thing *thing, m_configuredThings) {
-        if (thing->thingClassId() == thingClassId) {
-            ret << thing;
-        }
-    }
-    return ret;
+    return m_thingClassThings.value(thingClassId);
 }
 
 Things ThingManagerImplementation::findConfiguredThings(const QString &interface) const
 {
-    QList<Thing*> ret;
-    foreach (Thing *thing, m_configuredThings) {
-        ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
-        if (thingClass.interfaces().contains(interface)) {
-            ret.append(thing);
-        }
-    }
-    return ret;
+    return m_interfaceThings.value(interface);
 }
 
 Things ThingManagerImplementation::findChilds(const ThingId &id) const
 {
-    QList<Thing *> ret;
-    foreach (Thing *d, m_configuredThings) {
-        if (d->parentId() == id) {
-            ret.append(d);
-        }
-    }
-    return ret;
+    return m_childThings.value(id);
 }
 
 ThingClass ThingManagerImplementation::findThingClass(const ThingClassId &thingClassId) const
 {
-    foreach (const ThingClass &thingClass, m_supportedThings) {
-        if (thingClass.id() == thingClassId) {
-            return thingClass;
-        }
+    return supportedThingClass(thingClassId);
+}
+
+/*! Returns the supported ThingClass with the given \a thingClassId without copying it, or an invalid
+    ThingClass if there is no such thing class. The reference points into the supported thing classes
+    and is only valid until plugins are loaded again. Don't keep it beyond the current call.
+*/
+const ThingClass &ThingManagerImplementation::supportedThingClass(const ThingClassId &thingClassId) const
+{
+    static const ThingClass invalidThingClass;
+    QHash<ThingClassId, ThingClass>::const_iterator it = m_supportedThings.constFind(thingClassId);
+    if (it == m_supportedThings.constEnd()) {
+        return invalidThingClass;
     }
-    return ThingClass();
+    return it.value();
 }
 
 ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
@@ -1202,7 +1190,7 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
     }
 
     // Make sure this thing has an action type with this id
-    ThingClass thingClass = findThingClass(thing->thingClassId());
+    const ThingClass &thingClass = supportedThingClass(thing->thingClassId());
     ActionType actionType = thingClass.actionTypes().findById(action.actionTypeId());
     if (actionType.id().isNull()) {
         qCWarning(dcThingManager()) << "Cannot execute action. No such action type" << action.actionTypeId();
@@ -1559,7 +1547,7 @@ void ThingManagerImplementation::loadConfiguredThings()
         // We always add the thing to the list in this case. If it's in the stored things
         // it means that it was working at some point so lets still add it as there might
         // be rules associated with this thing.
-        m_configuredThings.insert(thing->id(), thing);
+        addToConfiguredThings(thing);
 
         emit thingAdded(thing);
 
@@ -1710,7 +1698,7 @@ void ThingManagerImplementation::onAutoThingsAppeared(const ThingDescriptors &th
             }
 
             info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
-            m_configuredThings.insert(info->thing()->id(), info->thing());
+            addToConfiguredThings(info->thing());
             storeConfiguredThings();
 
             emit thingAdded(info->thing());
@@ -1790,7 +1778,15 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
         qCWarning(dcThingManager()) << "Invalid thing id in state change. Not forwarding event. Thing setup not complete yet?";
         return;
     }
-    storeThingStates(thing);
+
+    const ThingClass &thingClass = supportedThingClass(thing->thingClassId());
+    int stateTypeIndex = thingClass.stateTypeIndex(stateTypeId);
+    if (stateTypeIndex >= 0 && thingClass.stateTypes().at(stateTypeIndex).cached()) {
+        m_dirtyThingStates.insert(thing->id());
+        if (!m_thingStatesSyncTimer.isActive()) {
+            m_thingStatesSyncTimer.start();
+        }
+    }
 
     emit thingStateChanged(thing, stateTypeId, value);
 
@@ -2041,8 +2037,14 @@ void ThingManagerImplementation::postSetupThing(Thing *thing)
 void ThingManagerImplementation::loadThingStates(Thing *thing)
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+
+    // Newer values may still wait for the sync timer, don't roll them back to the stored ones
+    if (m_dirtyThingStates.remove(thing->id())) {
+        storeThingStates(settings, thing);
+    }
+
     settings.beginGroup(thing->id().toString());
-    ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
+    const ThingClass &thingClass = supportedThingClass(thing->thingClassId());
     foreach (const StateType &stateType, thingClass.stateTypes()) {
         if (stateType.cached()) {
             QVariant value;
@@ -2119,11 +2121,70 @@ QVariant ThingManagerImplementation::mapValue(const QVariant &value, const State
     return toValue;
 }
 
-void ThingManagerImplementation::storeThingStates(Thing *thing)
+void ThingManagerImplementation::addToConfiguredThings(Thing *thing)
+{
+    if (m_configuredThings.contains(thing->id())) {
+        takeFromConfiguredThings(thing->id());
+    }
+    m_configuredThings.insert(thing->id(), thing);
+
+    m_thingClassThings[thing->thingClassId()].append(thing);
+    foreach (const QString &interface, m_supportedThings.value(thing->thingClassId()).interfaces()) {
+        m_interfaceThings[interface].append(thing);
+    }
+    if (!thing->parentId().isNull()) {
+        m_childThings[thing->parentId()].append(thing);
+    }
+}
+
+Thing *ThingManagerImplementation::takeFromConfiguredThings(const ThingId &thingId)
 {
+    Thing *thing = m_configuredThings.take(thingId);
+    if (!thing) {
+        return nullptr;
+    }
+
+    m_thingClassThings[thing->thingClassId()].removeAll(thing);
+    if (m_thingClassThings.value(thing->thingClassId()).isEmpty()) {
+        m_thingClassThings.remove(thing->thingClassId());
+    }
+    foreach (const QString &interface, m_supportedThings.value(thing->thingClassId()).interfaces()) {
+        m_interfaceThings[interface].removeAll(thing);
+        if (m_interfaceThings.value(interface).isEmpty()) {
+            m_interfaceThings.remove(interface);
+        }
+    }
+    if (!thing->parentId().isNull()) {
+        m_childThings[thing->parentId()].removeAll(thing);
+        if (m_childThings.value(thing->parentId()).isEmpty()) {
+            m_childThings.remove(thing->parentId());
+        }
+    }
+    return thing;
+}
+
+void ThingManagerImplementation::syncThingStates()
+{
+    m_thingStatesSyncTimer.stop();
+    if (m_dirtyThingStates.isEmpty()) {
+        return;
+    }
+
+    qCDebug(dcThingManager()) << "Storing cached states of" << m_dirtyThingStates.count() << "things";
     NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
+    foreach (const ThingId &thingId, m_dirtyThingStates) {
+        Thing *thing = m_configuredThings.value(thingId);
+        if (thing) {
+            storeThingStates(settings, thing);
+        }
+    }
+    m_dirtyThingStates.clear();
+}
+
+void ThingManagerImplementation::storeThingStates(NymeaSettings &settings, Thing *thing)
+{
     settings.beginGroup(thing->id().toString());
-    ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
+    const ThingClass &thingClass = supportedThingClass(thing->thingClassId());
     foreach (const StateType &stateType, thingClass.stateTypes()) {
         if (stateType.cached()) {
             settings.beginGroup(stateType.id().toString());
@@ -59,6 +59,7 @@ class IntegrationPlugin;
 class ThingPairingInfo;
 class HardwareManager;
 class Translator;
+class NymeaSettings;
 
 class ThingManagerImplementation: public ThingManager
 {
@@ -88,6 +89,7 @@ public:
     Things findConfiguredThings(const QString &interface) const override;
     Things findChilds(const ThingId &id) const override;
     ThingClass findThingClass(const ThingClassId &thingClassId) const override;
+    const ThingClass &supportedThingClass(const ThingClassId &thingClassId) const;
 
     ThingDiscoveryInfo* discoverThings(const ThingClassId &thingClassId, const ParamList &params) override;
 
@@ -139,6 +141,7 @@ private slots:
     void onAutoThingDisappeared(const ThingId &thingId);
     void onLoaded();
     void cleanupThingStateCache();
+    void syncThingStates();
     void onEventTriggered(const Event &event);
 
     // Only connect this to Things. It will query the sender()
@@ -155,7 +158,9 @@ private:
     ThingSetupInfo *reconfigureThingInternal(Thing *thing, const ParamList &params, const QString &name = QString());
     ThingSetupInfo *setupThing(Thing *thing);
     void postSetupThing(Thing *thing);
-    void storeThingStates(Thing *thing);
+    void addToConfiguredThings(Thing *thing);
+    Thing *takeFromConfiguredThings(const ThingId &thingId);
+    void storeThingStates(NymeaSettings &settings, Thing *thing);
     void loadThingStates(Thing *thing);
     void storeIOConnections();
     void loadIOConnections();
@@ -173,8 +178,17 @@ private:
     QHash<VendorId, QList<ThingClassId> > m_vendorThingMap;
     QHash<ThingClassId, ThingClass> m_supportedThings;
     QHash<ThingId, Thing*> m_configuredThings;
+    // Secondary indexes of m_configuredThings, kept up to date by addToConfiguredThings() and takeFromConfiguredThings()
+    QHash<ThingClassId, QList<Thing*> > m_thingClassThings;
+    QHash<QString, QList<Thing*> > m_interfaceThings;
+    QHash<ThingId, QList<Thing*> > m_childThings;
     QHash<ThingDescriptorId, ThingDescriptor> m_discoveredThings;
 
+    // Cached states are written behind: Things with changed cached states are collected
+    // and stored together when the timer fires or on shutdown.
+    QSet<ThingId> m_dirtyThingStates;
+    QTimer m_thingStatesSyncTimer;
+
     QHash<PluginId, IntegrationPlugin*> m_integrationPlugins;
 
     class PairingContext {
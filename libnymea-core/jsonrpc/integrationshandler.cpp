@@ -95,23 +95,42 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     browserItem.insert("o:mediaIcon", enumRef<MediaBrowserItem::MediaBrowserIcon>());
     registerObject("BrowserItem", browserItem);
 
+    QVariantMap stateChange;
+    stateChange.insert("thingId", enumValueName(Uuid));
+    stateChange.insert("stateTypeId", enumValueName(Uuid));
+    stateChange.insert("value", enumValueName(Variant));
+    registerObject("StateChange", stateChange);
+
 
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
-    description = "Returns a list of supported Vendors.";
-    returns.insert("vendors", objectRef<Vendors>());
+    description = "Returns a list of supported Vendors. The reply contains an etag identifying the returned list. "
+                  "If ifNoneMatch is given and matches the current etag, the list is omitted and notModified is set.";
+    params.insert("o:ifNoneMatch", enumValueName(String));
+    returns.insert("o:vendors", objectRef<Vendors>());
+    returns.insert("o:etag", enumValueName(String));
+    returns.insert("o:notModified", enumValueName(Bool));
     registerMethod("GetVendors", description, params, returns);
 
     params.clear(); returns.clear();
-    description = "Returns a list of supported thing classes, optionally filtered by vendorId.";
+    description = "Returns a list of supported thing classes, optionally filtered by vendorId. If no vendorId is given, "
+                  "the reply contains an etag identifying the returned list. If ifNoneMatch is given and matches the "
+                  "current etag, the list is omitted and notModified is set.";
     params.insert("o:vendorId", enumValueName(Uuid));
+    params.insert("o:ifNoneMatch", enumValueName(String));
     returns.insert("thingError", enumRef<Thing::ThingError>());
     returns.insert("o:thingClasses", objectRef<ThingClasses>());
+    returns.insert("o:etag", enumValueName(String));
+    returns.insert("o:notModified", enumValueName(Bool));
     registerMethod("GetThingClasses", description, params, returns);
 
     params.clear(); returns.clear();
-    description = "Returns a list of loaded plugins.";
-    returns.insert("plugins", objectRef<IntegrationPlugins>());
+    description = "Returns a list of loaded plugins. The reply contains an etag identifying the returned list. "
+                  "If ifNoneMatch is given and matches the current etag, the list is omitted and notModified is set.";
+    params.insert("o:ifNoneMatch", enumValueName(String));
+    returns.insert("o:plugins", objectRef<IntegrationPlugins>());
+    returns.insert("o:etag", enumValueName(String));
+    returns.insert("o:notModified", enumValueName(Bool));
     registerMethod("GetPlugins", description, params, returns);
 
     params.clear(); returns.clear();
@@ -381,6 +400,13 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
     params.insert("value", enumValueName(Variant));
     registerNotification("StateChanged", description, params);
 
+    params.clear(); returns.clear();
+    description = "Emitted instead of StateChanged to connections which enabled \"batchStateChanges\" in their "
+                  "notification filter (see JSONRPC.SetNotificationFilter). Contains the latest value of each state "
+                  "which changed within the coalescing interval.";
+    params.insert("stateChanges", QVariantList() << objectRef("StateChange"));
+    registerNotification("StateChangedBatch", description, params);
+
     params.clear(); returns.clear();
     description = "Emitted whenever a thing was removed.";
     params.insert("thingId", enumValueName(Uuid));
@@ -439,6 +465,9 @@ IntegrationsHandler::IntegrationsHandler(ThingManager *thingManager, QObject *pa
         emit IOConnectionRemoved(params);
     });
 
+    // Vendors, thing classes and plugins are known once all plugins are loaded
+    connect(NymeaCore::instance(), &NymeaCore::initialized, this, &IntegrationsHandler::clearReplyCache);
+
     connect(NymeaCore::instance(), &NymeaCore::pluginConfigChanged, this, &IntegrationsHandler::pluginConfigChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingStateChanged, this, &IntegrationsHandler::thingStateChanged);
     connect(NymeaCore::instance(), &NymeaCore::thingRemoved, this, &IntegrationsHandler::thingRemovedNotification);
@@ -454,40 +483,49 @@ QString IntegrationsHandler::name() const
 
 JsonReply* IntegrationsHandler::GetVendors(const QVariantMap &params, const JsonContext &context) const
 {
-    Q_UNUSED(params)
-    QVariantList vendors;
-    foreach (const Vendor &vendor, NymeaCore::instance()->thingManager()->supportedVendors()) {
-        Vendor translatedVendor = NymeaCore::instance()->thingManager()->translateVendor(vendor, context.locale());
-        vendors.append(pack(translatedVendor));
-    }
+    return createCachedReply("GetVendors", params, context.locale(), [this, context](){
+        QVariantList vendors;
+        foreach (const Vendor &vendor, NymeaCore::instance()->thingManager()->supportedVendors()) {
+            Vendor translatedVendor = NymeaCore::instance()->thingManager()->translateVendor(vendor, context.locale());
+            vendors.append(pack(translatedVendor));
+        }
 
-    QVariantMap returns;
-    returns.insert("vendors", vendors);
-    return createReply(returns);
+        QVariantMap returns;
+        returns.insert("vendors", vendors);
+        return returns;
+    });
 }
 
 JsonReply* IntegrationsHandler::GetThingClasses(const QVariantMap &params, const JsonContext &context) const
 {
-    QVariantMap returns;
-    QVariantList thingClasses;
+    if (!params.contains("vendorId")) {
+        return createCachedReply("GetThingClasses", params, context.locale(), [this, context](){
+            QVariantList thingClasses;
+            foreach (const ThingClass &thingClass, NymeaCore::instance()->thingManager()->supportedThings()) {
+                ThingClass translatedThingClass = NymeaCore::instance()->thingManager()->translateThingClass(thingClass, context.locale());
+                thingClasses.append(pack(translatedThingClass));
+            }
 
-    if (params.contains("vendorId")) {
-        VendorId vendorId = VendorId(params.value("vendorId").toString());
-        if (m_thingManager->supportedVendors().findById(vendorId).id().isNull()) {
-            qCWarning(dcThingManager()) << "No such vendor:" << vendorId;
-            return createReply(statusToReply(Thing::ThingErrorVendorNotFound));
-        }
-        foreach (const ThingClass &thingClass, NymeaCore::instance()->thingManager()->supportedThings(vendorId)) {
-            ThingClass translatedThingClass = NymeaCore::instance()->thingManager()->translateThingClass(thingClass, context.locale());
-            thingClasses.append(pack(translatedThingClass));
-        }
-    } else {
-        foreach (const ThingClass &thingClass, NymeaCore::instance()->thingManager()->supportedThings()) {
-            ThingClass translatedThingClass = NymeaCore::instance()->thingManager()->translateThingClass(thingClass, context.locale());
-            thingClasses.append(pack(translatedThingClass));
-        }
+            QVariantMap returns;
+            returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
+            returns.insert("thingClasses", thingClasses);
+            return returns;
+        });
+    }
+
+    VendorId vendorId = VendorId(params.value("vendorId").toString());
+    if (m_thingManager->supportedVendors().findById(vendorId).id().isNull()) {
+        qCWarning(dcThingManager()) << "No such vendor:" << vendorId;
+        return createReply(statusToReply(Thing::ThingErrorVendorNotFound));
+    }
+
+    QVariantList thingClasses;
+    foreach (const ThingClass &thingClass, NymeaCore::instance()->thingManager()->supportedThings(vendorId)) {
+        ThingClass translatedThingClass = NymeaCore::instance()->thingManager()->translateThingClass(thingClass, context.locale());
+        thingClasses.append(pack(translatedThingClass));
     }
 
+    QVariantMap returns;
     returns.insert("thingError", enumValueName(Thing::ThingErrorNoError));
     returns.insert("thingClasses", thingClasses);
     return createReply(returns);
@@ -529,17 +567,18 @@ JsonReply *IntegrationsHandler::DiscoverThings(const QVariantMap &params, const
 
 JsonReply* IntegrationsHandler::GetPlugins(const QVariantMap &params, const JsonContext &context) const
 {
-    Q_UNUSED(params)
-    QVariantList plugins;
-    foreach (IntegrationPlugin* plugin, NymeaCore::instance()->thingManager()->plugins()) {
-        QVariantMap packedPlugin = pack(*plugin).toMap();
-        packedPlugin["displayName"] = NymeaCore::instance()->thingManager()->translate(plugin->pluginId(), plugin->pluginDisplayName(), context.locale());
-        plugins.append(packedPlugin);
-    }
+    return createCachedReply("GetPlugins", params, context.locale(), [this, context](){
+        QVariantList plugins;
+        foreach (IntegrationPlugin* plugin, NymeaCore::instance()->thingManager()->plugins()) {
+            QVariantMap packedPlugin = pack(*plugin).toMap();
+            packedPlugin["displayName"] = NymeaCore::instance()->thingManager()->translate(plugin->pluginId(), plugin->pluginDisplayName(), context.locale());
+            plugins.append(packedPlugin);
+        }
 
-    QVariantMap returns;
-    returns.insert("plugins", plugins);
-    return createReply(returns);
+        QVariantMap returns;
+        returns.insert("plugins", plugins);
+        return returns;
+    });
 }
 
 JsonReply *IntegrationsHandler::GetPluginConfiguration(const QVariantMap &params) const
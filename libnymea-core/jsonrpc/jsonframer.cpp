@@ -0,0 +1,156 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::JsonFramer
+    \brief Splits a stream of data into JSON messages.
+
+    \ingroup server
+    \inmodule core
+
+    The JsonFramer collects the data received from a client and returns each complete top level JSON
+    object or array as soon as its closing bracket arrives. It tracks the nesting depth and whether the
+    current position is inside of a string, so brackets in string values do not end a message and data
+    which has been scanned once is never scanned again. Data between messages which does not
+    start an object or array is dropped, so it does not end up in front of the next message.
+*/
+
+#include "jsonframer.h"
+
+namespace nymeaserver {
+
+/*! Constructs a JsonFramer which accepts incomplete messages of up to \a maxMessageSize bytes. */
+JsonFramer::JsonFramer(int maxMessageSize):
+    m_maxMessageSize(maxMessageSize)
+{
+
+}
+
+/*! Returns the maximum size of a message which has not been received completely. */
+int JsonFramer::maxMessageSize() const
+{
+    return m_maxMessageSize;
+}
+
+/*! Sets the maximum size of a message which has not been received completely to \a maxMessageSize. */
+void JsonFramer::setMaxMessageSize(int maxMessageSize)
+{
+    m_maxMessageSize = maxMessageSize;
+}
+
+/*! Appends the received \a data and adds all messages which are complete now to \a messages.
+    Returns false if the pending incomplete message, or the data dropped since the last message,
+    exceeds maxMessageSize().
+*/
+bool JsonFramer::append(const QByteArray &data, QList<QByteArray> *messages)
+{
+    m_buffer.append(data);
+    m_discarded = 0;
+
+    int start = 0;
+    const char *buffer = m_buffer.constData();
+    for (int i = m_scanned; i < m_buffer.size(); i++) {
+        char c = buffer[i];
+
+        if (m_inString) {
+            if (m_escaped) {
+                m_escaped = false;
+            } else if (c == '\\') {
+                m_escaped = true;
+            } else if (c == '"') {
+                m_inString = false;
+            }
+            continue;
+        }
+
+        // Between messages, only the start of an object or array is expected
+        if (m_depth == 0 && c != '{' && c != '[') {
+            if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                m_discarded++;
+                m_discardedSinceMessage++;
+            }
+            start = i + 1;
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            m_inString = true;
+            break;
+        case '{':
+        case '[':
+            if (m_depth == 0) {
+                m_discardedSinceMessage = 0;
+            }
+            m_depth++;
+            break;
+        case '}':
+        case ']':
+            if (m_depth > 0 && --m_depth == 0) {
+                messages->append(m_buffer.mid(start, i + 1 - start));
+                start = i + 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    m_buffer.remove(0, start);
+    m_scanned = m_buffer.size();
+
+    return m_buffer.size() <= m_maxMessageSize && m_discardedSinceMessage <= m_maxMessageSize;
+}
+
+/*! Returns the size of the data which does not belong to a complete message yet. */
+int JsonFramer::pendingSize() const
+{
+    return m_buffer.size();
+}
+
+/*! Returns the number of bytes the last call to append() dropped because they were not part of a message. Whitespace is not counted. */
+int JsonFramer::discardedSize() const
+{
+    return m_discarded;
+}
+
+/*! Drops all pending data. */
+void JsonFramer::clear()
+{
+    m_buffer.clear();
+    m_scanned = 0;
+    m_depth = 0;
+    m_inString = false;
+    m_escaped = false;
+    m_discarded = 0;
+    m_discardedSinceMessage = 0;
+}
+
+}
@@ -0,0 +1,67 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONFRAMER_H
+#define JSONFRAMER_H
+
+#include <QByteArray>
+#include <QList>
+
+namespace nymeaserver {
+
+class JsonFramer
+{
+public:
+    JsonFramer(int maxMessageSize = 10 * 1024);
+
+    int maxMessageSize() const;
+    void setMaxMessageSize(int maxMessageSize);
+
+    bool append(const QByteArray &data, QList<QByteArray> *messages);
+    int pendingSize() const;
+    int discardedSize() const;
+    void clear();
+
+private:
+    QByteArray m_buffer;
+    int m_maxMessageSize;
+
+    // Scanner state, kept between calls so every byte is only looked at once
+    int m_scanned = 0;
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escaped = false;
+    int m_discarded = 0;
+    int m_discardedSinceMessage = 0;
+};
+
+}
+
+#endif // JSONFRAMER_H
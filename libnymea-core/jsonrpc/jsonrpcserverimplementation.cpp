@@ -76,7 +76,12 @@
 
 #include <QJsonDocument>
 #include <QStringList>
+#include <QtEndian>
 #include <QSslConfiguration>
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborMap>
+#endif
 
 namespace nymeaserver {
 
@@ -86,12 +91,23 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     m_notificationId(0)
 {
     Q_UNUSED(sslConfiguration)
+
+    // Validating replies and notifications is only a sanity check for the API implementation.
+    // It is enabled by default in debug builds and can be toggled with NYMEA_JSONRPC_VALIDATE_REPLIES.
+#ifdef QT_NO_DEBUG
+    m_replyValidationEnabled = qgetenv("NYMEA_JSONRPC_VALIDATE_REPLIES") == "1";
+#else
+    m_replyValidationEnabled = qgetenv("NYMEA_JSONRPC_VALIDATE_REPLIES") != "0";
+#endif
+
     // First, define our own JSONRPC API
 
     // Enums
     registerEnum<BasicType>();
     registerEnum<UserManager::UserError>();
     registerEnum<CloudManager::CloudConnectionState>();
+    registerEnum<MessageEncoding>();
+    registerEnum<MessageCompression>();
 
     // Objects
     registerObject<TokenInfo>();
@@ -101,6 +117,15 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     experiece.insert("version", enumValueName(String));
     registerObject("Experience", experiece);
 
+    QVariantMap notificationFilter;
+    notificationFilter.insert("o:thingIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:interfaces", QVariantList() << enumValueName(String));
+    notificationFilter.insert("o:stateTypeIds", QVariantList() << enumValueName(Uuid));
+    notificationFilter.insert("o:minValueChange", enumValueName(Double));
+    notificationFilter.insert("o:coalescingInterval", enumValueName(Uint));
+    notificationFilter.insert("o:batchStateChanges", enumValueName(Bool));
+    registerObject("NotificationFilter", notificationFilter);
+
     // Methods
     QString description; QVariantMap returns; QVariantMap params;
     description = "Initiates a connection. Use this method to perform an initial handshake of the "
@@ -111,8 +136,23 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
                             "about this core instance such as version information, uuid and its name. The locale value"
                             "indicates the locale used for this connection. Note: This method can be called multiple "
                             "times. The locale used in the last call for this connection will be used. Other values, "
-                            "like initialSetupRequired might change if the setup has been performed in the meantime.";
+                            "like initialSetupRequired might change if the setup has been performed in the meantime. "
+                            "The optional parameter \"encoding\" can be used to switch this connection to CBOR encoded "
+                            "messages. The reply to this call is still sent in the previous encoding, all following "
+                            "messages in both directions use the encoding given in the reply. CBOR messages are sent "
+                            "with a 32 bit big endian length prefix on TCP connections and as binary messages on "
+                            "WebSocket connections. If a transport does not support binary messages, JSON is kept. "
+                            "The optional parameter \"compression\" can be used to compress the messages of this connection "
+                            "in the same way. Compressed messages are sent as binary messages starting with a flag byte: "
+                            "0 if the encoded message follows uncompressed, 1 if a 32 bit big endian length of the encoded "
+                            "message follows, followed by the zlib compressed message. Small messages are not compressed. "
+                            "If a transport does not support binary messages, no compression is used. "
+                            "The etags returned by methods supporting the \"ifNoneMatch\" parameter are listed in "
+                            "\"etags\" by method name. Clients which already have the data for a listed etag don't "
+                            "need to fetch it again.";
     params.insert("o:locale", enumValueName(String));
+    params.insert("o:encoding", enumRef<MessageEncoding>());
+    params.insert("o:compression", enumRef<MessageCompression>());
     returns.insert("server", enumValueName(String));
     returns.insert("name", enumValueName(String));
     returns.insert("version", enumValueName(String));
@@ -123,14 +163,21 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("initialSetupRequired", enumValueName(Bool));
     returns.insert("authenticationRequired", enumValueName(Bool));
     returns.insert("pushButtonAuthAvailable", enumValueName(Bool));
+    returns.insert("encoding", enumRef<MessageEncoding>());
+    returns.insert("compression", enumRef<MessageCompression>());
     returns.insert("o:experiences", QVariantList() << objectRef("Experience"));
+    returns.insert("etags", enumValueName(Object));
     registerMethod("Hello", description, params, returns);
 
     params.clear(); returns.clear();
-    description = "Introspect this API.";
-    returns.insert("methods", enumValueName(Object));
-    returns.insert("notifications", enumValueName(Object));
-    returns.insert("types", enumValueName(Object));
+    description = "Introspect this API. The reply contains an etag identifying the returned API. If ifNoneMatch "
+                  "is given and matches the current etag, the API is omitted and notModified is set.";
+    params.insert("o:ifNoneMatch", enumValueName(String));
+    returns.insert("o:methods", enumValueName(Object));
+    returns.insert("o:notifications", enumValueName(Object));
+    returns.insert("o:types", enumValueName(Object));
+    returns.insert("o:etag", enumValueName(String));
+    returns.insert("o:notModified", enumValueName(Bool));
     registerMethod("Introspect", description, params, returns);
 
     params.clear(); returns.clear();
@@ -156,6 +203,22 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     returns.insert("d:enabled", enumValueName(Bool));
     registerMethod("SetNotificationStatus", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Limit the notifications about things sent to this connection. Notifications which refer to a thing "
+                  "are only sent if the thing is listed in \"thingIds\" and implements at least one of the given "
+                  "\"interfaces\". State changes are additionally only sent for the given \"stateTypeIds\" and, "
+                  "if \"minValueChange\" is given, numeric values are only sent if they differ by at least this "
+                  "amount from the last value sent to this connection. If \"coalescingInterval\" is given, state "
+                  "changes are collected for this amount of milliseconds and only the latest value of each state "
+                  "is sent, if \"batchStateChanges\" is true in a single Integrations.StateChangedBatch notification. "
+                  "Connections which do not read their data fast enough get coalesced state changes automatically. "
+                  "Omitted or empty entries do not restrict "
+                  "notifications. Calling this method without a filter removes the filter. The filter is applied "
+                  "in addition to the namespaces enabled with SetNotificationStatus. Returns the filter in use.";
+    params.insert("o:filter", objectRef("NotificationFilter"));
+    returns.insert("filter", objectRef("NotificationFilter"));
+    registerMethod("SetNotificationFilter", description, params, returns);
+
     params.clear(); returns.clear();
     description = "Create a new user in the API. Currently this is only allowed to be called once when a new nymea instance is set up. Call Authenticate after this to obtain a device token for this user.";
     params.insert("username", enumValueName(String));
@@ -253,6 +316,7 @@ JsonRPCServerImplementation::JsonRPCServerImplementation(const QSslConfiguration
     QMetaObject::invokeMethod(this, "setup", Qt::QueuedConnection);
 
     connect(NymeaCore::instance()->userManager(), &UserManager::pushButtonAuthFinished, this, &JsonRPCServerImplementation::onPushButtonAuthFinished);
+    connect(NymeaCore::instance()->userManager(), &UserManager::tokenRemoved, this, &JsonRPCServerImplementation::onTokenRemoved);
 }
 
 /*! Returns the \e namespace of \l{JsonHandler}. */
@@ -271,6 +335,30 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
         m_clientLocales.insert(clientId, QLocale(params.value("locale").toString()));
     }
 
+    if (params.contains("encoding")) {
+        MessageEncoding encoding = enumNameToValue<MessageEncoding>(params.value("encoding").toString());
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+        if (encoding == MessageEncodingCbor) {
+            qCDebug(dcJsonRpc()) << "CBOR encoding requires Qt 5.12. Keeping JSON encoding for client" << clientId;
+            encoding = MessageEncodingJson;
+        }
+#endif
+        if (encoding == MessageEncodingCbor && !interface->binaryModeSupported()) {
+            qCDebug(dcJsonRpc()) << "Transport does not support binary messages. Keeping JSON encoding for client" << clientId;
+            encoding = MessageEncodingJson;
+        }
+        m_pendingEncodings.insert(clientId, encoding);
+    }
+
+    if (params.contains("compression")) {
+        MessageCompression compression = enumNameToValue<MessageCompression>(params.value("compression").toString());
+        if (compression != MessageCompressionNone && !interface->binaryModeSupported()) {
+            qCDebug(dcJsonRpc()) << "Transport does not support binary messages. Not compressing messages for client" << clientId;
+            compression = MessageCompressionNone;
+        }
+        m_pendingCompressions.insert(clientId, compression);
+    }
+
     qCDebug(dcJsonRpc()) << "Client" << clientId << "initiated handshake." << m_clientLocales.value(clientId);
 
     // If we waited for the handshake, here it is. Remove the timer...
@@ -278,13 +366,20 @@ JsonReply *JsonRPCServerImplementation::Hello(const QVariantMap &params, const J
         delete m_newConnectionWaitTimers.take(clientId);
     }
 
-    return createReply(createWelcomeMessage(interface, clientId));
+    QVariantMap welcomeMessage = createWelcomeMessage(interface, clientId);
+    QVariantMap etags;
+    foreach (JsonHandler *handler, m_handlers) {
+        etags.unite(handler->replyETags(m_clientLocales.value(clientId)));
+    }
+    welcomeMessage.insert("etags", etags);
+    return createReply(welcomeMessage);
 }
 
-JsonReply* JsonRPCServerImplementation::Introspect(const QVariantMap &params) const
+JsonReply* JsonRPCServerImplementation::Introspect(const QVariantMap &params, const JsonContext &context) const
 {
-    Q_UNUSED(params)
-    return createReply(m_api);
+    return createCachedReply("Introspect", params, context.locale(), [this](){
+        return m_api;
+    });
 }
 
 JsonReply* JsonRPCServerImplementation::Version(const QVariantMap &params) const
@@ -326,6 +421,23 @@ JsonReply* JsonRPCServerImplementation::SetNotificationStatus(const QVariantMap
     return createReply(returns);
 }
 
+JsonReply *JsonRPCServerImplementation::SetNotificationFilter(const QVariantMap &params, const JsonContext &context)
+{
+    QUuid clientId = context.clientId();
+
+    NotificationFilter filter = NotificationFilter::fromMap(params.value("filter").toMap());
+    if (filter.isEmpty()) {
+        m_clientNotificationFilters.remove(clientId);
+    } else {
+        m_clientNotificationFilters.insert(clientId, filter);
+    }
+    qCDebug(dcJsonRpc()) << "Notification filter for client" << clientId << ":" << filter.toMap();
+
+    QVariantMap returns;
+    returns.insert("filter", filter.toMap());
+    return createReply(returns);
+}
+
 JsonReply *JsonRPCServerImplementation::CreateUser(const QVariantMap &params)
 {
     QString username = params.value("username").toString();
@@ -476,6 +588,60 @@ void JsonRPCServerImplementation::unregisterTransportInterface(TransportInterfac
     m_interfaces.take(interface);
 }
 
+/*! Returns the maximum size in bytes of a JSON-RPC message which has not been received completely. */
+int JsonRPCServerImplementation::maxMessageSize() const
+{
+    return m_maxMessageSize;
+}
+
+/*! Sets the maximum size of a JSON-RPC message which has not been received completely to \a maxMessageSize bytes.
+    Clients exceeding this limit will be disconnected.
+*/
+void JsonRPCServerImplementation::setMaxMessageSize(int maxMessageSize)
+{
+    m_maxMessageSize = maxMessageSize;
+    for (QHash<QUuid, JsonFramer>::iterator it = m_clientFramers.begin(); it != m_clientFramers.end(); ++it) {
+        it.value().setMaxMessageSize(maxMessageSize);
+    }
+}
+
+/*! Sets the zlib compression \a level used for clients which negotiated compressed messages. Messages
+    smaller than \a threshold bytes are sent uncompressed.
+*/
+void JsonRPCServerImplementation::setCompression(int level, int threshold)
+{
+    m_compressionLevel = level;
+    m_compressionThreshold = threshold;
+}
+
+/*! Returns whether replies and notifications are validated against the API before they are sent. */
+bool JsonRPCServerImplementation::replyValidationEnabled() const
+{
+    return m_replyValidationEnabled;
+}
+
+/*! Enables or disables the validation of replies and notifications. Requests are always validated. */
+void JsonRPCServerImplementation::setReplyValidationEnabled(bool enabled)
+{
+    m_replyValidationEnabled = enabled;
+}
+
+/*! Returns the send queue statistics of all connected clients. */
+QHash<QUuid, SendQueue::Statistics> JsonRPCServerImplementation::sendQueueStatistics() const
+{
+    QHash<QUuid, SendQueue::Statistics> statistics;
+    for (QHash<QUuid, TransportInterface*>::const_iterator it = m_clientTransports.constBegin(); it != m_clientTransports.constEnd(); ++it) {
+        statistics.insert(it.key(), it.value()->sendQueueStatistics(it.key()));
+    }
+    return statistics;
+}
+
+/*! Returns the statistics of the JSON-RPC validator. */
+JsonValidator::Statistics JsonRPCServerImplementation::validationStatistics() const
+{
+    return m_validator.statistics();
+}
+
 bool JsonRPCServerImplementation::registerExperienceHandler(JsonHandler *handler, int majorVersion, int minorVersion)
 {
     bool ret = registerHandler(handler);
@@ -499,9 +665,7 @@ void JsonRPCServerImplementation::sendResponse(TransportInterface *interface, co
         response.insert("deprecationWarning", deprecationWarning);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendMessage(interface, clientId, response);
 }
 
 /*! Send a JSON error response to the client with the given \a clientId,
@@ -514,9 +678,7 @@ void JsonRPCServerImplementation::sendErrorResponse(TransportInterface *interfac
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    interface->sendData(clientId, data);
+    sendMessage(interface, clientId, errorResponse);
 }
 
 void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error)
@@ -526,11 +688,53 @@ void JsonRPCServerImplementation::sendUnauthorizedResponse(TransportInterface *i
     errorResponse.insert("status", "unauthorized");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
+    sendMessage(interface, clientId, errorResponse);
+}
+
+void JsonRPCServerImplementation::sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
+    // While a batch is processed, replies are collected and sent together in flushBatchReplies()
+    if (m_batchReplies.contains(clientId)) {
+        m_batchReplies[clientId].append(message);
+        return;
+    }
+
+    QByteArray data = encodeMessage(message, m_clientEncodings.value(clientId), m_clientCompressions.value(clientId));
     qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
     interface->sendData(clientId, data);
 }
 
+void JsonRPCServerImplementation::flushBatchReplies(TransportInterface *interface, const QUuid &clientId)
+{
+    if (!m_batchReplies.contains(clientId)) {
+        return;
+    }
+
+    QVariantList replies = m_batchReplies.take(clientId);
+    if (!replies.isEmpty()) {
+        QByteArray data = encodeMessage(replies, m_clientEncodings.value(clientId), m_clientCompressions.value(clientId));
+        qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
+        interface->sendData(clientId, data);
+    }
+
+    // The batch may have contained a JSONRPC.Hello call
+    applyPendingEncoding(interface, clientId);
+}
+
+void JsonRPCServerImplementation::applyPendingEncoding(TransportInterface *interface, const QUuid &clientId)
+{
+    if (!m_pendingEncodings.contains(clientId) && !m_pendingCompressions.contains(clientId)) {
+        return;
+    }
+    if (m_pendingEncodings.contains(clientId)) {
+        m_clientEncodings.insert(clientId, m_pendingEncodings.take(clientId));
+    }
+    if (m_pendingCompressions.contains(clientId)) {
+        m_clientCompressions.insert(clientId, m_pendingCompressions.take(clientId));
+    }
+    interface->setBinaryMode(clientId, m_clientEncodings.value(clientId) == MessageEncodingCbor || m_clientCompressions.value(clientId) != MessageCompressionNone);
+}
+
 QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface *interface, const QUuid &clientId) const
 {
     QVariantMap handshake;
@@ -545,6 +749,8 @@ QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface
     handshake.insert("initialSetupRequired", (interface->configuration().authenticationEnabled ? NymeaCore::instance()->userManager()->initRequired() : false));
     handshake.insert("authenticationRequired", interface->configuration().authenticationEnabled);
     handshake.insert("pushButtonAuthAvailable", NymeaCore::instance()->userManager()->pushButtonAuthAvailable());
+    handshake.insert("encoding", enumValueName(m_pendingEncodings.value(clientId, m_clientEncodings.value(clientId))));
+    handshake.insert("compression", enumValueName(m_pendingCompressions.value(clientId, m_clientCompressions.value(clientId))));
     if (!m_experiences.isEmpty()) {
         QVariantList experiences;
         foreach (JsonHandler* handler, m_experiences.keys()) {
@@ -558,6 +764,54 @@ QVariantMap JsonRPCServerImplementation::createWelcomeMessage(TransportInterface
     return handshake;
 }
 
+QByteArray JsonRPCServerImplementation::encodeMessage(const QVariant &message, MessageEncoding encoding, MessageCompression compression) const
+{
+    QByteArray data;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (encoding == MessageEncodingCbor) {
+        data = QCborValue::fromVariant(message).toCbor();
+    } else
+#else
+    Q_UNUSED(encoding)
+#endif
+    {
+        data = QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact);
+    }
+
+    if (compression == MessageCompressionNone) {
+        return data;
+    }
+
+    // Flag byte followed by the message, qCompress() prefixes the zlib stream with the uncompressed size
+    if (data.size() < m_compressionThreshold) {
+        return data.prepend('\0');
+    }
+    return qCompress(data, m_compressionLevel).prepend('\1');
+}
+
+bool JsonRPCServerImplementation::decompressMessage(const QByteArray &data, QByteArray *message) const
+{
+    if (data.isEmpty()) {
+        return false;
+    }
+    if (data.at(0) == '\0') {
+        *message = data.mid(1);
+        return true;
+    }
+    if (data.at(0) != '\1' || data.size() < 5) {
+        return false;
+    }
+
+    // Don't let a small message inflate to an arbitrary size
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + 1));
+    if (size > static_cast<quint32>(m_maxDecompressedSize)) {
+        qCWarning(dcJsonRpc()) << "Compressed message announces" << size << "bytes. Maximum is" << m_maxDecompressedSize;
+        return false;
+    }
+    *message = qUncompress(reinterpret_cast<const uchar*>(data.constData() + 1), data.size() - 1);
+    return !message->isEmpty();
+}
+
 void JsonRPCServerImplementation::setup()
 {
     registerHandler(this);
@@ -584,40 +838,111 @@ void JsonRPCServerImplementation::processData(const QUuid &clientId, const QByte
 
     TransportInterface *interface = qobject_cast<TransportInterface *>(sender());
 
+    // Binary messages are already framed by the transport
+    if (m_clientCompressions.value(clientId) != MessageCompressionNone) {
+        QByteArray message;
+        if (!decompressMessage(data, &message)) {
+            qCWarning(dcJsonRpc()) << "Failed to decompress message from client" << clientId;
+            sendErrorResponse(interface, clientId, -1, "Failed to decompress message");
+            return;
+        }
+        processJsonPacket(interface, clientId, message);
+        return;
+    }
+    if (m_clientEncodings.value(clientId) == MessageEncodingCbor) {
+        processJsonPacket(interface, clientId, data);
+        return;
+    }
+
     // Handle packet fragmentation
-    QByteArray buffer = m_clientBuffers[clientId];
-    buffer.append(data);
-    int splitIndex = buffer.indexOf("}\n{");
-    while (splitIndex > -1) {
-        processJsonPacket(interface, clientId, buffer.left(splitIndex + 1));
-        buffer = buffer.right(buffer.length() - splitIndex - 2);
-        splitIndex = buffer.indexOf("}\n{");
-    }
-    if (buffer.trimmed().endsWith("}")) {
-        processJsonPacket(interface, clientId, buffer);
-        buffer.clear();
-    }
-    m_clientBuffers[clientId] = buffer;
-
-    if (buffer.size() > 1024 * 10) {
-        qCWarning(dcJsonRpc()) << "Client buffer larger than 10KB and no valid data. Dropping client connection.";
+    QList<QByteArray> messages;
+    if (!m_clientFramers.contains(clientId)) {
+        m_clientFramers.insert(clientId, JsonFramer(m_maxMessageSize));
+    }
+    bool bufferValid = m_clientFramers[clientId].append(data, &messages);
+
+    if (m_clientFramers[clientId].discardedSize() > 0) {
+        qCWarning(dcJsonRpc()) << "Dropped" << m_clientFramers[clientId].discardedSize() << "bytes of unexpected data between messages from client" << clientId;
+        sendErrorResponse(interface, clientId, -1, "Failed to parse JSON data: unexpected data between messages");
+    }
+
+    foreach (const QByteArray &message, messages) {
+        processJsonPacket(interface, clientId, message);
+        // Processing a message may have ended the connection
+        if (!m_clientTransports.contains(clientId)) {
+            return;
+        }
+    }
+
+    if (!bufferValid) {
+        qCWarning(dcJsonRpc()) << "Client buffer larger than" << m_maxMessageSize << "bytes and no valid data. Dropping client connection.";
+        m_clientFramers[clientId].clear();
         interface->terminateClientConnection(clientId);
     }
 }
 
 void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data)
 {
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+    QVariant message;
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+    if (m_clientEncodings.value(clientId) == MessageEncodingCbor) {
+        QCborParserError error;
+        QCborValue value = QCborValue::fromCbor(data, &error);
+        if (error.error != QCborError::NoError) {
+            qCWarning(dcJsonRpc) << "Failed to parse CBOR data" << data.toHex() << ":" << error.errorString();
+            sendErrorResponse(interface, clientId, -1, QString("Failed to parse CBOR data: %1").arg(error.errorString()));
+            return;
+        }
+        message = value.toVariant();
+    } else
+#endif
+    {
+        QJsonParseError error;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+
+        if(error.error != QJsonParseError::NoError) {
+            qCWarning(dcJsonRpc) << "Failed to parse JSON data" << data << ":" << error.errorString();
+            sendErrorResponse(interface, clientId, -1, QString("Failed to parse JSON data: %1").arg(error.errorString()));
+            return;
+        }
+
+        message = jsonDoc.toVariant();
+    }
+
+    if (message.type() == QVariant::List) {
+        processBatch(interface, clientId, message.toList());
+    } else {
+        processRequest(interface, clientId, message.toMap());
+    }
+}
 
-    if(error.error != QJsonParseError::NoError) {
-        qCWarning(dcJsonRpc) << "Failed to parse JSON data" << data << ":" << error.errorString();
-        sendErrorResponse(interface, clientId, -1, QString("Failed to parse JSON data: %1").arg(error.errorString()));
+/*! Process a batch of requests sent as one array. All requests are dispatched in order and the replies
+    to synchronous calls are sent back in a single array. Replies to asynchronous calls are sent on their
+    own whenever they finish.
+*/
+void JsonRPCServerImplementation::processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &requests)
+{
+    if (requests.isEmpty()) {
+        qCWarning(dcJsonRpc()) << "Received an empty batch request from client" << clientId;
+        sendErrorResponse(interface, clientId, -1, "Invalid batch request: No requests");
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
+    qCDebug(dcJsonRpc()) << "Processing batch of" << requests.count() << "requests from client" << clientId;
 
+    m_batchReplies.insert(clientId, QVariantList());
+    foreach (const QVariant &request, requests) {
+        processRequest(interface, clientId, request.toMap());
+        // The batch is flushed early if the connection is being dropped
+        if (!m_batchReplies.contains(clientId)) {
+            return;
+        }
+    }
+    flushBatchReplies(interface, clientId);
+}
+
+void JsonRPCServerImplementation::processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message)
+{
     bool success;
     int commandId = message.value("id").toInt(&success);
     if (!success) {
@@ -642,17 +967,19 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         QStringList authExemptMethodsWithUser = {"JSONRPC.Introspect", "JSONRPC.Hello", "JSONRPC.Authenticate", "JSONRPC.RequestPushButtonAuth", "Users.Authenticate", "Users.RequestPushButtonAuth"};
         // if there is no user in the system yet, let's fail unless this is special method for authentication itself
         if (NymeaCore::instance()->userManager()->initRequired()) {
-            if (!authExemptMethodsNoUser.contains(targetNamespace + "." + method) && (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token))) {
+            if (!authExemptMethodsNoUser.contains(targetNamespace + "." + method) && !verifyClientToken(clientId, token)) {
                 sendUnauthorizedResponse(interface, clientId, commandId, "Initial setup required. Call Users.CreateUser first.");
                 qCWarning(dcJsonRpc()) << "Initial setup required but client does not call the setup. Dropping connection.";
+                flushBatchReplies(interface, clientId);
                 interface->terminateClientConnection(clientId);
                 return;
             }
         } else {
             // ok, we have a user. if there isn't a valid token, let's fail unless this is a Authenticate, Introspect  Hello call
-            if (!authExemptMethodsWithUser.contains(targetNamespace + "." + method) && (token.isEmpty() || !NymeaCore::instance()->userManager()->verifyToken(token))) {
+            if (!authExemptMethodsWithUser.contains(targetNamespace + "." + method) && !verifyClientToken(clientId, token)) {
                 sendUnauthorizedResponse(interface, clientId, commandId, "Forbidden: Invalid token.");
                 qCWarning(dcJsonRpc()) << "Client did not not present a valid token. Dropping connection.";
+                flushBatchReplies(interface, clientId);
                 interface->terminateClientConnection(clientId);
                 return;
             }
@@ -674,9 +1001,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
     QVariantMap params = message.value("params").toMap();
 
-    QVariantMap definition = handler->jsonMethods().value(method).toMap().value("params").toMap();
-    JsonValidator validator;
-    JsonValidator::Result validationResult = validator.validateParams(params, targetNamespace + '.' + method, m_api);
+    JsonValidator::Result validationResult = m_validator.validateParams(params, targetNamespace + '.' + method);
     if (!validationResult.success()) {
         qCWarning(dcJsonRpc()) << "JSON RPC parameter verification failed for method" << targetNamespace + '.' + method;
         qCWarning(dcJsonRpc()) << validationResult.errorString() << "in" << validationResult.where();
@@ -690,6 +1015,7 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         if (m_newConnectionWaitTimers.contains(clientId)) {
             sendErrorResponse(interface, clientId, commandId, "Handshake required. Call JSONRPC.Hello first.");
             qCWarning(dcJsonRpc()) << "Connection requires a handshake but client did not initiate handshake. Dropping connection";
+            flushBatchReplies(interface, clientId);
             interface->terminateClientConnection(clientId);
             return;
         }
@@ -719,10 +1045,9 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
         connect(reply, &JsonReply::finished, this, &JsonRPCServerImplementation::asyncReplyFinished);
         reply->startWait();
     } else {
-        JsonValidator validator;
-        Q_ASSERT_X((targetNamespace == "JSONRPC" && method == "Introspect") || validator.validateReturns(reply->data(), targetNamespace + '.' + method, m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
+        if (!(targetNamespace == "JSONRPC" && method == "Introspect")) {
+            validateReply(targetNamespace + '.' + method, reply->data());
+        }
 
         QString deprecationWarning;
         if (m_api.value("methods").toMap().value(targetNamespace + '.' + method).toMap().contains("deprecated")) {
@@ -733,6 +1058,52 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
         sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
         reply->deleteLater();
+
+        // A JSONRPC.Hello call has been answered, switch to the negotiated encoding. Within a batch,
+        // this happens once the batch reply has been sent.
+        if (!m_batchReplies.contains(clientId)) {
+            applyPendingEncoding(interface, clientId);
+        }
+    }
+}
+
+bool JsonRPCServerImplementation::verifyClientToken(const QUuid &clientId, const QByteArray &token)
+{
+    if (token.isEmpty()) {
+        return false;
+    }
+    // Tokens stay verified for a connection until they are removed
+    if (m_clientTokens.value(clientId) == token) {
+        return true;
+    }
+    if (!NymeaCore::instance()->userManager()->verifyToken(token)) {
+        return false;
+    }
+    m_clientTokens.insert(clientId, token);
+    return true;
+}
+
+void JsonRPCServerImplementation::validateReply(const QString &method, const QVariantMap &data)
+{
+    if (!m_replyValidationEnabled) {
+        return;
+    }
+    JsonValidator::Result result = m_validator.validateReturns(data, method);
+    if (!result.success()) {
+        qCWarning(dcJsonRpc()) << "Invalid return value:" << result.errorString() << "in" << result.where();
+        Q_ASSERT_X(false, result.where().toUtf8(), result.errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(data).toJson());
+    }
+}
+
+void JsonRPCServerImplementation::validateNotification(const QString &notification, const QVariantMap &params)
+{
+    if (!m_replyValidationEnabled) {
+        return;
+    }
+    JsonValidator::Result result = m_validator.validateNotificationParams(params, notification);
+    if (!result.success()) {
+        qCWarning(dcJsonRpc()) << "Invalid notification params:" << result.errorString() << "in" << result.where();
+        Q_ASSERT_X(false, result.where().toUtf8(), result.errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
     }
 }
 
@@ -740,42 +1111,90 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
 {
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
+    QString notificationName = handler->name() + '.' + method.name();
 
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
-
-    foreach (const QUuid &clientId, m_clientNotifications.keys()) {
+    notification.insert("notification", notificationName);
+
+    // Notifications about things are checked against the client's notification filter before
+    // anything is translated or serialized
+    ThingId thingId = NotificationFilter::notificationThingId(params);
+    bool stateChange = !thingId.isNull() && params.contains("stateTypeId");
+    Thing *thing = nullptr;
+    if (!thingId.isNull() && !m_clientNotificationFilters.isEmpty()) {
+        thing = NymeaCore::instance()->thingManager()->findConfiguredThing(thingId);
+    }
 
-        // Check if this client wants to be notified
-        if (!m_clientNotifications.value(clientId).contains(handler->name())) {
+    // Group the clients which want to be notified by locale and transport. The notification is translated
+    // and serialized once per locale and the same data is handed to each transport for all its clients.
+    QHash<QLocale, QHash<TransportInterface*, QList<QUuid>>> receivers;
+    for (QHash<QUuid, QStringList>::const_iterator it = m_clientNotifications.constBegin(); it != m_clientNotifications.constEnd(); ++it) {
+        if (!it.value().contains(handler->name())) {
             continue;
         }
-
-        // Add deprecation warning if necessary
-        if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-            QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
-            qCWarning(dcJsonRpc()) << "Client" << clientId << "uses deprecated API. Please update client implementation!";
-            qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
-            notification.insert("deprecationWarning", deprecationMessage);
+        int coalescingInterval = 0;
+        if (!thingId.isNull()) {
+            QHash<QUuid, NotificationFilter>::iterator filter = m_clientNotificationFilters.find(it.key());
+            if (filter != m_clientNotificationFilters.end()) {
+                if (!filter.value().acceptsThing(thingId, thing)) {
+                    continue;
+                }
+                if (stateChange && !filter.value().acceptsStateChange(thingId, StateTypeId(params.value("stateTypeId").toUuid()), params.value("value"))) {
+                    continue;
+                }
+                coalescingInterval = filter.value().coalescingInterval();
+            }
         }
+        if (stateChange && coalesceStateChange(it.key(), notificationName, thingId, params, coalescingInterval)) {
+            continue;
+        }
+        receivers[m_clientLocales.value(it.key())][m_clientTransports.value(it.key())].append(it.key());
+    }
 
-        QLocale locale = m_clientLocales.value(clientId);
-        QVariantMap translatedParams = handler->translateNotification(method.name(), params, locale);
+    if (receivers.isEmpty()) {
+        return;
+    }
 
-        JsonValidator validator;
-        Q_ASSERT_X(validator.validateNotificationParams(translatedParams, handler->name() + '.' + method.name(), m_api).success(),
-                   validator.result().where().toUtf8(),
-                   validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(translatedParams).toJson(QJsonDocument::Indented));
+    // Queued state changes of clients which don't keep up are replaced by newer values of the same state
+    QByteArray coalescingKey;
+    if (stateChange) {
+        coalescingKey = stateChangeKey(notificationName, thingId, params).toUtf8();
+    }
 
-        notification.insert("params", translatedParams);
+    // Add deprecation warning if necessary
+    if (m_notificationDeprecations.contains(notificationName)) {
+        QString deprecationMessage = m_notificationDeprecations.value(notificationName);
+        qCWarning(dcJsonRpc()) << "Clients use deprecated API. Please update client implementation!";
+        qCWarning(dcJsonRpc()) << notificationName + ':' << deprecationMessage;
+        notification.insert("deprecationWarning", deprecationMessage);
+    }
 
-        QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    for (QHash<QLocale, QHash<TransportInterface*, QList<QUuid>>>::const_iterator it = receivers.constBegin(); it != receivers.constEnd(); ++it) {
+        QVariantMap translatedParams = handler->translateNotification(method.name(), params, it.key());
 
-        qCDebug(dcJsonRpc()) << "Sending notification" << handler->name() + "." + method.name() << "to client" << clientId;
-        qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
+        validateNotification(notificationName, translatedParams);
 
-        m_clientTransports.value(clientId)->sendData(clientId, data);
+        notification.insert("params", translatedParams);
+
+        // Serialize and compress once per format used by the receiving clients
+        typedef QPair<MessageEncoding, MessageCompression> MessageFormat;
+        QHash<MessageFormat, QByteArray> encodedData;
+        foreach (TransportInterface *interface, it.value().keys()) {
+            QHash<MessageFormat, QList<QUuid>> clientsByFormat;
+            foreach (const QUuid &clientId, it.value().value(interface)) {
+                clientsByFormat[qMakePair(m_clientEncodings.value(clientId), m_clientCompressions.value(clientId))].append(clientId);
+            }
+            foreach (const MessageFormat &format, clientsByFormat.keys()) {
+                if (!encodedData.contains(format)) {
+                    encodedData.insert(format, encodeMessage(notification, format.first, format.second));
+                    qCDebug(dcJsonRpcTraffic()) << "Notification content:" << encodedData.value(format);
+                }
+                QList<QUuid> clients = clientsByFormat.value(format);
+                qCDebug(dcJsonRpc()) << "Sending notification" << notificationName << "to clients" << clients;
+                interface->sendNotification(clients, encodedData.value(format), coalescingKey);
+            }
+        }
     }
 }
 
@@ -784,6 +1203,11 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
     JsonHandler *handler = qobject_cast<JsonHandler *>(sender());
     QMetaMethod method = handler->metaObject()->method(senderSignalIndex());
 
+    deliverNotification(clientId, handler->name() + '.' + method.name(), params);
+}
+
+void JsonRPCServerImplementation::deliverNotification(const QUuid &clientId, const QString &notificationName, const QVariantMap &params, bool droppable, const QByteArray &coalescingKey)
+{
     if (!m_clientTransports.contains(clientId)) {
         qCWarning(dcJsonRpc()) << "No client with id" << clientId << ". Not sending client notification.";
         return;
@@ -791,25 +1215,107 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
 
     QVariantMap notification;
     notification.insert("id", m_notificationId++);
-    notification.insert("notification", handler->name() + "." + method.name());
+    notification.insert("notification", notificationName);
     notification.insert("params", params);
 
-    JsonValidator validator;
-    Q_ASSERT_X(validator.validateNotificationParams(params, handler->name() + '.' + method.name(), m_api).success(),
-               validator.result().where().toUtf8(),
-               validator.result().errorString().toUtf8() + "\nGot:" + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
+    validateNotification(notificationName, params);
 
-    if (m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().contains("deprecated")) {
-        QString deprecationMessage = m_api.value("notifications").toMap().value(handler->name() + '.' + method.name()).toMap().value("deprecated").toString();
+    if (m_notificationDeprecations.contains(notificationName)) {
+        QString deprecationMessage = m_notificationDeprecations.value(notificationName);
         qCWarning(dcJsonRpc()) << "Client uses deprecated API. Please update client implementation!";
-        qCWarning(dcJsonRpc()) << handler->name() + '.' + method.name() + ':' << deprecationMessage;
+        qCWarning(dcJsonRpc()) << notificationName + ':' << deprecationMessage;
         notification.insert("deprecationWarning", deprecationMessage);
     }
 
-    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    QByteArray data = encodeMessage(notification, m_clientEncodings.value(clientId), m_clientCompressions.value(clientId));
     qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
-    qCDebug(dcJsonRpc()) << "Sending notification:" << handler->name() + "." + method.name();
-    m_clientTransports.value(clientId)->sendData(clientId, data);
+    qCDebug(dcJsonRpc()) << "Sending notification:" << notificationName;
+    if (droppable) {
+        m_clientTransports.value(clientId)->sendNotification(QList<QUuid>() << clientId, data, coalescingKey);
+    } else {
+        m_clientTransports.value(clientId)->sendData(clientId, data);
+    }
+}
+
+bool JsonRPCServerImplementation::coalesceStateChange(const QUuid &clientId, const QString &notificationName, const ThingId &thingId, const QVariantMap &params, int coalescingInterval)
+{
+    QHash<QUuid, CoalescedStateChanges>::iterator pending = m_coalescedStateChanges.find(clientId);
+    if (pending == m_coalescedStateChanges.end()) {
+        if (coalescingInterval <= 0) {
+            // Clients which don't keep up reading their data get coalesced state changes until they caught up
+            qint64 bytesToWrite = m_clientTransports.value(clientId)->bytesToWrite(clientId);
+            if (bytesToWrite <= m_slowClientThreshold) {
+                return false;
+            }
+            qCDebug(dcJsonRpc()) << "Client" << clientId << "has" << bytesToWrite << "bytes pending. Reducing the state change notification rate.";
+            coalescingInterval = m_slowClientInterval;
+        }
+
+        QTimer *timer = new QTimer(this);
+        timer->setSingleShot(true);
+        timer->setInterval(coalescingInterval);
+        connect(timer, &QTimer::timeout, this, [this, clientId](){
+            flushStateChanges(clientId);
+        });
+        timer->start();
+
+        pending = m_coalescedStateChanges.insert(clientId, CoalescedStateChanges());
+        pending.value().timer = timer;
+    }
+
+    // Only the latest value of each state is kept, in the order the states changed first
+    QString key = stateChangeKey(notificationName, thingId, params);
+    if (!pending.value().notifications.contains(key)) {
+        pending.value().keys.append(key);
+    }
+    pending.value().notifications.insert(key, qMakePair(notificationName, params));
+    return true;
+}
+
+QString JsonRPCServerImplementation::stateChangeKey(const QString &notificationName, const ThingId &thingId, const QVariantMap &params) const
+{
+    return notificationName + '/' + thingId.toString() + '/' + params.value("stateTypeId").toString();
+}
+
+void JsonRPCServerImplementation::flushStateChanges(const QUuid &clientId)
+{
+    TransportInterface *interface = m_clientTransports.value(clientId);
+    if (!interface || !m_coalescedStateChanges.contains(clientId)) {
+        return;
+    }
+
+    // Keep collecting while the client still has not read its data
+    if (interface->bytesToWrite(clientId) > m_slowClientThreshold) {
+        m_coalescedStateChanges.value(clientId).timer->start();
+        return;
+    }
+
+    CoalescedStateChanges pending = m_coalescedStateChanges.take(clientId);
+    pending.timer->deleteLater();
+
+    bool batch = m_clientNotificationFilters.value(clientId).batchStateChanges();
+    QVariantList batchedStateChanges;
+    foreach (const QString &key, pending.keys) {
+        QPair<QString, QVariantMap> stateChange = pending.notifications.value(key);
+        if (batch && stateChange.first == "Integrations.StateChanged") {
+            batchedStateChanges.append(stateChange.second);
+            continue;
+        }
+        // Clients might have changed their notification settings meanwhile
+        QString handlerName = stateChange.first.split('.').first();
+        if (!m_clientNotifications.value(clientId).contains(handlerName)) {
+            continue;
+        }
+        JsonHandler *handler = m_handlers.value(handlerName);
+        QVariantMap params = handler->translateNotification(stateChange.first.split('.').last(), stateChange.second, m_clientLocales.value(clientId));
+        deliverNotification(clientId, stateChange.first, params, true, key.toUtf8());
+    }
+
+    if (!batchedStateChanges.isEmpty() && m_clientNotifications.value(clientId).contains("Integrations")) {
+        QVariantMap params;
+        params.insert("stateChanges", batchedStateChanges);
+        deliverNotification(clientId, "Integrations.StateChangedBatch", params, true);
+    }
 }
 
 void JsonRPCServerImplementation::asyncReplyFinished()
@@ -822,11 +1328,8 @@ void JsonRPCServerImplementation::asyncReplyFinished()
         return;
     }
     if (!reply->timedOut()) {
-        JsonValidator validator;
         QString method = reply->handler()->name() + '.' + reply->method();
-        Q_ASSERT_X(validator.validateReturns(reply->data(), method, m_api).success()
-                   ,validator.result().where().toUtf8()
-                   ,validator.result().errorString().toUtf8() + "\nReturn value:\n" + QJsonDocument::fromVariant(reply->data()).toJson());
+        validateReply(method, reply->data());
 
         QString deprecationWarning;
         if (m_api.value("methods").toMap().value(method).toMap().contains("deprecated")) {
@@ -977,6 +1480,15 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     // Checks completed. Store new API
     qCDebug(dcJsonRpc()) << "Registering JSON RPC handler:" << handler->name();
     m_api = apiIncludingThis;
+    m_validator.compile(m_api);
+    clearReplyCache();
+
+    foreach (const QString &notificationName, newNotifications.keys()) {
+        QVariantMap notification = newNotifications.value(notificationName).toMap();
+        if (notification.contains("deprecated")) {
+            m_notificationDeprecations.insert(notificationName, notification.value("deprecated").toString());
+        }
+    }
 
     m_handlers.insert(handler->name(), handler);
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
@@ -1013,13 +1525,35 @@ void JsonRPCServerImplementation::clientConnected(const QUuid &clientId)
     timer->start(10000);
 }
 
+void JsonRPCServerImplementation::onTokenRemoved(const QByteArray &token)
+{
+    QHash<QUuid, QByteArray>::iterator it = m_clientTokens.begin();
+    while (it != m_clientTokens.end()) {
+        if (it.value() == token) {
+            it = m_clientTokens.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void JsonRPCServerImplementation::clientDisconnected(const QUuid &clientId)
 {
     qCDebug(dcJsonRpc()) << "Client disconnected:" << clientId;
     m_clientTransports.remove(clientId);
     m_clientNotifications.remove(clientId);
-    m_clientBuffers.remove(clientId);
+    m_clientNotificationFilters.remove(clientId);
+    if (m_coalescedStateChanges.contains(clientId)) {
+        m_coalescedStateChanges.take(clientId).timer->deleteLater();
+    }
+    m_clientFramers.remove(clientId);
     m_clientLocales.remove(clientId);
+    m_clientEncodings.remove(clientId);
+    m_pendingEncodings.remove(clientId);
+    m_clientCompressions.remove(clientId);
+    m_pendingCompressions.remove(clientId);
+    m_batchReplies.remove(clientId);
+    m_clientTokens.remove(clientId);
     if (m_pushButtonTransactions.values().contains(clientId)) {
         NymeaCore::instance()->userManager()->cancelPushButtonAuth(m_pushButtonTransactions.key(clientId));
     }
@@ -33,6 +33,9 @@
 
 #include "jsonrpc/jsonrpcserver.h"
 #include "jsonrpc/jsonhandler.h"
+#include "jsonrpc/jsonvalidator.h"
+#include "jsonrpc/jsonframer.h"
+#include "jsonrpc/notificationfilter.h"
 #include "transportinterface.h"
 #include "usermanager/usermanager.h"
 
@@ -53,14 +56,27 @@ class JsonRPCServerImplementation: public JsonHandler, public JsonRPCServer
 {
     Q_OBJECT
 public:
+    enum MessageEncoding {
+        MessageEncodingJson,
+        MessageEncodingCbor
+    };
+    Q_ENUM(MessageEncoding)
+
+    enum MessageCompression {
+        MessageCompressionNone,
+        MessageCompressionDeflate
+    };
+    Q_ENUM(MessageCompression)
+
     JsonRPCServerImplementation(const QSslConfiguration &sslConfiguration = QSslConfiguration(), QObject *parent = nullptr);
 
     // JsonHandler API implementation
     QString name() const;
     Q_INVOKABLE JsonReply *Hello(const QVariantMap &params, const JsonContext &context);
-    Q_INVOKABLE JsonReply *Introspect(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *Introspect(const QVariantMap &params, const JsonContext &context) const;
     Q_INVOKABLE JsonReply *Version(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *SetNotificationStatus(const QVariantMap &params, const JsonContext &context);
+    Q_INVOKABLE JsonReply *SetNotificationFilter(const QVariantMap &params, const JsonContext &context);
 
     Q_INVOKABLE JsonReply *CreateUser(const QVariantMap &params);
     Q_INVOKABLE JsonReply *Authenticate(const QVariantMap &params);
@@ -84,15 +100,41 @@ public:
     bool registerHandler(JsonHandler *handler) override;
     bool registerExperienceHandler(JsonHandler *handler, int majorVersion, int minorVersion) override;
 
+    int maxMessageSize() const;
+    void setMaxMessageSize(int maxMessageSize);
+
+    void setCompression(int level, int threshold);
+
+    bool replyValidationEnabled() const;
+    void setReplyValidationEnabled(bool enabled);
+    JsonValidator::Statistics validationStatistics() const;
+    QHash<QUuid, SendQueue::Statistics> sendQueueStatistics() const;
+
 private:
     QHash<QString, JsonHandler *> handlers() const;
 
     void sendResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QVariantMap &params = QVariantMap(), const QString &deprecationWarning = QString());
     void sendErrorResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
     void sendUnauthorizedResponse(TransportInterface *interface, const QUuid &clientId, int commandId, const QString &error);
+    void sendMessage(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+    void flushBatchReplies(TransportInterface *interface, const QUuid &clientId);
+    void applyPendingEncoding(TransportInterface *interface, const QUuid &clientId);
     QVariantMap createWelcomeMessage(TransportInterface *interface, const QUuid &clientId) const;
+    QByteArray encodeMessage(const QVariant &message, MessageEncoding encoding, MessageCompression compression = MessageCompressionNone) const;
+    bool decompressMessage(const QByteArray &data, QByteArray *message) const;
 
     void processJsonPacket(TransportInterface *interface, const QUuid &clientId, const QByteArray &data);
+    void processBatch(TransportInterface *interface, const QUuid &clientId, const QVariantList &requests);
+    void processRequest(TransportInterface *interface, const QUuid &clientId, const QVariantMap &message);
+
+    bool verifyClientToken(const QUuid &clientId, const QByteArray &token);
+    void validateReply(const QString &method, const QVariantMap &data);
+    void validateNotification(const QString &notification, const QVariantMap &params);
+
+    void deliverNotification(const QUuid &clientId, const QString &notificationName, const QVariantMap &params, bool droppable = false, const QByteArray &coalescingKey = QByteArray());
+    QString stateChangeKey(const QString &notificationName, const ThingId &thingId, const QVariantMap &params) const;
+    bool coalesceStateChange(const QUuid &clientId, const QString &notificationName, const ThingId &thingId, const QVariantMap &params, int coalescingInterval);
+    void flushStateChanges(const QUuid &clientId);
 
 private slots:
     void setup();
@@ -110,18 +152,43 @@ private slots:
     void pairingFinished(QString cognitoUserId, int status, const QString &message);
     void onCloudConnectionStateChanged();
     void onPushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
+    void onTokenRemoved(const QByteArray &token);
 
 private:
     QVariantMap m_api;
+    QHash<QString, QString> m_notificationDeprecations;
+    JsonValidator m_validator;
+    bool m_replyValidationEnabled = true;
     QHash<JsonHandler*, QString> m_experiences;
     QMap<TransportInterface*, bool> m_interfaces; // Interface, authenticationRequired
     QHash<QString, JsonHandler *> m_handlers;
     QHash<JsonReply *, TransportInterface *> m_asyncReplies;
 
     QHash<QUuid, TransportInterface*> m_clientTransports;
-    QHash<QUuid, QByteArray> m_clientBuffers;
+    QHash<QUuid, JsonFramer> m_clientFramers;
+    int m_maxMessageSize = 10 * 1024;
     QHash<QUuid, QStringList> m_clientNotifications;
+    QHash<QUuid, NotificationFilter> m_clientNotificationFilters;
+
+    // State change notifications held back per client, see coalesceStateChange()
+    struct CoalescedStateChanges {
+        QTimer *timer = nullptr;
+        QStringList keys;
+        QHash<QString, QPair<QString, QVariantMap>> notifications;
+    };
+    QHash<QUuid, CoalescedStateChanges> m_coalescedStateChanges;
+    qint64 m_slowClientThreshold = 64 * 1024;
+    int m_slowClientInterval = 1000;
     QHash<QUuid, QLocale> m_clientLocales;
+    QHash<QUuid, MessageEncoding> m_clientEncodings;
+    QHash<QUuid, MessageEncoding> m_pendingEncodings; // Applied after the JSONRPC.Hello reply has been sent
+    QHash<QUuid, MessageCompression> m_clientCompressions;
+    QHash<QUuid, MessageCompression> m_pendingCompressions; // Applied after the JSONRPC.Hello reply has been sent
+    int m_compressionLevel = -1; // zlib default
+    int m_compressionThreshold = 256;
+    int m_maxDecompressedSize = 1024 * 1024;
+    QHash<QUuid, QByteArray> m_clientTokens;
+    QHash<QUuid, QVariantList> m_batchReplies; // Sync replies collected while a batch request is processed
     QHash<int, QUuid> m_pushButtonTransactions;
     QHash<QUuid, QTimer*> m_newConnectionWaitTimers;
 
@@ -36,9 +36,20 @@
 #include <QJsonDocument>
 #include <QColor>
 #include <QDateTime>
+#include <QElapsedTimer>
 
 namespace nymeaserver {
 
+JsonValidator::JsonValidator()
+{
+    m_emptyObject.kind = Node::KindObject;
+}
+
+JsonValidator::~JsonValidator()
+{
+    qDeleteAll(m_nodes);
+}
+
 bool JsonValidator::checkRefs(const QVariantMap &map, const QVariantMap &api)
 {
     QVariantMap enums = api.value("enums").toMap();
@@ -80,27 +91,99 @@ bool JsonValidator::checkRefs(const QVariantMap &map, const QVariantMap &api)
 
 }
 
-JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api)
+/*! Compiles the given \a api into a tree of validation nodes. Key prefixes are resolved and "$ref:"
+    entries are linked to the referenced enums, flags and types so validating a message does not
+    need to look up anything in the api map. Must be called again whenever the api changes.
+*/
+void JsonValidator::compile(const QVariantMap &api)
 {
-    QVariantMap paramDefinition = api.value("methods").toMap().value(method).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::WriteOnly);
-    m_result.setWhere(method + ", param " + m_result.where());
+    qDeleteAll(m_nodes);
+    m_nodes.clear();
+    m_methodParams.clear();
+    m_methodReturns.clear();
+    m_notificationParams.clear();
+
+    QVariantMap enums = api.value("enums").toMap();
+    QVariantMap flags = api.value("flags").toMap();
+    QVariantMap types = api.value("types").toMap();
+
+    // Create all referenceable nodes first so types can refer to each other (and themselves)
+    QHash<QString, Node*> references;
+    foreach (const QString &name, enums.keys()) {
+        references.insert(name, createNode());
+    }
+    foreach (const QString &name, flags.keys()) {
+        if (!references.contains(name)) {
+            references.insert(name, createNode());
+        }
+    }
+    foreach (const QString &name, types.keys()) {
+        if (!references.contains(name)) {
+            references.insert(name, createNode());
+        }
+    }
+
+    // Refs are resolved in the order enums, flags, types
+    foreach (const QString &name, types.keys()) {
+        if (!enums.contains(name) && !flags.contains(name)) {
+            compileDefinition(references.value(name), types.value(name), references);
+        }
+    }
+    foreach (const QString &name, flags.keys()) {
+        if (!enums.contains(name)) {
+            Node *node = references.value(name);
+            node->kind = Node::KindFlags;
+            node->name = name;
+            node->entry = compileDefinition(flags.value(name).toList().value(0), references);
+        }
+    }
+    foreach (const QString &name, enums.keys()) {
+        Node *node = references.value(name);
+        node->kind = Node::KindEnum;
+        node->name = name;
+        foreach (const QVariant &value, enums.value(name).toList()) {
+            node->values.insert(value.toString());
+        }
+    }
+
+    QVariantMap methods = api.value("methods").toMap();
+    foreach (const QString &name, methods.keys()) {
+        QVariantMap method = methods.value(name).toMap();
+        m_methodParams.insert(name, compileDefinition(method.value("params").toMap(), references));
+        m_methodReturns.insert(name, compileDefinition(method.value("returns").toMap(), references));
+    }
+
+    QVariantMap notifications = api.value("notifications").toMap();
+    foreach (const QString &name, notifications.keys()) {
+        QVariantMap notification = notifications.value(name).toMap();
+        m_notificationParams.insert(name, compileDefinition(notification.value("params").toMap(), references));
+    }
+}
+
+JsonValidator::Result JsonValidator::validateParams(const QVariantMap &params, const QString &method)
+{
+    m_result = validate(params, m_methodParams.value(method, &m_emptyObject), QIODevice::WriteOnly);
+    if (!m_result.success()) {
+        m_result.setWhere(method + ", param " + m_result.where());
+    }
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api)
+JsonValidator::Result JsonValidator::validateReturns(const QVariantMap &returns, const QString &method)
 {
-    QVariantMap returnsDefinition = api.value("methods").toMap().value(method).toMap().value("returns").toMap();
-    m_result = validateMap(returns, returnsDefinition, api, QIODevice::ReadOnly);
-    m_result.setWhere(method + ", returns " + m_result.where());
+    m_result = validate(returns, m_methodReturns.value(method, &m_emptyObject), QIODevice::ReadOnly);
+    if (!m_result.success()) {
+        m_result.setWhere(method + ", returns " + m_result.where());
+    }
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api)
+JsonValidator::Result JsonValidator::validateNotificationParams(const QVariantMap &params, const QString &notification)
 {
-    QVariantMap paramDefinition = api.value("notifications").toMap().value(notification).toMap().value("params").toMap();
-    m_result = validateMap(params, paramDefinition, api, QIODevice::ReadOnly);
-    m_result.setWhere(notification + ", param " + m_result.where());
+    m_result = validate(params, m_notificationParams.value(notification, &m_emptyObject), QIODevice::ReadOnly);
+    if (!m_result.success()) {
+        m_result.setWhere(notification + ", param " + m_result.where());
+    }
     return m_result;
 }
 
@@ -109,116 +192,170 @@ JsonValidator::Result JsonValidator::result() const
     return m_result;
 }
 
-JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+JsonValidator::Statistics JsonValidator::statistics() const
 {
-    // Make sure all required values are available
-    foreach (const QString &key, definition.keys()) {
+    return m_statistics;
+}
+
+JsonValidator::Node *JsonValidator::createNode()
+{
+    Node *node = new Node();
+    m_nodes.append(node);
+    return node;
+}
+
+const JsonValidator::Node *JsonValidator::compileDefinition(const QVariant &definition, const QHash<QString, Node *> &references)
+{
+    // Refs are linked directly to the referenced node
+    if (definition.type() == QVariant::String && definition.toString().startsWith("$ref:")) {
+        Node *node = references.value(definition.toString().remove("$ref:"));
+        if (node) {
+            return node;
+        }
+    }
+
+    Node *node = createNode();
+    compileDefinition(node, definition, references);
+    return node;
+}
+
+void JsonValidator::compileDefinition(Node *node, const QVariant &definition, const QHash<QString, Node *> &references)
+{
+    if (definition.type() == QVariant::String) {
+        QString typeName = definition.toString();
+        if (typeName.startsWith("$ref:")) {
+            node->kind = Node::KindRef;
+            node->name = typeName.remove("$ref:");
+            node->entry = references.value(node->name);
+            return;
+        }
+        node->kind = Node::KindBasic;
+        node->name = typeName;
+        node->basicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(typeName);
+        node->variantType = JsonHandler::basicTypeToVariantType(node->basicType);
+        return;
+    }
+
+    if (definition.type() == QVariant::Map) {
         QRegExp isOptional = QRegExp("^([a-z]:)*o:.*");
-        if (isOptional.exactMatch(key)) {
+        QRegExp isReadOnly = QRegExp("^([a-z]:)*r:.*");
+        QRegExp prefixes = QRegExp("^(o:|r:|d:)*");
+
+        node->kind = Node::KindObject;
+        QVariantMap map = definition.toMap();
+        foreach (const QString &key, map.keys()) {
+            Property property;
+            property.key = key;
+            property.name = key;
+            property.name.remove(prefixes);
+            property.optional = isOptional.exactMatch(key);
+            property.readOnly = isReadOnly.exactMatch(key);
+            property.node = compileDefinition(map.value(key), references);
+            node->propertyIndexes.insert(property.name, node->properties.count());
+            node->properties.append(property);
+        }
+        return;
+    }
+
+    if (definition.type() == QVariant::List) {
+        QVariant entryDefinition = definition.toList().value(0);
+        node->kind = Node::KindList;
+        node->name = entryDefinition.toString();
+        node->entry = compileDefinition(entryDefinition, references);
+        return;
+    }
+
+    node->kind = Node::KindInvalid;
+}
+
+JsonValidator::Result JsonValidator::validate(const QVariantMap &map, const Node *definition, QIODevice::OpenMode openMode)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result = validateMap(map, definition, openMode);
+
+    m_statistics.validations++;
+    if (!result.success()) {
+        m_statistics.failures++;
+    }
+    m_statistics.totalTime += static_cast<quint64>(timer.nsecsElapsed());
+    return result;
+}
+
+JsonValidator::Result JsonValidator::validateMap(const QVariantMap &map, const Node *definition, QIODevice::OpenMode openMode) const
+{
+    // Make sure all required values are available
+    foreach (const Property &property, definition->properties) {
+        if (property.optional) {
             continue;
         }
-        QRegExp isReadOnly = QRegExp("^([a-z]:)*r:.*");
-        if (isReadOnly.exactMatch(key) && openMode.testFlag(QIODevice::WriteOnly)) {
+        if (property.readOnly && openMode.testFlag(QIODevice::WriteOnly)) {
             continue;
         }
-        QString trimmedKey = key;
-        trimmedKey.remove(QRegExp("^(o:|r:|d:)*"));
-        if (!map.contains(trimmedKey)) {
-            return Result(false, "Missing required key: " + key, key);
+        if (!map.contains(property.name)) {
+            return Result(false, "Missing required key: " + property.key, property.key);
         }
     }
 
     // Make sure given values are valid
-    foreach (const QString &key, map.keys()) {
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
         // Is the key allowed in here?
-        QVariant expectedValue = definition.value(key);
-        foreach (const QString &definitionKey, definition.keys()) {
-            QRegExp regExp = QRegExp("(o:|r:|d:)*" + key);
-            if (regExp.exactMatch(definitionKey)) {
-                expectedValue = definition.value(definitionKey);
-            }
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("o:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            expectedValue = definition.value("d:" + key);
-        }
-        if (!expectedValue.isValid()) {
-            return Result(false, "Invalid key: " + key);
+        int index = definition->propertyIndexes.value(it.key(), -1);
+        if (index < 0) {
+            return Result(false, "Invalid key: " + it.key());
         }
 
         // Validate content
-        QVariant value = map.value(key);
-
-        Result result = validateEntry(value, expectedValue, api, openMode);
+        Result result = validateEntry(it.value(), definition->properties.at(index).node, openMode);
         if (!result.success()) {
-            result.setWhere(key + '.' + result.where());
-            result.setErrorString(result.errorString());
+            result.setWhere(it.key() + '.' + result.where());
             return result;
         }
-
-   }
+    }
 
     return Result(true);
 }
 
-JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode)
+JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const Node *definition, QIODevice::OpenMode openMode) const
 {
-    if (definition.type() == QVariant::String) {
-        QString expectedTypeName = definition.toString();
-
-        if (expectedTypeName.startsWith("$ref:")) {
-            QString refName = expectedTypeName;
-            refName.remove("$ref:");
+    switch (definition->kind) {
+    case Node::KindRef:
+        if (!definition->entry) {
+            break;
+        }
+        return validateEntry(value, definition->entry, openMode);
 
-            // Refs might be enums
-            QVariantMap enums = api.value("enums").toMap();
-            if (enums.contains(refName)) {
-                QVariant refDefinition = enums.value(refName);
+    case Node::KindEnum:
+        if (!definition->values.contains(value.toString())) {
+            return Result(false, "Expected enum " + definition->name + " but got " + value.toJsonDocument().toJson());
+        }
+        return Result(true);
 
-                QVariantList enumList = refDefinition.toList();
-                if (!enumList.contains(value.toString())) {
-                    return Result(false, "Expected enum " + refName + " but got " + value.toJsonDocument().toJson());
-                }
-                return Result(true);
-            }
-            // Or flags
-            QVariantMap flags = api.value("flags").toMap();
-            if (flags.contains(refName)) {
-                QVariant refDefinition = flags.value(refName);
-                if (value.type() != QVariant::StringList) {
-                    return Result(false, "Expected flags " + refName + " but got " + value.toString());
-                }
-                QString flagEnum = refDefinition.toList().first().toString();
-                foreach (const QVariant &flagsEntry, value.toList()) {
-                    Result result = validateEntry(flagsEntry, flagEnum, api, openMode);
-                    if (!result.success()) {
-                        return result;
-                    }
-                }
-                return Result(true);
+    case Node::KindFlags:
+        if (value.type() != QVariant::StringList) {
+            return Result(false, "Expected flags " + definition->name + " but got " + value.toString());
+        }
+        foreach (const QVariant &flagsEntry, value.toList()) {
+            Result result = validateEntry(flagsEntry, definition->entry, openMode);
+            if (!result.success()) {
+                return result;
             }
-
-            QVariantMap types = api.value("types").toMap();
-            QVariant refDefinition = types.value(refName);
-            return validateEntry(value, refDefinition, api, openMode);
         }
+        return Result(true);
 
-        JsonHandler::BasicType expectedBasicType = JsonHandler::enumNameToValue<JsonHandler::BasicType>(expectedTypeName);
-        QVariant::Type expectedVariantType = JsonHandler::basicTypeToVariantType(expectedBasicType);
-
+    case Node::KindBasic:
         // Verify basic compatiblity
-        if (expectedBasicType != JsonHandler::Variant && !value.canConvert(expectedVariantType)) {
-            return Result(false, "Invalid value. Expected: " + definition.toString() + ", Got: " + value.toString());
+        if (definition->basicType != JsonHandler::Variant && !value.canConvert(definition->variantType)) {
+            return Result(false, "Invalid value. Expected: " + definition->name + ", Got: " + value.toString());
         }
 
         // Any string converts fine to Uuid, but the resulting uuid might be null
-        if (expectedBasicType == JsonHandler::Uuid && value.toUuid().isNull()) {
+        if (definition->basicType == JsonHandler::Uuid && value.toUuid().isNull()) {
             return Result(false, "Invalid Uuid: " + value.toString());
         }
         // Make sure ints are valid
-        if (expectedBasicType == JsonHandler::Int) {
+        if (definition->basicType == JsonHandler::Int) {
             bool ok;
             value.toLongLong(&ok);
             if (!ok) {
@@ -226,7 +363,7 @@ JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const
             }
         }
         // UInts
-        if (expectedBasicType == JsonHandler::Uint) {
+        if (definition->basicType == JsonHandler::Uint) {
             bool ok;
             value.toULongLong(&ok);
             if (!ok) {
@@ -234,7 +371,7 @@ JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const
             }
         }
         // Double
-        if (expectedBasicType == JsonHandler::Double) {
+        if (definition->basicType == JsonHandler::Double) {
             bool ok;
             value.toDouble(&ok);
             if (!ok) {
@@ -242,45 +379,43 @@ JsonValidator::Result JsonValidator::validateEntry(const QVariant &value, const
             }
         }
         // Color
-        if (expectedBasicType == JsonHandler::Color) {
+        if (definition->basicType == JsonHandler::Color) {
             QColor color = value.value<QColor>();
             if (!color.isValid()) {
                 return Result(false, "Invalid Color: " + value.toString());
             }
         }
         // Time
-        if (expectedBasicType == JsonHandler::Time) {
+        if (definition->basicType == JsonHandler::Time) {
             QTime time = QTime::fromString(value.toString(), "hh:mm");
             if (!time.isValid()) {
                 return Result(false, "Invalid Time: " + value.toString());
             }
         }
-
-
         return Result(true);
-    }
 
-    if (definition.type() == QVariant::Map) {
+    case Node::KindObject:
         if (value.type() != QVariant::Map) {
             return Result(false, "Invalid value. Expected a map bug received: " + value.toString());
         }
-        return validateMap(value.toMap(), definition.toMap(), api, openMode);
-    }
+        return validateMap(value.toMap(), definition, openMode);
 
-    if (definition.type() == QVariant::List) {
-        QVariantList list = definition.toList();
-        QVariant entryDefinition = list.first();
+    case Node::KindList:
         if (value.type() != QVariant::List && value.type() != QVariant::StringList) {
-            return Result(false, "Expected list of " + entryDefinition.toString() + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
+            return Result(false, "Expected list of " + definition->name + " but got value of type " + value.typeName() + "\n" + QJsonDocument::fromVariant(value).toJson());
         }
         foreach (const QVariant &entry, value.toList()) {
-            Result result = validateEntry(entry, entryDefinition, api, openMode);
+            Result result = validateEntry(entry, definition->entry, openMode);
             if (!result.success()) {
                 return result;
             }
         }
         return Result(true);
+
+    case Node::KindInvalid:
+        break;
     }
+
     Q_ASSERT_X(false, "JsonValildator", "Incomplete validation. Unexpected type in template");
     return Result(false);
 }
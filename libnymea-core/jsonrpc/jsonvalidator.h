@@ -31,9 +31,14 @@
 #ifndef JSONVALIDATOR_H
 #define JSONVALIDATOR_H
 
+#include "jsonrpc/jsonhandler.h"
+
 #include <QPair>
 #include <QVariant>
 #include <QIODevice>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 
 namespace nymeaserver {
 
@@ -59,20 +64,80 @@ public:
         bool m_deprecated = false;
     };
 
-    JsonValidator() {}
+    class Statistics {
+    public:
+        quint64 validations = 0;
+        quint64 failures = 0;
+        quint64 totalTime = 0; // ns
+    };
+
+    JsonValidator();
+    ~JsonValidator();
 
     static bool checkRefs(const QVariantMap &map, const QVariantMap &api);
 
-    Result validateParams(const QVariantMap &params, const QString &method, const QVariantMap &api);
-    Result validateReturns(const QVariantMap &returns, const QString &method, const QVariantMap &api);
-    Result validateNotificationParams(const QVariantMap &params, const QString &notification, const QVariantMap &api);
+    void compile(const QVariantMap &api);
+
+    Result validateParams(const QVariantMap &params, const QString &method);
+    Result validateReturns(const QVariantMap &returns, const QString &method);
+    Result validateNotificationParams(const QVariantMap &params, const QString &notification);
 
     Result result() const;
+    Statistics statistics() const;
+
 private:
-    Result validateMap(const QVariantMap &map, const QVariantMap &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
-    Result validateEntry(const QVariant &value, const QVariant &definition, const QVariantMap &api, QIODevice::OpenMode openMode);
+    class Node;
+    class Property {
+    public:
+        QString key;
+        QString name;
+        bool optional = false;
+        bool readOnly = false;
+        const Node *node = nullptr;
+    };
+
+    class Node {
+    public:
+        enum Kind {
+            KindInvalid,
+            KindBasic,
+            KindEnum,
+            KindFlags,
+            KindObject,
+            KindList,
+            KindRef
+        };
+        Kind kind = KindInvalid;
+        QString name;
+        JsonHandler::BasicType basicType = JsonHandler::Variant;
+        QVariant::Type variantType = QVariant::Invalid;
+        // Enum values for KindEnum
+        QSet<QString> values;
+        // Entries of KindList, the enum of KindFlags or the target of KindRef
+        const Node *entry = nullptr;
+        // Properties of KindObject in the order of the definition and indexed by name without prefixes
+        QVector<Property> properties;
+        QHash<QString, int> propertyIndexes;
+    };
+
+    Node *createNode();
+    const Node *compileDefinition(const QVariant &definition, const QHash<QString, Node*> &references);
+    void compileDefinition(Node *node, const QVariant &definition, const QHash<QString, Node*> &references);
+
+    Result validate(const QVariantMap &map, const Node *definition, QIODevice::OpenMode openMode);
+    Result validateMap(const QVariantMap &map, const Node *definition, QIODevice::OpenMode openMode) const;
+    Result validateEntry(const QVariant &value, const Node *definition, QIODevice::OpenMode openMode) const;
+
+    QList<Node*> m_nodes;
+    Node m_emptyObject;
+    QHash<QString, const Node*> m_methodParams;
+    QHash<QString, const Node*> m_methodReturns;
+    QHash<QString, const Node*> m_notificationParams;
 
     Result m_result;
+    Statistics m_statistics;
+
+    Q_DISABLE_COPY(JsonValidator)
 };
 
 }
@@ -46,9 +46,11 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     registerEnum<Logging::LoggingLevel>();
     registerEnum<Logging::LoggingEventType>();
     registerEnum<Logging::LoggingError>();
+    registerEnum<Logging::AggregationResolution>();
 
     // Objects
     registerObject<LogEntry, LogEntries>();
+    registerUncreatableObject<AggregatedValue, AggregatedValues>();
 
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
@@ -66,7 +68,11 @@ LoggingHandler::LoggingHandler(QObject *parent) :
                    "1) offset 0, maxCount 1000: Entries 0 to 9999\n"
                    "2) offset 10000, maxCount 1000: Entries 10000 - 19999\n"
                    "3) offset 20000, maxCount 1000: Entries 20000 - 29999\n"
-                   "...";
+                   "...\n\n"
+                   "For deep pagination, the cursor should be used instead of the offset as it does not "
+                   "require the server to skip over all previous entries. If a limit is given and the "
+                   "result set may contain more entries, the reply contains a nextCursor. Passing it as "
+                   "cursor in the next call returns the entries following the last entry of the previous page.";
     QVariantMap timeFilter;
     timeFilter.insert("o:startDate", enumValueName(Int));
     timeFilter.insert("o:endDate", enumValueName(Int));
@@ -80,12 +86,29 @@ LoggingHandler::LoggingHandler(QObject *parent) :
     params.insert("o:values", QVariantList() << enumValueName(Variant));
     params.insert("o:limit", enumValueName(Int));
     params.insert("o:offset", enumValueName(Int));
+    params.insert("o:cursor", enumValueName(String));
     returns.insert("loggingError", enumRef<Logging::LoggingError>());
     returns.insert("o:logEntries", objectRef<LogEntries>());
+    returns.insert("o:nextCursor", enumValueName(String));
     returns.insert("count", enumValueName(Int));
     returns.insert("offset", enumValueName(Int));
     registerMethod("GetLogEntries", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the history of a numeric state in aggregated form. The state log entries of the given "
+                   "thing and state type are grouped into time buckets of the given resolution. Each bucket "
+                   "contains the minimum, maximum, average and last value as well as the number of entries "
+                   "within the bucket. Buckets without entries are omitted. The timestamp of a bucket marks its "
+                   "start. The optional startDate and endDate limit the time range to be aggregated.";
+    params.insert("thingId", enumValueName(Uuid));
+    params.insert("stateTypeId", enumValueName(Uuid));
+    params.insert("resolution", enumRef<Logging::AggregationResolution>());
+    params.insert("o:startDate", enumValueName(Int));
+    params.insert("o:endDate", enumValueName(Int));
+    returns.insert("loggingError", enumRef<Logging::LoggingError>());
+    returns.insert("o:aggregatedValues", objectRef<AggregatedValues>());
+    registerMethod("GetAggregatedValues", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever an entry is appended to the logging system. ";
@@ -125,6 +148,14 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
 {
     LogFilter filter = unpackLogFilter(params);
 
+    if (params.contains("cursor") && filter.cursor().isEmpty()) {
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        returns.insert("offset", filter.offset());
+        returns.insert("count", 0);
+        return createReply(returns);
+    }
+
     LogEntriesFetchJob *job = NymeaCore::instance()->logEngine()->fetchLogEntries(filter);
 
     JsonReply *reply = createAsyncReply("GetLogEntries");
@@ -140,6 +171,9 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
         returns.insert("logEntries", entries);
         returns.insert("offset", filter.offset());
         returns.insert("count", entries.count());
+        if (!job->nextCursor().isEmpty()) {
+            returns.insert("nextCursor", job->nextCursor());
+        }
 
         reply->setData(returns);
         reply->finished();
@@ -148,6 +182,45 @@ JsonReply* LoggingHandler::GetLogEntries(const QVariantMap &params) const
     return reply;
 }
 
+JsonReply *LoggingHandler::GetAggregatedValues(const QVariantMap &params) const
+{
+    ThingId thingId = params.value("thingId").toUuid();
+    StateTypeId stateTypeId = params.value("stateTypeId").toUuid();
+    Logging::AggregationResolution resolution = enumNameToValue<Logging::AggregationResolution>(params.value("resolution").toString());
+
+    QDateTime startDate; QDateTime endDate;
+    if (params.contains("startDate")) {
+        startDate = QDateTime::fromTime_t(params.value("startDate").toUInt());
+    }
+    if (params.contains("endDate")) {
+        endDate = QDateTime::fromTime_t(params.value("endDate").toUInt());
+    }
+
+    if (startDate.isValid() && endDate.isValid() && startDate > endDate) {
+        QVariantMap returns;
+        returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        return createReply(returns);
+    }
+
+    AggregatedValuesFetchJob *job = NymeaCore::instance()->logEngine()->fetchAggregatedValues(thingId, stateTypeId, resolution, startDate, endDate);
+
+    JsonReply *reply = createAsyncReply("GetAggregatedValues");
+
+    connect(job, &AggregatedValuesFetchJob::finished, reply, [this, reply, job](){
+        QVariantMap returns;
+        if (!job->success()) {
+            returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorInvalidFilterParameter));
+        } else {
+            returns.insert("loggingError", enumValueName<Logging::LoggingError>(Logging::LoggingErrorNoError));
+            returns.insert("aggregatedValues", pack(job->results()));
+        }
+        reply->setData(returns);
+        reply->finished();
+    });
+
+    return reply;
+}
+
 QVariantMap LoggingHandler::packLogEntry(const LogEntry &logEntry)
 {
     QVariantMap logEntryMap;
@@ -270,6 +343,9 @@ LogFilter LoggingHandler::unpackLogFilter(const QVariantMap &logFilterMap)
     if (logFilterMap.contains("offset")) {
         filter.setOffset(logFilterMap.value("offset").toInt());
     }
+    if (logFilterMap.contains("cursor")) {
+        filter.setCursor(logFilterMap.value("cursor").toString());
+    }
 
     return filter;
 }
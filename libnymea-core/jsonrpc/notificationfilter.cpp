@@ -0,0 +1,270 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::NotificationFilter
+    \brief Limits the notifications a client receives to the things it is interested in.
+
+    \ingroup server
+    \inmodule core
+
+    A NotificationFilter is set by a client with JSONRPC.SetNotificationFilter and applies to all
+    notifications about a thing. A notification passes if its thing is in thingIds() and implements
+    one of interfaces(). State changes additionally need to match stateTypeIds() and, for numeric
+    values, differ by at least minValueChange() from the last value delivered to the client.
+    Empty lists do not restrict anything.
+
+    If a coalescingInterval() is set, state changes are collected and only the latest value of each
+    state is sent once per interval, optionally in a single batch notification.
+*/
+
+#include "notificationfilter.h"
+#include "integrations/thing.h"
+
+namespace nymeaserver {
+
+/*! Constructs an empty NotificationFilter which accepts all notifications. */
+NotificationFilter::NotificationFilter()
+{
+
+}
+
+/*! Creates a NotificationFilter from the JSON-RPC representation in \a map. */
+NotificationFilter NotificationFilter::fromMap(const QVariantMap &map)
+{
+    NotificationFilter filter;
+    foreach (const QVariant &thingId, map.value("thingIds").toList()) {
+        filter.m_thingIds.insert(ThingId(thingId.toUuid()));
+    }
+    filter.m_interfaces = map.value("interfaces").toStringList();
+    foreach (const QVariant &stateTypeId, map.value("stateTypeIds").toList()) {
+        filter.m_stateTypeIds.insert(StateTypeId(stateTypeId.toUuid()));
+    }
+    filter.m_minValueChange = map.value("minValueChange", 0).toDouble();
+    filter.m_coalescingInterval = map.value("coalescingInterval", 0).toInt();
+    filter.m_batchStateChanges = map.value("batchStateChanges", false).toBool();
+    return filter;
+}
+
+/*! Returns the JSON-RPC representation of this filter. */
+QVariantMap NotificationFilter::toMap() const
+{
+    QVariantMap map;
+    if (!m_thingIds.isEmpty()) {
+        QVariantList thingIds;
+        foreach (const ThingId &thingId, m_thingIds) {
+            thingIds.append(thingId);
+        }
+        map.insert("thingIds", thingIds);
+    }
+    if (!m_interfaces.isEmpty()) {
+        map.insert("interfaces", m_interfaces);
+    }
+    if (!m_stateTypeIds.isEmpty()) {
+        QVariantList stateTypeIds;
+        foreach (const StateTypeId &stateTypeId, m_stateTypeIds) {
+            stateTypeIds.append(stateTypeId);
+        }
+        map.insert("stateTypeIds", stateTypeIds);
+    }
+    if (m_minValueChange > 0) {
+        map.insert("minValueChange", m_minValueChange);
+    }
+    if (m_coalescingInterval > 0) {
+        map.insert("coalescingInterval", m_coalescingInterval);
+    }
+    if (m_batchStateChanges) {
+        map.insert("batchStateChanges", m_batchStateChanges);
+    }
+    return map;
+}
+
+/*! Returns the id of the thing the notification with the given \a params refers to, or a null id
+    if the notification is not about a thing.
+*/
+ThingId NotificationFilter::notificationThingId(const QVariantMap &params)
+{
+    if (params.contains("thingId")) {
+        return ThingId(params.value("thingId").toUuid());
+    }
+    if (params.contains("deviceId")) {
+        return ThingId(params.value("deviceId").toUuid());
+    }
+    foreach (const QString &key, QStringList() << "thing" << "device") {
+        if (params.contains(key)) {
+            return ThingId(params.value(key).toMap().value("id").toUuid());
+        }
+    }
+    foreach (const QString &key, QStringList() << "event" << "logEntry") {
+        if (params.contains(key)) {
+            QVariantMap object = params.value(key).toMap();
+            return ThingId(object.value(object.contains("thingId") ? "thingId" : "deviceId").toUuid());
+        }
+    }
+    return ThingId();
+}
+
+/*! Returns the things notifications are sent for. If empty, notifications for all things are sent. */
+QList<ThingId> NotificationFilter::thingIds() const
+{
+    return m_thingIds.toList();
+}
+
+/*! Sets the things notifications are sent for to \a thingIds. */
+void NotificationFilter::setThingIds(const QList<ThingId> &thingIds)
+{
+    m_thingIds = thingIds.toSet();
+}
+
+/*! Returns the interfaces of which a thing needs to implement at least one. If empty, all things are accepted. */
+QStringList NotificationFilter::interfaces() const
+{
+    return m_interfaces;
+}
+
+/*! Sets the interfaces of which a thing needs to implement at least one to \a interfaces. */
+void NotificationFilter::setInterfaces(const QStringList &interfaces)
+{
+    m_interfaces = interfaces;
+    m_acceptedThingClasses.clear();
+}
+
+/*! Returns the state types state change notifications are sent for. If empty, all state changes are sent. */
+QList<StateTypeId> NotificationFilter::stateTypeIds() const
+{
+    return m_stateTypeIds.toList();
+}
+
+/*! Sets the state types state change notifications are sent for to \a stateTypeIds. */
+void NotificationFilter::setStateTypeIds(const QList<StateTypeId> &stateTypeIds)
+{
+    m_stateTypeIds = stateTypeIds.toSet();
+}
+
+/*! Returns the minimum difference to the last delivered value a numeric state needs to change by to be sent. */
+double NotificationFilter::minValueChange() const
+{
+    return m_minValueChange;
+}
+
+/*! Sets the minimum difference to the last delivered value a numeric state needs to change by to be sent to \a minValueChange. */
+void NotificationFilter::setMinValueChange(double minValueChange)
+{
+    m_minValueChange = minValueChange;
+}
+
+/*! Returns the interval in milliseconds in which state changes are collected and only the latest value of
+    each state is sent. If 0, state changes are sent immediately.
+*/
+int NotificationFilter::coalescingInterval() const
+{
+    return m_coalescingInterval;
+}
+
+/*! Sets the interval in which state changes are collected to \a coalescingInterval milliseconds. */
+void NotificationFilter::setCoalescingInterval(int coalescingInterval)
+{
+    m_coalescingInterval = coalescingInterval;
+}
+
+/*! Returns true if collected Integrations.StateChanged notifications are sent as a single Integrations.StateChangedBatch notification. */
+bool NotificationFilter::batchStateChanges() const
+{
+    return m_batchStateChanges;
+}
+
+/*! Sets whether collected state changes are sent in a single batch notification to \a batchStateChanges. */
+void NotificationFilter::setBatchStateChanges(bool batchStateChanges)
+{
+    m_batchStateChanges = batchStateChanges;
+}
+
+/*! Returns true if this filter does not change which notifications are sent or how. */
+bool NotificationFilter::isEmpty() const
+{
+    return m_thingIds.isEmpty() && m_interfaces.isEmpty() && m_stateTypeIds.isEmpty() && m_minValueChange <= 0
+            && m_coalescingInterval <= 0 && !m_batchStateChanges;
+}
+
+/*! Returns true if notifications about the thing with the given \a thingId pass this filter. The interfaces
+    are looked up in the class of \a thing. If \a thing is null, for instance because it has been removed
+    already, only the thingIds() are checked.
+*/
+bool NotificationFilter::acceptsThing(const ThingId &thingId, Thing *thing) const
+{
+    if (!m_thingIds.isEmpty() && !m_thingIds.contains(thingId)) {
+        return false;
+    }
+    if (!m_interfaces.isEmpty() && thing) {
+        QHash<ThingClassId, bool>::const_iterator it = m_acceptedThingClasses.constFind(thing->thingClassId());
+        if (it != m_acceptedThingClasses.constEnd()) {
+            return it.value();
+        }
+
+        bool accepted = false;
+        foreach (const QString &interface, thing->thingClass().interfaces()) {
+            if (m_interfaces.contains(interface)) {
+                accepted = true;
+                break;
+            }
+        }
+        m_acceptedThingClasses.insert(thing->thingClassId(), accepted);
+        return accepted;
+    }
+    return true;
+}
+
+/*! Returns true if the change of the state \a stateTypeId of the thing \a thingId to \a value passes this filter.
+    Accepted numeric values are remembered as the last delivered value for the minValueChange() threshold.
+*/
+bool NotificationFilter::acceptsStateChange(const ThingId &thingId, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    if (!m_stateTypeIds.isEmpty() && !m_stateTypeIds.contains(stateTypeId)) {
+        return false;
+    }
+    if (m_minValueChange <= 0) {
+        return true;
+    }
+
+    bool isNumber = false;
+    double number = value.toDouble(&isNumber);
+    if (!isNumber || value.type() == QVariant::Bool || value.type() == QVariant::String) {
+        return true;
+    }
+
+    QHash<StateTypeId, double> &deliveredValues = m_deliveredValues[thingId];
+    if (deliveredValues.contains(stateTypeId) && qAbs(number - deliveredValues.value(stateTypeId)) < m_minValueChange) {
+        return false;
+    }
+    deliveredValues.insert(stateTypeId, number);
+    return true;
+}
+
+}
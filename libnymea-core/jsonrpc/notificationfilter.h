@@ -0,0 +1,96 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef NOTIFICATIONFILTER_H
+#define NOTIFICATIONFILTER_H
+
+#include "typeutils.h"
+
+class Thing;
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+
+namespace nymeaserver {
+
+class NotificationFilter
+{
+public:
+    NotificationFilter();
+
+    static NotificationFilter fromMap(const QVariantMap &map);
+    QVariantMap toMap() const;
+
+    static ThingId notificationThingId(const QVariantMap &params);
+
+    QList<ThingId> thingIds() const;
+    void setThingIds(const QList<ThingId> &thingIds);
+
+    QStringList interfaces() const;
+    void setInterfaces(const QStringList &interfaces);
+
+    QList<StateTypeId> stateTypeIds() const;
+    void setStateTypeIds(const QList<StateTypeId> &stateTypeIds);
+
+    double minValueChange() const;
+    void setMinValueChange(double minValueChange);
+
+    int coalescingInterval() const;
+    void setCoalescingInterval(int coalescingInterval);
+
+    bool batchStateChanges() const;
+    void setBatchStateChanges(bool batchStateChanges);
+
+    bool isEmpty() const;
+
+    bool acceptsThing(const ThingId &thingId, Thing *thing) const;
+    bool acceptsStateChange(const ThingId &thingId, const StateTypeId &stateTypeId, const QVariant &value);
+
+private:
+    QSet<ThingId> m_thingIds;
+    QStringList m_interfaces;
+    QSet<StateTypeId> m_stateTypeIds;
+
+    // Whether things of a class implement one of m_interfaces, so the class is only looked at once
+    mutable QHash<ThingClassId, bool> m_acceptedThingClasses;
+    double m_minValueChange = 0;
+    int m_coalescingInterval = 0;
+    bool m_batchStateChanges = false;
+
+    // Last numeric value delivered per thing and state type, used for the minValueChange threshold
+    QHash<ThingId, QHash<StateTypeId, double>> m_deliveredValues;
+};
+
+}
+
+#endif // NOTIFICATIONFILTER_H
@@ -30,6 +30,8 @@
 
 #include "systemhandler.h"
 
+#include "nymeacore.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
 #include "platform/platform.h"
 #include "platform/platformupdatecontroller.h"
 #include "platform/platformsystemcontroller.h"
@@ -44,6 +46,14 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     registerObject<Package, Packages>();
     registerObject<Repository, Repositories>();
 
+    QVariantMap sendQueue;
+    sendQueue.insert("clientId", enumValueName(Uuid));
+    sendQueue.insert("queuedMessages", enumValueName(Uint));
+    sendQueue.insert("queuedBytes", enumValueName(Uint));
+    sendQueue.insert("droppedNotifications", enumValueName(Uint));
+    sendQueue.insert("coalescedNotifications", enumValueName(Uint));
+    registerObject("SendQueue", sendQueue);
+
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
     description = "Get the list of capabilites on this system. The property \"powerManagement\" indicates whether "
@@ -168,6 +178,13 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     returns.insert("timeZones", enumValueName(StringList));
     registerMethod("GetTimeZones", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Returns the outgoing message queues of all connected clients. Messages are queued while a client "
+                  "does not read its data fast enough. Queued notifications are coalesced with newer ones for the same "
+                  "state or dropped if the queue grows too large. Replies are never dropped.";
+    returns.insert("sendQueues", QVariantList() << objectRef("SendQueue"));
+    registerMethod("GetSendQueues", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever the system capabilities change.";
@@ -446,6 +463,27 @@ JsonReply *SystemHandler::GetTimeZones(const QVariantMap &params) const
     return createReply(returns);
 }
 
+JsonReply *SystemHandler::GetSendQueues(const QVariantMap &params) const
+{
+    Q_UNUSED(params)
+    QVariantList sendQueues;
+    QHash<QUuid, SendQueue::Statistics> statistics = NymeaCore::instance()->jsonRPCServer()->sendQueueStatistics();
+    foreach (const QUuid &clientId, statistics.keys()) {
+        SendQueue::Statistics clientStatistics = statistics.value(clientId);
+        QVariantMap sendQueue;
+        sendQueue.insert("clientId", clientId);
+        sendQueue.insert("queuedMessages", clientStatistics.queuedMessages);
+        sendQueue.insert("queuedBytes", clientStatistics.queuedBytes);
+        sendQueue.insert("droppedNotifications", clientStatistics.droppedNotifications);
+        sendQueue.insert("coalescedNotifications", clientStatistics.coalescedNotifications);
+        sendQueues.append(sendQueue);
+    }
+
+    QVariantMap returns;
+    returns.insert("sendQueues", sendQueues);
+    return createReply(returns);
+}
+
 void SystemHandler::onCapabilitiesChanged()
 {
     QVariantMap caps;
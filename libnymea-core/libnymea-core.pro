@@ -26,6 +26,7 @@ HEADERS += nymeacore.h \
     ruleengine/ruleengine.h \
     ruleengine/rule.h \
     ruleengine/stateevaluator.h \
+    ruleengine/compiledstateevaluator.h \
     ruleengine/ruleaction.h \
     ruleengine/ruleactionparam.h \
     scriptengine/script.h \
@@ -38,8 +39,10 @@ HEADERS += nymeacore.h \
     nymeaconfiguration.h \
     servermanager.h \
     servers/tcpserver.h \
+    servers/sendqueue.h \
     servers/mocktcpserver.h \
     servers/webserver.h \
+    servers/webserverassetcache.h \
     servers/httprequest.h \
     servers/httpreply.h \
     servers/bluetoothserver.h \
@@ -47,6 +50,8 @@ HEADERS += nymeacore.h \
     servers/mqttbroker.h \
     jsonrpc/jsonrpcserverimplementation.h \
     jsonrpc/jsonvalidator.h \
+    jsonrpc/jsonframer.h \
+    jsonrpc/notificationfilter.h \
     jsonrpc/integrationshandler.h \
     jsonrpc/devicehandler.h \
     jsonrpc/ruleshandler.h \
@@ -64,7 +69,10 @@ HEADERS += nymeacore.h \
     logging/logengine.h \
     logging/logfilter.h \
     logging/logentry.h \
+    logging/aggregatedvalue.h \
     logging/logvaluetool.h \
+    logging/databaseworker.h \
+    logging/mpscqueue.h \
     time/timemanager.h \
     usermanager/userinfo.h \
     usermanager/usermanager.h \
@@ -105,6 +113,7 @@ SOURCES += nymeacore.cpp \
     ruleengine/ruleengine.cpp \
     ruleengine/rule.cpp \
     ruleengine/stateevaluator.cpp \
+    ruleengine/compiledstateevaluator.cpp \
     ruleengine/ruleaction.cpp \
     ruleengine/ruleactionparam.cpp \
     scriptengine/script.cpp \
@@ -117,8 +126,10 @@ SOURCES += nymeacore.cpp \
     nymeaconfiguration.cpp \
     servermanager.cpp \
     servers/tcpserver.cpp \
+    servers/sendqueue.cpp \
     servers/mocktcpserver.cpp \
     servers/webserver.cpp \
+    servers/webserverassetcache.cpp \
     servers/httprequest.cpp \
     servers/httpreply.cpp \
     servers/websocketserver.cpp \
@@ -126,6 +137,8 @@ SOURCES += nymeacore.cpp \
     servers/mqttbroker.cpp \
     jsonrpc/jsonrpcserverimplementation.cpp \
     jsonrpc/jsonvalidator.cpp \
+    jsonrpc/jsonframer.cpp \
+    jsonrpc/notificationfilter.cpp \
     jsonrpc/integrationshandler.cpp \
     jsonrpc/devicehandler.cpp \
     jsonrpc/ruleshandler.cpp \
@@ -142,7 +155,9 @@ SOURCES += nymeacore.cpp \
     logging/logengine.cpp \
     logging/logfilter.cpp \
     logging/logentry.cpp \
+    logging/aggregatedvalue.cpp \
     logging/logvaluetool.cpp \
+    logging/databaseworker.cpp \
     time/timemanager.cpp \
     usermanager/userinfo.cpp \
     usermanager/usermanager.cpp \
@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::AggregatedValue
+    \brief Represents a time bucket of aggregated state values from the log database.
+
+    \ingroup logs
+    \inmodule core
+
+    An \l{AggregatedValue} summarizes all numeric values a state had within a time bucket
+    of the requested resolution. The timestamp marks the start of the bucket.
+
+    \sa LogEngine, LoggingHandler
+*/
+
+#include "aggregatedvalue.h"
+
+namespace nymeaserver {
+
+AggregatedValue::AggregatedValue()
+{
+
+}
+
+/*! Constructs an \l{AggregatedValue} for the bucket starting at \a timestamp, containing \a count values. */
+AggregatedValue::AggregatedValue(const QDateTime &timestamp, double minimum, double maximum, double average, const QVariant &last, int count):
+    m_timestamp(timestamp),
+    m_minimum(minimum),
+    m_maximum(maximum),
+    m_average(average),
+    m_last(last),
+    m_count(count)
+{
+
+}
+
+/*! Returns the start of the time bucket. */
+QDateTime AggregatedValue::timestamp() const
+{
+    return m_timestamp;
+}
+
+/*! Returns the smallest value within the bucket. */
+double AggregatedValue::minimum() const
+{
+    return m_minimum;
+}
+
+/*! Returns the largest value within the bucket. */
+double AggregatedValue::maximum() const
+{
+    return m_maximum;
+}
+
+/*! Returns the average of all values within the bucket. */
+double AggregatedValue::average() const
+{
+    return m_average;
+}
+
+/*! Returns the most recent value within the bucket. */
+QVariant AggregatedValue::last() const
+{
+    return m_last;
+}
+
+/*! Returns the number of log entries aggregated into this bucket. */
+int AggregatedValue::count() const
+{
+    return m_count;
+}
+
+AggregatedValues::AggregatedValues()
+{
+
+}
+
+AggregatedValues::AggregatedValues(const QList<AggregatedValue> &other): QList<AggregatedValue>(other)
+{
+
+}
+
+QVariant AggregatedValues::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void AggregatedValues::put(const QVariant &variant)
+{
+    append(variant.value<AggregatedValue>());
+}
+
+}
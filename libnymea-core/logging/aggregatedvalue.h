@@ -0,0 +1,85 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef AGGREGATEDVALUE_H
+#define AGGREGATEDVALUE_H
+
+#include <QObject>
+#include <QVariant>
+#include <QDateTime>
+
+namespace nymeaserver {
+
+class AggregatedValue
+{
+    Q_GADGET
+    Q_PROPERTY(QDateTime timestamp READ timestamp)
+    Q_PROPERTY(double minimum READ minimum)
+    Q_PROPERTY(double maximum READ maximum)
+    Q_PROPERTY(double average READ average)
+    Q_PROPERTY(QVariant last READ last)
+    Q_PROPERTY(int count READ count)
+
+public:
+    AggregatedValue();
+    AggregatedValue(const QDateTime &timestamp, double minimum, double maximum, double average, const QVariant &last, int count);
+
+    QDateTime timestamp() const;
+    double minimum() const;
+    double maximum() const;
+    double average() const;
+    QVariant last() const;
+    int count() const;
+
+private:
+    QDateTime m_timestamp;
+    double m_minimum = 0;
+    double m_maximum = 0;
+    double m_average = 0;
+    QVariant m_last;
+    int m_count = 0;
+};
+
+class AggregatedValues: public QList<AggregatedValue>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    AggregatedValues();
+    AggregatedValues(const QList<AggregatedValue> &other);
+    Q_INVOKABLE QVariant get(int index) const;
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+
+}
+Q_DECLARE_METATYPE(nymeaserver::AggregatedValue)
+Q_DECLARE_METATYPE(nymeaserver::AggregatedValues)
+
+#endif // AGGREGATEDVALUE_H
@@ -0,0 +1,181 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "databaseworker.h"
+#include "logengine.h"
+#include "loggingcategories.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+
+namespace nymeaserver {
+
+DatabaseWorker::DatabaseWorker(const QString &connectionName, bool readOnly, QObject *parent):
+    QThread(parent),
+    m_connectionName(connectionName),
+    m_readOnly(readOnly)
+{
+
+}
+
+DatabaseWorker::~DatabaseWorker()
+{
+    stop();
+}
+
+void DatabaseWorker::setDatabase(const QString &driver, const QString &dbName, const QString &hostname, const QString &username, const QString &password)
+{
+    // Only to be called while the thread is not running
+    Q_ASSERT_X(!isRunning(), "DatabaseWorker", "Database settings can't be changed while the worker is running");
+    m_driver = driver;
+    m_dbName = dbName;
+    m_hostname = hostname;
+    m_username = username;
+    m_password = password;
+}
+
+void DatabaseWorker::enqueue(DatabaseJob *job)
+{
+    m_queue.enqueue(job);
+    m_available.release();
+}
+
+void DatabaseWorker::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    // A null job terminates the worker after all jobs queued before have been processed
+    m_queue.enqueue(nullptr);
+    m_available.release();
+    wait();
+}
+
+void DatabaseWorker::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(m_driver, m_connectionName);
+        db.setDatabaseName(m_dbName);
+        db.setHostName(m_hostname);
+        if (m_readOnly && m_driver == "QSQLITE") {
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        }
+
+        if (!db.open(m_username, m_password)) {
+            qCWarning(dcLogEngine()) << "Error opening database connection" << m_connectionName << "Driver error:" << db.lastError().driverText() << "Database error:" << db.lastError().databaseText();
+        } else {
+            qCDebug(dcLogEngine()) << "Opened database connection" << m_connectionName << (m_readOnly ? "(read only)" : "");
+        }
+
+        forever {
+            m_available.acquire();
+
+            // The semaphore guarantees there is a job, but a producer might not have finished linking it yet
+            DatabaseJob *job = nullptr;
+            while (!m_queue.dequeue(job)) {
+                QThread::yieldCurrentThread();
+            }
+
+            if (!job) {
+                break;
+            }
+
+            runJob(db, job);
+            emit jobFinished(job);
+        }
+
+        m_preparedQueries.clear();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+    qCDebug(dcLogEngine()) << "Closed database connection" << m_connectionName;
+}
+
+void DatabaseWorker::runJob(QSqlDatabase &db, DatabaseJob *job)
+{
+    if (!db.isOpen()) {
+        job->m_error = db.lastError();
+        return;
+    }
+
+    if (!job->m_batchValues.isEmpty()) {
+        QHash<QString, QSqlQuery>::iterator it = m_preparedQueries.find(job->m_queryString);
+        if (it == m_preparedQueries.end()) {
+            QSqlQuery query(db);
+            query.prepare(job->m_queryString);
+            it = m_preparedQueries.insert(job->m_queryString, query);
+        }
+        QSqlQuery &query = it.value();
+
+        db.transaction();
+        foreach (const QVariantList &row, job->m_batchValues) {
+            for (int i = 0; i < row.count(); i++) {
+                query.bindValue(i, row.at(i));
+            }
+            if (!query.exec()) {
+                break;
+            }
+        }
+
+        job->m_error = query.lastError();
+        job->m_executedQuery = query.executedQuery();
+
+        if (job->m_error.isValid()) {
+            db.rollback();
+            // Don't keep a statement around which might be in a broken state
+            m_preparedQueries.remove(job->m_queryString);
+        } else if (!db.commit()) {
+            job->m_error = db.lastError();
+        }
+        return;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(job->m_queryString);
+
+    foreach (const QString &value, job->m_bindValues) {
+        query.addBindValue(value);
+    }
+
+    query.exec();
+
+    job->m_error = query.lastError();
+    job->m_executedQuery = query.executedQuery();
+    job->m_rowsAffected = query.numRowsAffected();
+
+    if (!query.lastError().isValid()) {
+        while (query.next()) {
+            job->m_results.append(query.record());
+        }
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef DATABASEWORKER_H
+#define DATABASEWORKER_H
+
+#include "mpscqueue.h"
+
+#include <QThread>
+#include <QSemaphore>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QHash>
+
+namespace nymeaserver {
+
+class DatabaseJob;
+
+class DatabaseWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit DatabaseWorker(const QString &connectionName, bool readOnly, QObject *parent = nullptr);
+    ~DatabaseWorker() override;
+
+    void setDatabase(const QString &driver, const QString &dbName, const QString &hostname, const QString &username, const QString &password);
+
+    void enqueue(DatabaseJob *job);
+    void stop();
+
+signals:
+    void jobFinished(DatabaseJob *job);
+
+protected:
+    void run() override;
+
+private:
+    void runJob(QSqlDatabase &db, DatabaseJob *job);
+
+    QString m_connectionName;
+    bool m_readOnly = false;
+
+    QString m_driver;
+    QString m_dbName;
+    QString m_hostname;
+    QString m_username;
+    QString m_password;
+
+    MpscQueue<DatabaseJob> m_queue;
+    QSemaphore m_available;
+
+    // Prepared statements for batch jobs, only used from within the worker thread
+    QHash<QString, QSqlQuery> m_preparedQueries;
+};
+
+}
+
+#endif // DATABASEWORKER_H
@@ -33,6 +33,7 @@
 #include "loggingcategories.h"
 #include "logging.h"
 #include "logvaluetool.h"
+#include "databaseworker.h"
 
 #include <QCoreApplication>
 #include <QSqlDatabase>
@@ -44,17 +45,17 @@
 #include <QDateTime>
 #include <QFileInfo>
 #include <QTime>
-#include <QtConcurrent/QtConcurrent>
 
-#define DB_SCHEMA_VERSION 4
+#define DB_SCHEMA_VERSION 6
 
 namespace nymeaserver {
 
 // IMPORTANT:
-// DatabaseJobs run threaded, however, QSql is *not* threadsafe.
-// It is crucial to *not* access m_db while the job queue is being processed.
-// That is, entire setup of the DB must happen before processQueue() is called
-// and teardown must happen only after the job queue is empty.
+// DatabaseJobs are executed by two DatabaseWorker threads, each owning its own connection.
+// Writes are processed in order by the writer, reads (fetching entries) are run on a separate,
+// read only connection so they don't need to wait for housekeeping or migrations.
+// m_db is only used from the main thread to set up the schema (initDB, migrations) and
+// must only be opened while the workers are stopped.
 
 LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString &hostname, const QString &username, const QString &password, int maxDBSize, QObject *parent):
     QObject(parent),
@@ -66,7 +67,22 @@ LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString
     m_db.setDatabaseName(dbName);
     m_db.setHostName(hostname);
     m_trimSize = qRound(0.01 * m_dbMaxSize);
-    m_maxQueueLength = 1000;
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(m_flushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LogEngine::flushPendingEntries);
+
+    m_housekeepingTimer.setSingleShot(true);
+    m_housekeepingTimer.setInterval(100);
+    connect(&m_housekeepingTimer, &QTimer::timeout, this, &LogEngine::housekeeping);
+
+    m_retentionTimer.setInterval(60 * 60 * 1000);
+    connect(&m_retentionTimer, &QTimer::timeout, this, &LogEngine::applyRetentionPolicies);
+
+    m_writer = new DatabaseWorker("logs-writer", false, this);
+    connect(m_writer, &DatabaseWorker::jobFinished, this, &LogEngine::handleJobFinished, Qt::QueuedConnection);
+    m_reader = new DatabaseWorker("logs-reader", true, this);
+    connect(m_reader, &DatabaseWorker::jobFinished, this, &LogEngine::handleJobFinished, Qt::QueuedConnection);
 
     qCDebug(dcLogEngine) << "Opening logging database" << m_db.databaseName() << "(Max size:" << m_dbMaxSize << "trim size:" << m_trimSize << ")";
 
@@ -86,20 +102,28 @@ LogEngine::LogEngine(const QString &driver, const QString &dbName, const QString
         }
     }
 
-    connect(&m_jobWatcher, SIGNAL(finished()), this, SLOT(handleJobFinished()));
+    startWorkers();
     checkDBSize();
+    m_retentionTimer.start();
 }
 
 LogEngine::~LogEngine()
 {
+    // Write out what's still waiting for the next batch
+    flushPendingEntries();
+
     // Process the job queue before allowing to shut down
-    while (m_currentJob) {
-        qCDebug(dcLogEngine()) << "Waiting for job to finish... (" << m_jobQueue.count() << "jobs left in queue)";
-        m_jobWatcher.waitForFinished();
-        // Make sure that the job queue is processes
-        // We can't call processQueue ourselves because thread synchronisation is done via queued connections
-        qApp->processEvents();
+    while (m_runningJobs > 0) {
+        qCDebug(dcLogEngine()) << "Waiting for jobs to finish... (" << m_runningJobs << "jobs left in queue)";
+        // Job results are delivered via queued connections
+        qApp->processEvents(QEventLoop::WaitForMoreEvents);
     }
+
+    m_writer->stop();
+    m_reader->stop();
+    qDeleteAll(m_heldJobs);
+    qDeleteAll(m_readsAfterFlush);
+
     qCDebug(dcLogEngine()) << "Closing Database";
     m_db.close();
 }
@@ -116,17 +140,18 @@ LogEntriesFetchJob *LogEngine::fetchLogEntries(const LogFilter &filter)
         limitString.append(QString("OFFSET %1").arg(QString::number(filter.offset())));
     }
 
+    // The rowid is used as tie breaker for entries with the same timestamp and to create the cursor for the next page
     QString queryString;
     if (filter.isEmpty()) {
-        queryString = QString("SELECT * FROM entries ORDER BY timestamp DESC %1;").arg(limitString);
+        queryString = QString("SELECT rowid, * FROM entries ORDER BY timestamp DESC, rowid DESC %1;").arg(limitString);
     } else {
-        queryString = QString("SELECT * FROM entries WHERE %1 ORDER BY timestamp DESC %2;").arg(filter.queryString()).arg(limitString);
+        queryString = QString("SELECT rowid, * FROM entries WHERE %1 ORDER BY timestamp DESC, rowid DESC %2;").arg(filter.queryString()).arg(limitString);
     }
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString, filter.values());
+    DatabaseJob *job = new DatabaseJob(queryString, filter.values());
     LogEntriesFetchJob *fetchJob = new LogEntriesFetchJob(this);
 
-    connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
+    connect(job, &DatabaseJob::finished, this, [job, fetchJob, filter](){
         fetchJob->deleteLater();
         if (job->error().isValid()) {
             qCWarning(dcLogEngine) << "Error fetching log entries. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
@@ -148,12 +173,91 @@ LogEntriesFetchJob *LogEngine::fetchLogEntries(const LogFilter &filter)
 
             fetchJob->m_results.append(entry);
         }
+
+        // If the page is full there might be more entries
+        if (filter.limit() > 0 && job->results().count() == filter.limit()) {
+            const QSqlRecord &last = job->results().last();
+            fetchJob->m_nextCursor = LogFilter::createCursor(last.value("timestamp").toLongLong(), last.value("rowid").toLongLong());
+        }
         qCDebug(dcLogEngine) << "Fetched" << fetchJob->results().count() << "entries for db query:" << job->executedQuery();
         fetchJob->finished();
     });
 
-    enqueJob(job, true);
+    // Don't let entries wait for the flush timer when someone is interested in them
+    enqueReadAfterFlush(job);
+
+    return fetchJob;
+}
+
+AggregatedValuesFetchJob *LogEngine::fetchAggregatedValues(const ThingId &thingId, const StateTypeId &stateTypeId, Logging::AggregationResolution resolution, const QDateTime &from, const QDateTime &to)
+{
+    qint64 bucketSize = 0;
+    switch (resolution) {
+    case Logging::AggregationResolution1Minute:
+        bucketSize = 60 * 1000;
+        break;
+    case Logging::AggregationResolution15Minutes:
+        bucketSize = 15 * 60 * 1000;
+        break;
+    case Logging::AggregationResolution1Hour:
+        bucketSize = 60 * 60 * 1000;
+        break;
+    case Logging::AggregationResolution1Day:
+        bucketSize = 24 * 60 * 60 * 1000;
+        break;
+    }
+
+    QString filterString = QString("thingId = '%1' AND typeId = '%2' AND sourceType = %3")
+            .arg(thingId.toString())
+            .arg(stateTypeId.toString())
+            .arg(Logging::LoggingSourceStates);
+    if (from.isValid()) {
+        filterString.append(QString(" AND timestamp >= %1").arg(from.toMSecsSinceEpoch()));
+    }
+    if (to.isValid()) {
+        filterString.append(QString(" AND timestamp <= %1").arg(to.toMSecsSinceEpoch()));
+    }
+
+    // Buckets are grouped in the database using the (thingId, typeId, timestamp) index. The last value
+    // of each bucket is looked up by the newest timestamp, so only one row per bucket is transferred.
+    QString queryString = QString("SELECT buckets.*, "
+                                  "(SELECT value FROM entries WHERE %1 AND timestamp = buckets.lastTimestamp ORDER BY rowid DESC LIMIT 1) AS lastValue "
+                                  "FROM (SELECT (timestamp / %2) * %2 AS bucket, "
+                                  "MIN(CAST(value AS REAL)) AS minimum, "
+                                  "MAX(CAST(value AS REAL)) AS maximum, "
+                                  "AVG(CAST(value AS REAL)) AS average, "
+                                  "COUNT(*) AS count, "
+                                  "MAX(timestamp) AS lastTimestamp "
+                                  "FROM entries WHERE %1 GROUP BY bucket) AS buckets "
+                                  "ORDER BY buckets.bucket ASC;")
+            .arg(filterString)
+            .arg(bucketSize);
+
+    DatabaseJob *job = new DatabaseJob(queryString);
+    AggregatedValuesFetchJob *fetchJob = new AggregatedValuesFetchJob(this);
+    connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
+        fetchJob->deleteLater();
+        if (job->error().isValid()) {
+            qCWarning(dcLogEngine) << "Error fetching aggregated values. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            fetchJob->finished();
+            return;
+        }
+
+        foreach (const QSqlRecord &result, job->results()) {
+            fetchJob->m_results.append(AggregatedValue(QDateTime::fromMSecsSinceEpoch(result.value("bucket").toLongLong()),
+                                                       result.value("minimum").toDouble(),
+                                                       result.value("maximum").toDouble(),
+                                                       result.value("average").toDouble(),
+                                                       result.value("lastValue").toString(),
+                                                       result.value("count").toInt()));
+        }
+        fetchJob->m_success = true;
+        qCDebug(dcLogEngine) << "Fetched" << fetchJob->results().count() << "aggregated values for db query:" << job->executedQuery();
+        fetchJob->finished();
+    });
 
+    // Make sure the latest values are part of the result
+    enqueReadAfterFlush(job);
     return fetchJob;
 }
 
@@ -161,7 +265,7 @@ ThingsFetchJob *LogEngine::fetchThings()
 {
     QString queryString = QString("SELECT thingId FROM entries WHERE thingId != \"%1\" GROUP BY thingId;").arg(QUuid().toString());
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryString);
+    DatabaseJob *job = new DatabaseJob(queryString);
     ThingsFetchJob *fetchJob = new ThingsFetchJob(this);
     connect(job, &DatabaseJob::finished, this, [job, fetchJob](){
         fetchJob->deleteLater();
@@ -180,9 +284,41 @@ ThingsFetchJob *LogEngine::fetchThings()
     return fetchJob;
 }
 
+/*! Writes a consistent copy of the log database to \a fileName, which must not exist or be empty.
+    The copy contains all entries logged until now and is made by the database worker, so
+    writing new entries continues meanwhile. Only supported for SQLite databases.
+*/
+DatabaseSnapshotJob *LogEngine::createSnapshot(const QString &fileName)
+{
+    DatabaseSnapshotJob *snapshotJob = new DatabaseSnapshotJob(fileName, this);
+
+    if (m_db.driverName() != "QSQLITE") {
+        qCWarning(dcLogEngine()) << "Creating a snapshot is not supported for database driver" << m_db.driverName();
+        snapshotJob->deleteLater();
+        QMetaObject::invokeMethod(snapshotJob, "finished", Qt::QueuedConnection);
+        return snapshotJob;
+    }
+
+    DatabaseJob *job = new DatabaseJob("VACUUM INTO ?;", QStringList() << fileName);
+    connect(job, &DatabaseJob::finished, this, [job, snapshotJob](){
+        snapshotJob->deleteLater();
+        if (job->error().isValid()) {
+            qCWarning(dcLogEngine()) << "Error creating database snapshot. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            snapshotJob->finished();
+            return;
+        }
+        snapshotJob->m_success = true;
+        snapshotJob->finished();
+    });
+
+    // Make sure the latest entries are part of the snapshot
+    enqueReadAfterFlush(job);
+    return snapshotJob;
+}
+
 bool LogEngine::jobsRunning() const
 {
-    return !m_jobQueue.isEmpty() || m_currentJob;
+    return m_runningJobs > 0 || !m_heldJobs.isEmpty() || !m_pendingEntries.isEmpty() || !m_readsAfterFlush.isEmpty() || m_housekeepingTimer.isActive();
 }
 
 void LogEngine::setMaxLogEntries(int maxLogEntries, int trimSize)
@@ -192,13 +328,51 @@ void LogEngine::setMaxLogEntries(int maxLogEntries, int trimSize)
     trim();
 }
 
+void LogEngine::setRetentionPolicy(Logging::LoggingSource source, int maxAgeDays)
+{
+    if (maxAgeDays > 0) {
+        m_sourceRetentionPolicies.insert(source, maxAgeDays);
+    } else {
+        m_sourceRetentionPolicies.remove(source);
+    }
+    // Apply it on the next event loop run, after all policies have been set up
+    QMetaObject::invokeMethod(this, "applyRetentionPolicies", Qt::QueuedConnection);
+}
+
+void LogEngine::setThingRetentionPolicy(const ThingId &thingId, int maxAgeDays)
+{
+    if (maxAgeDays > 0) {
+        m_thingRetentionPolicies.insert(thingId, maxAgeDays);
+    } else {
+        m_thingRetentionPolicies.remove(thingId);
+    }
+    QMetaObject::invokeMethod(this, "applyRetentionPolicies", Qt::QueuedConnection);
+}
+
+void LogEngine::setWriteBatching(int flushInterval, int maxBatchSize)
+{
+    m_flushInterval = qMax(0, flushInterval);
+    m_maxBatchSize = qMax(1, maxBatchSize);
+    m_flushTimer.setInterval(m_flushInterval);
+    qCDebug(dcLogEngine()) << "Write batching set to" << m_flushInterval << "ms, max" << m_maxBatchSize << "entries per batch";
+
+    if (m_pendingEntries.count() >= m_maxBatchSize) {
+        flushPendingEntries();
+    }
+}
+
 void LogEngine::clearDatabase()
 {
     qCWarning(dcLogEngine) << "Clearing logging database.";
 
+    // Entries which have not been written yet would end up in the db after clearing it
+    m_flushTimer.stop();
+    m_pendingEntries.clear();
+    m_trimming = false;
+
     QString queryDeleteString = QString("DELETE FROM entries;");
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
+    DatabaseJob *job = new DatabaseJob(queryDeleteString);
 
     connect(job, &DatabaseJob::finished, this, [this, job](){
         if (job->error().type() != QSqlError::NoError) {
@@ -332,9 +506,15 @@ void LogEngine::removeThingLogs(const ThingId &thingId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from device" << thingId.toString();
 
+    for (int i = m_pendingEntries.count() - 1; i >= 0; i--) {
+        if (m_pendingEntries.at(i).thingId() == thingId) {
+            m_pendingEntries.removeAt(i);
+        }
+    }
+
     QString queryDeleteString = QString("DELETE FROM entries WHERE thingId = '%1';").arg(thingId.toString());
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
+    DatabaseJob *job = new DatabaseJob(queryDeleteString);
     connect(job, &DatabaseJob::finished, this, [this, job, thingId](){
         if (job->error().type() != QSqlError::NoError) {
             qCWarning(dcLogEngine) << "Error deleting log entries from device" << thingId.toString() << ". Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
@@ -352,9 +532,15 @@ void LogEngine::removeRuleLogs(const RuleId &ruleId)
 {
     qCDebug(dcLogEngine) << "Deleting log entries from rule" << ruleId.toString();
 
+    for (int i = m_pendingEntries.count() - 1; i >= 0; i--) {
+        if (m_pendingEntries.at(i).typeId() == ruleId) {
+            m_pendingEntries.removeAt(i);
+        }
+    }
+
     QString queryDeleteString = QString("DELETE FROM entries WHERE typeId = '%1';").arg(ruleId.toString());
 
-    DatabaseJob *job = new DatabaseJob(m_db, queryDeleteString);
+    DatabaseJob *job = new DatabaseJob(queryDeleteString);
 
     connect(job, &DatabaseJob::finished, this, [this, job, ruleId](){
 
@@ -372,60 +558,109 @@ void LogEngine::removeRuleLogs(const RuleId &ruleId)
 
 void LogEngine::appendLogEntry(const LogEntry &entry)
 {
-    QString queryString = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values ('%1', '%2', '%3', '%4', '%5', '%6', '%7', '%8', '%9');")
-            .arg(entry.timestamp().toMSecsSinceEpoch())
-            .arg(entry.eventType())
-            .arg(entry.level())
-            .arg(entry.source())
-            .arg(entry.typeId().toString())
-            .arg(entry.thingId().toString())
-            .arg(entry.value().toString())
-            .arg(entry.active())
-            .arg(entry.errorCode());
-
-    DatabaseJob *job = new DatabaseJob(m_db, queryString);
-
-    // Check for log flooding. If we are exceeding the queue we'll start flagging log events of a certain type.
-    // If we'll get more log events of the same type while the queue is still exceededd, we'll discard the old
-    // ones and queue up the new one instead. The most recent one is more important (i.e. we don't want to lose
-    // the last event in a series).
-    if (m_jobQueue.count() > m_maxQueueLength) {
-        qCDebug(dcLogEngine()) << "An excessive amount of data is being logged. (" << m_jobQueue.length() << "jobs in the queue)";
-        if (m_flaggedJobs.contains(entry.typeId().toString() + entry.thingId().toString())) {
-            if (m_flaggedJobs.value(entry.typeId().toString() + entry.thingId().toString()).count() > 10) {
-                qCWarning(dcLogEngine()) << "Discarding log entry because of excessive log flooding.";
-                DatabaseJob *job = m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].takeFirst();
-                int jobIdx = m_jobQueue.indexOf(job);
-                m_jobQueue.takeAt(jobIdx)->deleteLater();
-            }
-        }
-        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].append(job);
+    m_pendingEntries.append(entry);
+
+    if (m_pendingEntries.count() >= m_maxBatchSize) {
+        flushPendingEntries();
+        return;
+    }
+
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void LogEngine::flushPendingEntries()
+{
+    m_flushTimer.stop();
+
+    if (m_pendingEntries.isEmpty()) {
+        return;
+    }
+
+    // Only one batch is written at a time. Entries logged in the meantime are collected and
+    // written as the next batch once the current one is done. This keeps the queue short when
+    // the database can't keep up, without having to discard any entries.
+    if (m_batchJob) {
+        return;
+    }
+
+    QList<QVariantList> rows;
+    foreach (const LogEntry &entry, m_pendingEntries) {
+        QVariantList row;
+        row << entry.timestamp().toMSecsSinceEpoch()
+            << static_cast<int>(entry.eventType())
+            << static_cast<int>(entry.level())
+            << static_cast<int>(entry.source())
+            << entry.typeId().toString()
+            << entry.thingId().toString()
+            << entry.value().toString()
+            << entry.active()
+            << entry.errorCode();
+        rows.append(row);
     }
 
-    connect(job, &DatabaseJob::finished, this, [this, job, entry](){
+    QString queryString = QString("INSERT INTO entries (timestamp, loggingEventType, loggingLevel, sourceType, typeId, thingId, value, active, errorCode) values (?, ?, ?, ?, ?, ?, ?, ?, ?);");
+
+    DatabaseJob *job = new DatabaseJob(queryString, rows);
+    job->m_batchEntries = m_pendingEntries;
+    m_pendingEntries.clear();
 
-        m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].removeAll(job);
+    job->m_batch = ++m_startedBatches;
+
+    connect(job, &DatabaseJob::finished, this, [this, job](){
+        m_batchJob = nullptr;
+        m_committedBatches = job->m_batch;
 
         if (job->error().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error writing log entry. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
-            qCWarning(dcLogEngine) << entry;
+            qCWarning(dcLogEngine) << "Error writing" << job->m_batchEntries.count() << "log entries. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
             m_dbMalformed = true;
-            return;
-        }
+        } else {
+            foreach (const LogEntry &entry, job->m_batchEntries) {
+                emit logEntryAdded(entry);
+            }
 
+            m_entryCount += job->m_batchEntries.count();
+            trim();
+        }
 
-        emit logEntryAdded(entry);
+        // Release the reads waiting for this batch. Batches are committed in order, so they are at the front.
+        while (!m_readsAfterFlush.isEmpty() && m_readsAfterFlush.first()->m_batch <= m_committedBatches) {
+            enqueJob(m_readsAfterFlush.takeFirst(), true);
+        }
 
-        m_entryCount++;
-        trim();
+        // Write what has been collected while this batch was busy
+        flushPendingEntries();
     });
 
+    m_batchJob = job;
     enqueJob(job);
 }
 
+void LogEngine::enqueReadAfterFlush(DatabaseJob *job)
+{
+    flushPendingEntries();
+
+    // The reader has its own connection and would not wait for the writer. Hold the read back
+    // until the batch containing the entries logged so far is committed. If a batch is still
+    // busy, the pending entries go into the next one.
+    job->m_batch = m_pendingEntries.isEmpty() ? m_startedBatches : m_startedBatches + 1;
+    if (job->m_batch > m_committedBatches) {
+        m_readsAfterFlush.append(job);
+        return;
+    }
+
+    enqueJob(job, true);
+}
+
 void LogEngine::checkDBSize()
 {
-    DatabaseJob *job = new DatabaseJob(m_db, "SELECT COUNT(*) FROM entries;");
+    // On SQLite the entry count is maintained by triggers in the metadata table, no need to count the entries table
+    QString queryString = "SELECT data FROM metadata WHERE `key` = 'entryCount';";
+    if (m_db.driverName() != "QSQLITE") {
+        queryString = "SELECT COUNT(*) FROM entries;";
+    }
+    DatabaseJob *job = new DatabaseJob(queryString);
     connect(job, &DatabaseJob::finished, this, [this, job](){
         if (job->error().type() != QSqlError::NoError || job->results().count() == 0) {
             qCWarning(dcLogEngine()) << "Error fetching log DB size. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
@@ -433,6 +668,7 @@ void LogEngine::checkDBSize()
             return;
         }
         m_entryCount = job->results().first().value(0).toInt();
+        trim();
     });
     enqueJob(job, true);
 }
@@ -443,101 +679,204 @@ void LogEngine::trim()
         // No trimming required
         return;
     }
-    QDateTime startTime = QDateTime::currentDateTime();
 
-    QString queryDeleteString = QString("DELETE FROM entries WHERE ROWID IN (SELECT ROWID FROM entries ORDER BY timestamp DESC LIMIT -1 OFFSET %1);").arg(QString::number(m_dbMaxSize - m_trimSize));
+    if (!m_trimming) {
+        qCDebug(dcLogEngine()) << "Log database exceeds maximum size (" << m_entryCount << "entries). Scheduling housekeeping.";
+        m_trimming = true;
+    }
+
+    if (!m_housekeepingJob && !m_housekeepingTimer.isActive()) {
+        m_housekeepingTimer.start();
+    }
+}
 
-    DatabaseJob *deleteJob = new DatabaseJob(m_db, queryDeleteString);
+void LogEngine::applyRetentionPolicies()
+{
+    if (!m_retentionQueries.isEmpty()) {
+        // Previous run still in progress
+        return;
+    }
 
-    connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, startTime](){
-        if (deleteJob->error().type() != QSqlError::NoError) {
-            qCWarning(dcLogEngine) << "Error deleting oldest log entries to keep size. Driver error:" << deleteJob->error().driverText() << "Database error:" << deleteJob->error().databaseText();
-        }
-        qCDebug(dcLogEngine()) << "Ran housekeeping on log database in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms. (Deleted" << m_entryCount - (m_dbMaxSize - m_trimSize) << "entries)";
-        m_entryCount = m_dbMaxSize - m_trimSize;
+    QDateTime now = QDateTime::currentDateTime();
 
-        emit logDatabaseUpdated();
-    });
+    // Things with their own policy are handled separately
+    QStringList thingIds;
+    foreach (const ThingId &thingId, m_thingRetentionPolicies.keys()) {
+        thingIds.append(QString("'%1'").arg(thingId.toString()));
+    }
+    QString excludedThings;
+    if (!thingIds.isEmpty()) {
+        excludedThings = QString(" AND thingId NOT IN (%1)").arg(thingIds.join(", "));
+    }
 
-    qCDebug(dcLogEngine()) << "Scheduling housekeeping job.";
-    enqueJob(deleteJob, true);
-}
+    // The LIMIT (%1) will be filled in for each chunk
+    foreach (Logging::LoggingSource source, m_sourceRetentionPolicies.keys()) {
+        qint64 cutoff = now.addDays(-m_sourceRetentionPolicies.value(source)).toMSecsSinceEpoch();
+        m_retentionQueries.append(QString("DELETE FROM entries WHERE rowid IN (SELECT rowid FROM entries WHERE timestamp < %1 AND sourceType = %2%3 LIMIT %4);")
+                                  .arg(cutoff).arg(source).arg(excludedThings).arg("%1"));
+    }
+    foreach (const ThingId &thingId, m_thingRetentionPolicies.keys()) {
+        qint64 cutoff = now.addDays(-m_thingRetentionPolicies.value(thingId)).toMSecsSinceEpoch();
+        m_retentionQueries.append(QString("DELETE FROM entries WHERE rowid IN (SELECT rowid FROM entries WHERE timestamp < %1 AND thingId = '%2' LIMIT %3);")
+                                  .arg(cutoff).arg(thingId.toString()).arg("%1"));
+    }
 
-void LogEngine::enqueJob(DatabaseJob *job, bool priority)
-{
-    if (priority) {
-        m_jobQueue.prepend(job);
-    } else {
-        m_jobQueue.append(job);
+    if (!m_retentionQueries.isEmpty() && !m_housekeepingJob && !m_housekeepingTimer.isActive()) {
+        m_housekeepingTimer.start();
     }
-    qCDebug(dcLogEngine()) << "Scheduled job at position" << (priority ? 0 : m_jobQueue.count() - 1) << "(" << m_jobQueue.count() << "jobs in the queue)";
-    processQueue();
 }
 
-void LogEngine::processQueue()
+void LogEngine::housekeeping()
 {
-    if (!m_initialized) {
+    if (m_housekeepingJob) {
         return;
     }
 
-    if (m_jobQueue.isEmpty()) {
-        emit jobsRunningChanged();
-        return;
-    }
+    // Housekeeping deletes bounded chunks of entries, one at a time, so it never blocks the
+    // writer for long. The oldest entries are deleted first. Entries may be inserted with an
+    // older timestamp than existing ones, so they are ordered by timestamp with the rowid as tie
+    // breaker, which the timestamp index provides without sorting the table.
+    int chunkSize = m_housekeepingChunkSize;
+    bool trimJob = false;
+    QString queryString;
 
-    if (m_currentJob) {
-        return;
+    if (m_trimming) {
+        int targetSize = m_dbMaxSize - m_trimSize;
+        if (m_dbMaxSize == -1 || m_entryCount <= targetSize) {
+            m_trimming = false;
+        } else {
+            chunkSize = qMin(chunkSize, m_entryCount - targetSize);
+            queryString = QString("DELETE FROM entries WHERE rowid IN (SELECT rowid FROM entries ORDER BY timestamp ASC, rowid ASC LIMIT %1);").arg(chunkSize);
+            trimJob = true;
+        }
     }
 
-    emit jobsRunningChanged();
+    if (queryString.isEmpty() && !m_retentionQueries.isEmpty()) {
+        queryString = m_retentionQueries.first().arg(chunkSize);
+    }
 
-    if (m_dbMalformed) {
-        qCWarning(dcLogEngine()) << "Database is malformed. Trying to recover...";
-        m_db.close();
-        rotate(m_db.databaseName());
-        initDB(m_username, m_password);
-        m_dbMalformed = false;
+    if (queryString.isEmpty()) {
+        return;
     }
 
+    QDateTime startTime = QDateTime::currentDateTime();
+    DatabaseJob *job = new DatabaseJob(queryString);
+
+    connect(job, &DatabaseJob::finished, this, [this, job, startTime, chunkSize, trimJob](){
+        m_housekeepingJob = nullptr;
 
-    DatabaseJob *job = m_jobQueue.takeFirst();
-    qCDebug(dcLogEngine()) << "Processing DB queue. (" << m_jobQueue.count() << "jobs left in queue," << m_entryCount << "entries in DB)";
-    m_currentJob = job;
+        if (job->error().type() != QSqlError::NoError) {
+            qCWarning(dcLogEngine) << "Error deleting old log entries. Driver error:" << job->error().driverText() << "Database error:" << job->error().databaseText();
+            if (trimJob) {
+                m_trimming = false;
+            } else {
+                m_retentionQueries.removeFirst();
+            }
+        } else {
+            int deleted = job->rowsAffected();
+            qCDebug(dcLogEngine()) << "Ran housekeeping on log database in" << startTime.msecsTo(QDateTime::currentDateTime()) << "ms. (Deleted" << deleted << "entries)";
+            m_entryCount = qMax(0, m_entryCount - deleted);
+
+            if (trimJob && deleted == 0) {
+                // Our count seems to be off, fetch it again
+                m_trimming = false;
+                checkDBSize();
+            } else if (!trimJob && deleted < chunkSize) {
+                // This retention policy is done
+                m_retentionQueries.removeFirst();
+            }
 
-    QFuture<DatabaseJob*> future = QtConcurrent::run([job](){
-        QSqlQuery query(job->m_db);
-        query.prepare(job->m_queryString);
+            if (deleted > 0) {
+                emit logDatabaseUpdated();
+            }
+        }
 
-        foreach (const QString &value, job->m_bindValues) {
-            query.addBindValue(value);
+        if (m_trimming || !m_retentionQueries.isEmpty()) {
+            m_housekeepingTimer.start();
         }
+    });
 
-        query.exec();
+    m_housekeepingJob = job;
+    enqueJob(job);
+}
 
-        job->m_error = query.lastError();
-        job->m_executedQuery = query.executedQuery();
+void LogEngine::enqueJob(DatabaseJob *job, bool readOnly)
+{
+    job->m_readOnly = readOnly;
 
-        if (!query.lastError().isValid()) {
-            while (query.next()) {
-                job->m_results.append(query.record());
-            }
-        }
+    // Hold back jobs while the DB is not ready or needs to be recovered
+    if (!m_initialized || m_dbMalformed) {
+        m_heldJobs.append(job);
+        return;
+    }
 
-       return job;
-    });
+    dispatchJob(job);
+}
+
+void LogEngine::dispatchJob(DatabaseJob *job)
+{
+    if (m_runningJobs == 0) {
+        emit jobsRunningChanged();
+    }
+    m_runningJobs++;
 
-    m_jobWatcher.setFuture(future);
+    qCDebug(dcLogEngine()) << "Scheduling" << (job->m_readOnly ? "read" : "write") << "job. (" << m_runningJobs << "jobs in the queue)";
+    if (job->m_readOnly) {
+        m_reader->enqueue(job);
+    } else {
+        m_writer->enqueue(job);
+    }
 }
 
-void LogEngine::handleJobFinished()
+void LogEngine::handleJobFinished(DatabaseJob *job)
 {
-    DatabaseJob *job = m_jobWatcher.result();
+    m_runningJobs--;
     job->finished();
     job->deleteLater();
-    m_currentJob = nullptr;
 
-    qCDebug(dcLogEngine()) << "DB job finished. (" << m_entryCount << "entries in DB)";
-    processQueue();
+    qCDebug(dcLogEngine()) << "DB job finished. (" << m_runningJobs << "jobs left," << m_entryCount << "entries in DB)";
+
+    if (m_dbMalformed && m_runningJobs == 0) {
+        recoverDatabase();
+    }
+
+    if (!jobsRunning()) {
+        emit jobsRunningChanged();
+    }
+}
+
+void LogEngine::startWorkers()
+{
+    m_writer->setDatabase(m_db.driverName(), m_db.databaseName(), m_db.hostName(), m_username, m_password);
+    m_reader->setDatabase(m_db.driverName(), m_db.databaseName(), m_db.hostName(), m_username, m_password);
+
+    // From here on, the workers own the database
+    m_db.close();
+
+    m_writer->start();
+    m_reader->start();
+
+    QList<DatabaseJob*> heldJobs = m_heldJobs;
+    m_heldJobs.clear();
+    foreach (DatabaseJob *job, heldJobs) {
+        dispatchJob(job);
+    }
+}
+
+void LogEngine::recoverDatabase()
+{
+    qCWarning(dcLogEngine()) << "Database is malformed. Trying to recover...";
+    m_writer->stop();
+    m_reader->stop();
+
+    rotate(m_db.databaseName());
+    m_initialized = false;
+    if (!initDB(m_username, m_password)) {
+        qCWarning(dcLogEngine()) << "Error recovering log database. Logs can't be stored.";
+        return;
+    }
+    m_dbMalformed = false;
+    startWorkers();
 }
 
 void LogEngine::rotate(const QString &dbName)
@@ -553,6 +892,13 @@ void LogEngine::rotate(const QString &dbName)
     } else {
         qCDebug(dcLogEngine()) << "Successfully moved old database";
     }
+
+    // The SQLite write ahead log belongs to the old database and must not be applied to a new one
+    foreach (const QString &suffix, QStringList() << "-wal" << "-shm") {
+        if (QFileInfo(dbName + suffix).exists()) {
+            QFile::rename(dbName + suffix, QString("%1.%2%3").arg(dbName).arg(index).arg(suffix));
+        }
+    }
 }
 
 bool LogEngine::migrateDatabaseVersion3to4()
@@ -586,8 +932,8 @@ bool LogEngine::migrateDatabaseVersion3to4()
     }
     qCDebug(dcLogEngine()) << "Created new entries table:" << m_db.lastError().text();
 
-    qCDebug(dcLogEngine()) << "Updating database version to" << DB_SCHEMA_VERSION;
-    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(DB_SCHEMA_VERSION));
+    qCDebug(dcLogEngine()) << "Updating database version to" << 4;
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(4));
     if (m_db.lastError().isValid()) {
         qCWarning(dcLogEngine) << "Error updating database verion 3 -> 4. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
         return false;
@@ -599,11 +945,92 @@ bool LogEngine::migrateDatabaseVersion3to4()
 
 }
 
+bool LogEngine::migrateDatabaseVersion4to5()
+{
+    if (!createIndexes()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 4 -> 5 (creating indexes).";
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Updating database version to" << 5;
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(5));
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 4 -> 5. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Migrated database schema from version 4 to 5.";
+    return true;
+}
+
+bool LogEngine::migrateDatabaseVersion5to6()
+{
+    // This counts the entries one last time, from here on the triggers keep track of it
+    if (!createEntryCount()) {
+        qCWarning(dcLogEngine) << "Error migrating database verion 5 -> 6 (creating entry count).";
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Updating database version to" << 6;
+    m_db.exec(QString("UPDATE metadata SET data = %1 WHERE `key` = 'version';").arg(6));
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error updating database verion 5 -> 6. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    qCDebug(dcLogEngine()) << "Migrated database schema from version 5 to 6.";
+    return true;
+}
+
+bool LogEngine::createEntryCount()
+{
+    // The triggers use SQLite syntax. Other databases count the entries table in checkDBSize().
+    if (m_db.driverName() != "QSQLITE") {
+        return true;
+    }
+
+    m_db.exec("INSERT INTO metadata (`key`, data) SELECT 'entryCount', COUNT(*) FROM entries WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE `key` = 'entryCount');");
+    if (m_db.lastError().isValid()) {
+        qCWarning(dcLogEngine) << "Error initializing entry count. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+        return false;
+    }
+
+    QStringList triggers;
+    triggers << "CREATE TRIGGER IF NOT EXISTS entries_count_insert AFTER INSERT ON entries BEGIN UPDATE metadata SET data = data + 1 WHERE `key` = 'entryCount'; END;"
+             << "CREATE TRIGGER IF NOT EXISTS entries_count_delete AFTER DELETE ON entries BEGIN UPDATE metadata SET data = data - 1 WHERE `key` = 'entryCount'; END;";
+
+    foreach (const QString &trigger, triggers) {
+        m_db.exec(trigger);
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error creating trigger on log database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LogEngine::createIndexes()
+{
+    QStringList indexes;
+    indexes << "CREATE INDEX IF NOT EXISTS idx_entries_thing_type_timestamp ON entries (thingId, typeId, timestamp);"
+            << "CREATE INDEX IF NOT EXISTS idx_entries_eventtype_timestamp ON entries (loggingEventType, timestamp);"
+            << "CREATE INDEX IF NOT EXISTS idx_entries_timestamp ON entries (timestamp);";
+
+    foreach (const QString &index, indexes) {
+        m_db.exec(index);
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcLogEngine) << "Error creating index on log database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            return false;
+        }
+    }
+    return true;
+}
+
 void LogEngine::migrateEntries3to4()
 {
     QString selectQuery = QString("SELECT * FROM _entries_v3;");
 
-    DatabaseJob *job = new DatabaseJob(m_db, selectQuery);
+    DatabaseJob *job = new DatabaseJob(selectQuery);
 
     connect(job, &DatabaseJob::finished, this, [this, job](){
 
@@ -636,7 +1063,7 @@ void LogEngine::migrateEntries3to4()
                 .arg(result.value("active").toBool())
                 .arg(result.value("errorCode").toInt());
 
-        DatabaseJob *insertJob = new DatabaseJob(m_db, insertCall);
+        DatabaseJob *insertJob = new DatabaseJob(insertCall);
         connect(insertJob, &DatabaseJob::finished, this, [this, insertJob, count, result](){
             if (insertJob->error().type() != QSqlError::NoError) {
                 qCWarning(dcLogEngine) << "Error fetching entries to migrate. Driver error:" << insertJob->error().driverText() << "Database error:" << insertJob->error().databaseText();
@@ -655,7 +1082,7 @@ void LogEngine::migrateEntries3to4()
                     .arg(result.value("active").toBool())
                     .arg(result.value("errorCode").toInt());
 
-            DatabaseJob *deleteJob = new DatabaseJob(m_db, deleteCall);
+            DatabaseJob *deleteJob = new DatabaseJob(deleteCall);
             connect(deleteJob, &DatabaseJob::finished, this, [this, deleteJob, count, result](){
                 if (deleteJob->error().type() != QSqlError::NoError) {
                     qCWarning(dcLogEngine) << "Error deleting old entry during migration. Driver error:" << deleteJob->error().driverText() << "Database error:" << deleteJob->error().databaseText();
@@ -681,7 +1108,7 @@ void LogEngine::finalizeMigration3To4()
 {
     qCDebug(dcLogEngine()) << "Finalizing migration of database version 3 to 4.";
     QString selectQuery = QString("DROP TABLE _entries_v3;");
-    DatabaseJob *job = new DatabaseJob(m_db, selectQuery);
+    DatabaseJob *job = new DatabaseJob(selectQuery);
     enqueJob(job);
     connect(job, &DatabaseJob::finished, this, [job](){
 
@@ -701,6 +1128,11 @@ bool LogEngine::initDB(const QString &username, const QString &password)
         return false;
     }
 
+    // Allows the reader connection to run queries while the writer is busy
+    if (m_db.driverName() == "QSQLITE") {
+        m_db.exec("PRAGMA journal_mode=WAL;");
+    }
+
     if (!m_db.tables().contains("metadata")) {
         qCDebug(dcLogEngine()) << "Empty Database. Setting up metadata...";
         m_db.exec("CREATE TABLE metadata (`key` VARCHAR(10), data VARCHAR(40));");
@@ -714,6 +1146,7 @@ bool LogEngine::initDB(const QString &username, const QString &password)
     QSqlQuery query = m_db.exec("SELECT data FROM metadata WHERE `key` = 'version';");
     if (query.next()) {
         int version = query.value("data").toInt();
+        query.finish();
 
         // Migration from 3 -> 4
         if (version == 3) {
@@ -726,6 +1159,28 @@ bool LogEngine::initDB(const QString &username, const QString &password)
             }
         }
 
+        // Migration from 4 -> 5
+        if (version == 4) {
+            if (!migrateDatabaseVersion4to5()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                return false;
+            } else {
+                // Successfully migrated
+                version = 5;
+            }
+        }
+
+        // Migration from 5 -> 6
+        if (version == 5) {
+            if (!migrateDatabaseVersion5to6()) {
+                qCWarning(dcLogEngine()) << "Migration process failed.";
+                return false;
+            } else {
+                // Successfully migrated
+                version = 6;
+            }
+        }
+
         if (version != DB_SCHEMA_VERSION) {
             qCWarning(dcLogEngine) << "Log schema version not matching! Schema upgrade not implemented for this version change.";
             return false;
@@ -787,7 +1242,9 @@ bool LogEngine::initDB(const QString &username, const QString &password)
             return false;
         }
 
-
+        if (!createIndexes() || !createEntryCount()) {
+            return false;
+        }
     }
 
     qCDebug(dcLogEngine) << "Initialized logging DB successfully. (maximum DB size:" << m_dbMaxSize << ")";
@@ -33,6 +33,7 @@
 
 #include "logentry.h"
 #include "logfilter.h"
+#include "aggregatedvalue.h"
 #include "types/event.h"
 #include "types/action.h"
 #include "types/browseritemaction.h"
@@ -45,13 +46,15 @@
 #include <QSqlError>
 #include <QSqlRecord>
 #include <QTimer>
-#include <QFutureWatcher>
 
 namespace nymeaserver {
 
 class DatabaseJob;
+class DatabaseWorker;
 class LogEntriesFetchJob;
+class AggregatedValuesFetchJob;
 class ThingsFetchJob;
+class DatabaseSnapshotJob;
 
 class LogEngine: public QObject
 {
@@ -62,10 +65,15 @@ public:
 
     LogEntriesFetchJob *fetchLogEntries(const LogFilter &filter = LogFilter());
     ThingsFetchJob *fetchThings();
+    AggregatedValuesFetchJob *fetchAggregatedValues(const ThingId &thingId, const StateTypeId &stateTypeId, Logging::AggregationResolution resolution, const QDateTime &from = QDateTime(), const QDateTime &to = QDateTime());
+    DatabaseSnapshotJob *createSnapshot(const QString &fileName);
 
     bool jobsRunning() const;
 
     void setMaxLogEntries(int maxLogEntries, int trimSize);
+    void setWriteBatching(int flushInterval, int maxBatchSize);
+    void setRetentionPolicy(Logging::LoggingSource source, int maxAgeDays);
+    void setThingRetentionPolicy(const ThingId &thingId, int maxAgeDays);
     void clearDatabase();
 
     void logSystemEvent(const QDateTime &dateTime, bool active, Logging::LoggingLevel level = Logging::LoggingLevelInfo);
@@ -91,18 +99,28 @@ private:
     bool initDB(const QString &username, const QString &password);
     void appendLogEntry(const LogEntry &entry);
     void rotate(const QString &dbName);
+    void startWorkers();
+    void recoverDatabase();
 
     bool migrateDatabaseVersion3to4();
     void migrateEntries3to4();
     void finalizeMigration3To4();
+    bool migrateDatabaseVersion4to5();
+    bool migrateDatabaseVersion5to6();
+    bool createIndexes();
+    bool createEntryCount();
 
 private slots:
     void checkDBSize();
     void trim();
+    void housekeeping();
+    void applyRetentionPolicies();
+    void flushPendingEntries();
+    void enqueReadAfterFlush(DatabaseJob *job);
 
-    void enqueJob(DatabaseJob *job, bool priority = false);
-    void processQueue();
-    void handleJobFinished();
+    void enqueJob(DatabaseJob *job, bool readOnly = false);
+    void dispatchJob(DatabaseJob *job);
+    void handleJobFinished(DatabaseJob *job);
 
 private:
     QSqlDatabase m_db;
@@ -114,43 +132,79 @@ private:
     bool m_initialized = false;
     bool m_dbMalformed = false;
 
-    // When maxQueueLength is exceeded, jobs will be flagged and discarded if this source logs more events
-    int m_maxQueueLength;
-    QHash<QString, QList<DatabaseJob*>> m_flaggedJobs;
+    // New entries are collected for up to m_flushInterval ms or m_maxBatchSize rows
+    // and written in a single transaction. While a batch is being written, further
+    // entries are collected for the next one instead of adding more jobs.
+    QList<LogEntry> m_pendingEntries;
+    QTimer m_flushTimer;
+    int m_flushInterval = 250;
+    int m_maxBatchSize = 500;
+    DatabaseJob *m_batchJob = nullptr;
+    // Batches are numbered in the order they are written. Reads which need to see the entries
+    // logged before them wait for the batch containing those to be committed.
+    int m_startedBatches = 0;
+    int m_committedBatches = 0;
+    QList<DatabaseJob*> m_readsAfterFlush;
 
-    QList<DatabaseJob*> m_jobQueue;
-    DatabaseJob *m_currentJob = nullptr;
-    QFutureWatcher<DatabaseJob*> m_jobWatcher;
+    // Housekeeping deletes entries in chunks of m_housekeepingChunkSize, one chunk per timer interval
+    QTimer m_housekeepingTimer;
+    int m_housekeepingChunkSize = 1000;
+    DatabaseJob *m_housekeepingJob = nullptr;
+    bool m_trimming = false;
+
+    // Maximum age in days
+    QTimer m_retentionTimer;
+    QMap<Logging::LoggingSource, int> m_sourceRetentionPolicies;
+    QMap<ThingId, int> m_thingRetentionPolicies;
+    QStringList m_retentionQueries;
+
+    DatabaseWorker *m_writer = nullptr;
+    DatabaseWorker *m_reader = nullptr;
+    int m_runningJobs = 0;
+    QList<DatabaseJob*> m_heldJobs;
 };
 
 class DatabaseJob: public QObject
 {
     Q_OBJECT
 public:
-    DatabaseJob(const QSqlDatabase &db, const QString &queryString, const QStringList &bindValues = QStringList()):
-        m_db(db),
+    DatabaseJob(const QString &queryString, const QStringList &bindValues = QStringList()):
         m_queryString(queryString),
         m_bindValues(bindValues)
     {
     }
 
+    DatabaseJob(const QString &queryString, const QList<QVariantList> &batchValues):
+        m_queryString(queryString),
+        m_batchValues(batchValues)
+    {
+    }
+
     QString executedQuery() const { return m_executedQuery; }
     QSqlError error() const { return m_error; }
     QList<QSqlRecord> results() const { return m_results; }
+    int rowsAffected() const { return m_rowsAffected; }
 
 signals:
     void finished();
 
 private:
-    QSqlDatabase m_db;
     QString m_queryString;
     QStringList m_bindValues;
+    // If set, m_queryString is prepared once and executed for each row in a single transaction
+    QList<QVariantList> m_batchValues;
+    QList<LogEntry> m_batchEntries;
+    // For batches its number, for reads the number of the batch they wait for
+    int m_batch = 0;
+    bool m_readOnly = false;
 
     QString m_executedQuery;
     QSqlError m_error;
     QList<QSqlRecord> m_results;
+    int m_rowsAffected = 0;
 
     friend class LogEngine;
+    friend class DatabaseWorker;
 };
 
 class LogEntriesFetchJob: public QObject
@@ -159,10 +213,27 @@ class LogEntriesFetchJob: public QObject
 public:
     LogEntriesFetchJob(QObject *parent): QObject(parent) {}
     QList<LogEntry> results() { return m_results; }
+    QString nextCursor() const { return m_nextCursor; }
 signals:
     void finished();
 private:
     QList<LogEntry> m_results;
+    QString m_nextCursor;
+    friend class LogEngine;
+};
+
+class AggregatedValuesFetchJob: public QObject
+{
+    Q_OBJECT
+public:
+    AggregatedValuesFetchJob(QObject *parent): QObject(parent) {}
+    AggregatedValues results() { return m_results; }
+    bool success() const { return m_success; }
+signals:
+    void finished();
+private:
+    AggregatedValues m_results;
+    bool m_success = false;
     friend class LogEngine;
 };
 
@@ -179,6 +250,21 @@ private:
     friend class LogEngine;
 };
 
+class DatabaseSnapshotJob: public QObject
+{
+    Q_OBJECT
+public:
+    DatabaseSnapshotJob(const QString &fileName, QObject *parent): QObject(parent), m_fileName(fileName) {}
+    QString fileName() const { return m_fileName; }
+    bool success() const { return m_success; }
+signals:
+    void finished();
+private:
+    QString m_fileName;
+    bool m_success = false;
+    friend class LogEngine;
+};
+
 }
 
 #endif
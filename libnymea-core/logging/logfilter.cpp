@@ -44,6 +44,8 @@
 #include "logfilter.h"
 #include "loggingcategories.h"
 
+#include <QStringList>
+
 namespace nymeaserver {
 
 /*! Constructs a new \l{LogFilter}.*/
@@ -92,6 +94,11 @@ QString LogFilter::queryString() const
     }
     query.append(createValuesString());
 
+    if (!query.isEmpty() && m_cursorRowId >= 0) {
+        query.append("AND ");
+    }
+    query.append(createCursorString());
+
     return query;
 }
 
@@ -228,10 +235,50 @@ int LogFilter::offset() const
     return m_offset;
 }
 
+/*! Sets the \a cursor for the result set. Only entries older than the last entry of the
+ * page the cursor has been created for will be returned.
+ *
+ * Unlike the \l{offset}, which requires the database to walk all skipped entries, the
+ * cursor allows to page through large result sets at constant cost per page. Returns false
+ * if the given \a cursor is not valid. \sa{createCursor}
+ */
+bool LogFilter::setCursor(const QString &cursor)
+{
+    QList<QByteArray> parts = QByteArray::fromBase64(cursor.toUtf8()).split(':');
+    if (parts.count() != 2) {
+        return false;
+    }
+    bool timestampOk = false, rowIdOk = false;
+    qint64 timestamp = parts.at(0).toLongLong(&timestampOk);
+    qint64 rowId = parts.at(1).toLongLong(&rowIdOk);
+    if (!timestampOk || !rowIdOk || rowId < 0) {
+        return false;
+    }
+    m_cursorTimestamp = timestamp;
+    m_cursorRowId = rowId;
+    return true;
+}
+
+/*! Returns the cursor of this \l{LogFilter} or an empty string if none is set. \sa{setCursor} */
+QString LogFilter::cursor() const
+{
+    if (m_cursorRowId < 0) {
+        return QString();
+    }
+    return createCursor(m_cursorTimestamp, m_cursorRowId);
+}
+
+/*! Returns an opaque cursor pointing after the entry with the given \a timestamp and \a rowId. \sa{setCursor} */
+QString LogFilter::createCursor(qint64 timestamp, qint64 rowId)
+{
+    return QString::fromUtf8(QString("%1:%2").arg(timestamp).arg(rowId).toUtf8().toBase64());
+}
+
 /*! Returns true if this \l{LogFilter} is empty. */
 bool LogFilter::isEmpty() const
 {
-    return m_timeFilters.isEmpty() &&
+    return m_cursorRowId < 0 &&
+            m_timeFilters.isEmpty() &&
             m_sources.isEmpty() &&
             m_levels.isEmpty() &&
             m_eventTypes.isEmpty() &&
@@ -297,13 +344,11 @@ QString LogFilter::createSourcesString() const
         if (m_sources.count() == 1) {
             query.append(QString("sourceType = '%1' ").arg(m_sources.first()));
         } else {
-            query.append("( ");
-            foreach (const Logging::LoggingSource &source, m_sources) {
-                query.append(QString("sourceType = '%1' ").arg(source));
-                if (source != m_sources.last())
-                    query.append("OR ");
+            QStringList items;
+            foreach (const Logging::LoggingSource &item, m_sources) {
+                items.append(QString("'%1'").arg(item));
             }
-            query.append(") ");
+            query.append(QString("sourceType IN (%1) ").arg(items.join(", ")));
         }
     }
     return query;
@@ -316,13 +361,11 @@ QString LogFilter::createLevelsString() const
         if (m_levels.count() == 1) {
             query.append(QString("loggingLevel = '%1' ").arg(m_levels.first()));
         } else {
-            query.append("( ");
-            foreach (const Logging::LoggingLevel &level, m_levels) {
-                query.append(QString("loggingLevel = '%1' ").arg(level));
-                if (level != m_levels.last())
-                    query.append("OR ");
+            QStringList items;
+            foreach (const Logging::LoggingLevel &item, m_levels) {
+                items.append(QString("'%1'").arg(item));
             }
-            query.append(") ");
+            query.append(QString("loggingLevel IN (%1) ").arg(items.join(", ")));
         }
     }
     return query;
@@ -335,13 +378,11 @@ QString LogFilter::createEventTypesString() const
         if (m_eventTypes.count() == 1) {
             query.append(QString("loggingEventType = '%1' ").arg(m_eventTypes.first()));
         } else {
-            query.append("( ");
-            foreach (const Logging::LoggingEventType &eventType, m_eventTypes) {
-                query.append(QString("loggingEventType = '%1' ").arg(eventType));
-                if (eventType != m_eventTypes.last())
-                    query.append("OR ");
+            QStringList items;
+            foreach (const Logging::LoggingEventType &item, m_eventTypes) {
+                items.append(QString("'%1'").arg(item));
             }
-            query.append(") ");
+            query.append(QString("loggingEventType IN (%1) ").arg(items.join(", ")));
         }
     }
     return query;
@@ -354,13 +395,11 @@ QString LogFilter::createTypeIdsString() const
         if (m_typeIds.count() == 1) {
             query.append(QString("typeId = '%1' ").arg(m_typeIds.first().toString()));
         } else {
-            query.append("( ");
-            foreach (const QUuid &typeId, m_typeIds) {
-                query.append(QString("typeId = '%1' ").arg(typeId.toString()));
-                if (typeId != m_typeIds.last())
-                    query.append("OR ");
+            QStringList items;
+            foreach (const QUuid &item, m_typeIds) {
+                items.append(QString("'%1'").arg(item.toString()));
             }
-            query.append(") ");
+            query.append(QString("typeId IN (%1) ").arg(items.join(", ")));
         }
     }
     return query;
@@ -373,13 +412,11 @@ QString LogFilter::createThingIdString() const
         if (m_thingIds.count() == 1) {
             query.append(QString("thingId = '%1' ").arg(m_thingIds.first().toString()));
         } else {
-            query.append("( ");
-            foreach (const ThingId &thingId, m_thingIds) {
-                query.append(QString("thingId = '%1' ").arg(thingId.toString()));
-                if (thingId != m_thingIds.last())
-                    query.append("OR ");
+            QStringList items;
+            foreach (const ThingId &item, m_thingIds) {
+                items.append(QString("'%1'").arg(item.toString()));
             }
-            query.append(") ");
+            query.append(QString("thingId IN (%1) ").arg(items.join(", ")));
         }
     }
     return query;
@@ -392,16 +429,26 @@ QString LogFilter::createValuesString() const
         if (m_values.count() == 1) {
             query.append("value = ? ");
         } else {
-            query.append("( ");
-            foreach (const QString &value, m_values) {
-                query.append("value = ? ");
-                if (value != m_values.last())
-                    query.append("OR ");
+            QStringList placeholders;
+            for (int i = 0; i < m_values.count(); i++) {
+                placeholders.append("?");
             }
-            query.append(") ");
+            query.append(QString("value IN (%1) ").arg(placeholders.join(", ")));
         }
     }
     return query;
 }
 
+QString LogFilter::createCursorString() const
+{
+    QString query;
+    if (m_cursorRowId >= 0) {
+        // Matches the "ORDER BY timestamp DESC, rowid DESC" sorting of the result set
+        query.append(QString("( timestamp < %1 OR ( timestamp = %1 AND rowid < %2 ) ) ")
+                     .arg(m_cursorTimestamp)
+                     .arg(m_cursorRowId));
+    }
+    return query;
+}
+
 }
@@ -77,6 +77,10 @@ public:
     void setOffset(int offset);
     int offset() const;
 
+    bool setCursor(const QString &cursor);
+    QString cursor() const;
+    static QString createCursor(qint64 timestamp, qint64 rowId);
+
     bool isEmpty() const;
 
 private:
@@ -89,6 +93,8 @@ private:
     QList<QString> m_values;
     int m_limit = -1;
     int m_offset = 0;
+    qint64 m_cursorTimestamp = -1;
+    qint64 m_cursorRowId = -1;
 
     QString createDateString() const;
     QString createTimeFilterString(QPair<QDateTime, QDateTime> timeFilter) const;
@@ -98,6 +104,7 @@ private:
     QString createTypeIdsString() const;
     QString createThingIdString() const;
     QString createValuesString() const;
+    QString createCursorString() const;
 };
 
 }
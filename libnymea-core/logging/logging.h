@@ -74,6 +74,14 @@ public:
     };
     Q_ENUM(LoggingEventType)
 
+    enum AggregationResolution {
+        AggregationResolution1Minute,
+        AggregationResolution15Minutes,
+        AggregationResolution1Hour,
+        AggregationResolution1Day
+    };
+    Q_ENUM(AggregationResolution)
+
     Logging(QObject *parent = nullptr);
 };
 
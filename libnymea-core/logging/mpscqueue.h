@@ -0,0 +1,101 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <QAtomicPointer>
+
+namespace nymeaserver {
+
+// Lock-free multi producer, single consumer queue (intrusive linked list with a stub node).
+// enqueue() may be called from any thread, dequeue() only from the consumer thread.
+// The queue does not take ownership of the enqueued pointers.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue():
+        m_head(&m_stub),
+        m_tail(&m_stub)
+    {
+    }
+
+    ~MpscQueue()
+    {
+        T *value = nullptr;
+        while (dequeue(value)) { }
+        if (m_tail != &m_stub) {
+            delete m_tail;
+        }
+    }
+
+    void enqueue(T *value)
+    {
+        Node *node = new Node(value);
+        Node *previous = m_head.fetchAndStoreAcquireRelease(node);
+        previous->next.storeRelease(node);
+    }
+
+    // Returns false if the queue is empty. Note that it may also return false for a short moment
+    // while another producer is in the middle of enqueue().
+    bool dequeue(T *&value)
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.loadAcquire();
+        if (!next) {
+            return false;
+        }
+        value = next->value;
+        next->value = nullptr;
+        m_tail = next;
+        if (tail != &m_stub) {
+            delete tail;
+        }
+        return true;
+    }
+
+private:
+    Q_DISABLE_COPY(MpscQueue)
+
+    struct Node {
+        Node(T *value = nullptr): value(value), next(nullptr) {}
+        T *value;
+        QAtomicPointer<Node> next;
+    };
+
+    Node m_stub;
+    QAtomicPointer<Node> m_head;
+    Node *m_tail;
+};
+
+}
+
+#endif // MPSCQUEUE_H
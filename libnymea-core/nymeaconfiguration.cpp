@@ -217,6 +217,19 @@ NymeaConfiguration::NymeaConfiguration(QObject *parent) :
     settings.setValue("logDBUser", logDBUser());
     settings.setValue("logDBPassword", logDBPassword());
     settings.setValue("logDBMaxEntries", logDBMaxEntries());
+    settings.setValue("logDBFlushInterval", logDBFlushInterval());
+    settings.setValue("logDBMaxBatchSize", logDBMaxBatchSize());
+    settings.endGroup();
+
+    // Write defaults for JSON-RPC settings
+    settings.beginGroup("JSONRPC");
+    settings.setValue("maxMessageSize", jsonRpcMaxMessageSize());
+    settings.setValue("sendQueueHighWatermark", jsonRpcSendQueueHighWatermark());
+    settings.setValue("sendQueueLowWatermark", jsonRpcSendQueueLowWatermark());
+    settings.setValue("sendQueueMaxSize", jsonRpcSendQueueMaxSize());
+    settings.setValue("sendQueuePolicy", jsonRpcSendQueuePolicy());
+    settings.setValue("compressionLevel", jsonRpcCompressionLevel());
+    settings.setValue("compressionThreshold", jsonRpcCompressionThreshold());
     settings.endGroup();
 }
 
@@ -553,6 +566,82 @@ int NymeaConfiguration::logDBMaxEntries() const
     return settings.value("logDBMaxEntries", 200000).toInt();
 }
 
+int NymeaConfiguration::logDBFlushInterval() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBFlushInterval", 250).toInt();
+}
+
+int NymeaConfiguration::logDBMaxBatchSize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Logs");
+    return settings.value("logDBMaxBatchSize", 500).toInt();
+}
+
+QVariantMap NymeaConfiguration::logRetentionPolicies() const
+{
+    // Maximum age in days, keyed by logging source name (e.g. LoggingSourceStates) or thing id
+    QVariantMap policies;
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("LogRetention");
+    foreach (const QString &key, settings.childKeys()) {
+        policies.insert(key, settings.value(key).toInt());
+    }
+    settings.endGroup();
+    return policies;
+}
+
+int NymeaConfiguration::jsonRpcMaxMessageSize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("maxMessageSize", 10 * 1024).toInt();
+}
+
+int NymeaConfiguration::jsonRpcSendQueueHighWatermark() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("sendQueueHighWatermark", 256 * 1024).toInt();
+}
+
+int NymeaConfiguration::jsonRpcSendQueueLowWatermark() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("sendQueueLowWatermark", 64 * 1024).toInt();
+}
+
+int NymeaConfiguration::jsonRpcSendQueueMaxSize() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("sendQueueMaxSize", 1024 * 1024).toInt();
+}
+
+QString NymeaConfiguration::jsonRpcSendQueuePolicy() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("sendQueuePolicy", "coalesce").toString();
+}
+
+int NymeaConfiguration::jsonRpcCompressionLevel() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("compressionLevel", 6).toInt();
+}
+
+int NymeaConfiguration::jsonRpcCompressionThreshold() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("JSONRPC");
+    return settings.value("compressionThreshold", 256).toInt();
+}
+
 QString NymeaConfiguration::sslCertificate() const
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
@@ -180,6 +180,18 @@ public:
     QString logDBUser() const;
     QString logDBPassword() const;
     int logDBMaxEntries() const;
+    int logDBFlushInterval() const;
+    int logDBMaxBatchSize() const;
+    QVariantMap logRetentionPolicies() const;
+
+    // JSON-RPC
+    int jsonRpcMaxMessageSize() const;
+    int jsonRpcSendQueueHighWatermark() const;
+    int jsonRpcSendQueueLowWatermark() const;
+    int jsonRpcSendQueueMaxSize() const;
+    QString jsonRpcSendQueuePolicy() const;
+    int jsonRpcCompressionLevel() const;
+    int jsonRpcCompressionThreshold() const;
 
 private:
     QHash<QString, ServerConfiguration> m_tcpServerConfigs;
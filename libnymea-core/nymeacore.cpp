@@ -55,6 +55,7 @@
 
 #include <QDir>
 #include <QCoreApplication>
+#include <QMetaEnum>
 
 namespace nymeaserver {
 
@@ -97,6 +98,20 @@ void NymeaCore::init() {
 
     qCDebug(dcApplication) << "Creating Log Engine";
     m_logger = new LogEngine(m_configuration->logDBDriver(), m_configuration->logDBName(), m_configuration->logDBHost(), m_configuration->logDBUser(), m_configuration->logDBPassword(), m_configuration->logDBMaxEntries(), this);
+    m_logger->setWriteBatching(m_configuration->logDBFlushInterval(), m_configuration->logDBMaxBatchSize());
+    QVariantMap retentionPolicies = m_configuration->logRetentionPolicies();
+    QMetaEnum sourceEnum = QMetaEnum::fromType<Logging::LoggingSource>();
+    foreach (const QString &key, retentionPolicies.keys()) {
+        bool isSource = false;
+        int source = sourceEnum.keyToValue(key.toUtf8().constData(), &isSource);
+        if (isSource) {
+            m_logger->setRetentionPolicy(static_cast<Logging::LoggingSource>(source), retentionPolicies.value(key).toInt());
+        } else if (!QUuid(key).isNull()) {
+            m_logger->setThingRetentionPolicy(ThingId(key), retentionPolicies.value(key).toInt());
+        } else {
+            qCWarning(dcApplication()) << "Invalid log retention policy" << key << "in configuration. Ignoring it.";
+        }
+    }
 
     qCDebug(dcApplication()) << "Creating User Manager";
     m_userManager = new UserManager(NymeaSettings::settingsPath() + "/user-db.sqlite", this);
@@ -431,7 +446,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
                         ok = false;
                         break;
                     }
-                    ThingClass stateThingClass = m_thingManager->findThingClass(stateThing->thingClassId());
+                    const ThingClass &stateThingClass = m_thingManager->supportedThingClass(stateThing->thingClassId());
                     if (!stateThingClass.hasStateType(ruleActionParam.stateTypeId())) {
                         qCWarning(dcRuleEngine()) << "Device" << thing->name() << thing->id() << "does not have a state type" << ruleActionParam.stateTypeId();
                         ok = false;
@@ -458,7 +473,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
         } else {
             Things things = m_thingManager->findConfiguredThings(ruleAction.interface());
             foreach (Thing* thing, things) {
-                ThingClass thingClass = m_thingManager->findThingClass(thing->thingClassId());
+                const ThingClass &thingClass = m_thingManager->supportedThingClass(thing->thingClassId());
                 ActionType actionType = thingClass.actionTypes().findByName(ruleAction.interfaceAction());
                 if (actionType.id().isNull()) {
                     qCWarning(dcRuleEngine()) << "Error creating Action. The given ThingClass does not implement action:" << ruleAction.interfaceAction();
@@ -483,7 +498,7 @@ void NymeaCore::executeRuleActions(const QList<RuleAction> ruleActions)
                             ok = false;
                             break;
                         }
-                        ThingClass stateThingClass = m_thingManager->findThingClass(stateThing->thingClassId());
+                        const ThingClass &stateThingClass = m_thingManager->supportedThingClass(stateThing->thingClassId());
                         if (!stateThingClass.hasStateType(ruleActionParam.stateTypeId())) {
                             qCWarning(dcRuleEngine()) << "Thing" << thing->name() << thing->id() << "does not have a state type" << ruleActionParam.stateTypeId();
                             ok = false;
@@ -0,0 +1,224 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::CompiledStateEvaluator
+    \brief A flat, pre-resolved representation of a \l{StateEvaluator} tree.
+
+    \ingroup rules
+    \inmodule core
+
+    The things and state types referenced by a \l{StateEvaluator} are looked up once when compiling,
+    interface descriptors are resolved to the list of things implementing the interface. Evaluating
+    the compiled evaluator gives the same result as StateEvaluator::evaluate() without searching
+    the configured things again. It needs to be recompiled whenever one of the things it
+    \l{dependsOnThing}{depends on} is added or removed.
+
+    \sa StateEvaluator, RuleEngine
+*/
+
+#include "compiledstateevaluator.h"
+#include "integrations/thingmanager.h"
+#include "integrations/thing.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+CompiledStateEvaluator::CompiledStateEvaluator()
+{
+
+}
+
+/*! Compiles the given \a stateEvaluator, resolving things and thing classes using the given \a thingManager. */
+CompiledStateEvaluator::CompiledStateEvaluator(const StateEvaluator &stateEvaluator, ThingManager *thingManager)
+{
+    compile(stateEvaluator, thingManager);
+}
+
+/*! Evaluates the compiled tree against the current states of the things. */
+bool CompiledStateEvaluator::evaluate() const
+{
+    if (m_nodes.isEmpty()) {
+        return true;
+    }
+    bool result = evaluateNode(0);
+    qCDebug(dcRuleEngineDebug()) << "CompiledStateEvaluator: Evaluated" << m_nodes.count() << "nodes with" << m_comparisons.count() << "states => Evaluation result:" << result;
+    return result;
+}
+
+/*! Returns true if adding or removing the thing with the given \a thingId, implementing the given
+    \a interfaces, changes the compiled result and a recompilation is required. */
+bool CompiledStateEvaluator::dependsOnThing(const ThingId &thingId, const QStringList &interfaces) const
+{
+    if (m_things.contains(thingId)) {
+        return true;
+    }
+    foreach (const QString &interface, interfaces) {
+        if (m_interfaces.contains(interface)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CompiledStateEvaluator::compile(const StateEvaluator &stateEvaluator, ThingManager *thingManager)
+{
+    int index = m_nodes.count();
+    m_nodes.append(Node());
+
+    Node node;
+    node.operatorType = stateEvaluator.operatorType();
+    node.hasDescriptor = stateEvaluator.stateDescriptor().isValid();
+    node.firstComparison = m_comparisons.count();
+
+    StateDescriptor descriptor = stateEvaluator.stateDescriptor();
+    if (node.hasDescriptor) {
+        if (descriptor.type() == StateDescriptor::TypeThing) {
+            m_things.insert(descriptor.thingId());
+            Thing *thing = thingManager->findConfiguredThing(descriptor.thingId());
+            if (!thing) {
+                qCWarning(dcRuleEngine) << "CompiledStateEvaluator: Thing" << descriptor.thingId() << "not existing!";
+            } else if (!thing->hasState(descriptor.stateTypeId())) {
+                qCWarning(dcRuleEngine) << "CompiledStateEvaluator: Thing found, but it does not appear to have such a state!";
+            } else {
+                ThingClass thingClass = thingManager->findThingClass(thing->thingClassId());
+                Comparison comparison;
+                comparison.thing = thing;
+                comparison.stateTypeId = descriptor.stateTypeId();
+                comparison.convertedType = thingClass.stateTypes().findById(descriptor.stateTypeId()).type();
+                m_comparisons.append(comparison);
+            }
+        } else {
+            m_interfaces.insert(descriptor.interface());
+            foreach (Thing *thing, thingManager->findConfiguredThings(descriptor.interface())) {
+                ThingClass thingClass = thingManager->findThingClass(thing->thingClassId());
+                StateType stateType = thingClass.stateTypes().findByName(descriptor.interfaceState());
+                if (stateType.id().isNull()) {
+                    continue;
+                }
+                m_things.insert(thing->id());
+                Comparison comparison;
+                comparison.thing = thing;
+                comparison.stateTypeId = stateType.id();
+                comparison.convertedType = stateType.type();
+                m_comparisons.append(comparison);
+            }
+        }
+
+        for (int i = node.firstComparison; i < m_comparisons.count(); i++) {
+            Comparison &comparison = m_comparisons[i];
+            comparison.operatorType = descriptor.operatorType();
+            comparison.value = descriptor.stateValue();
+            comparison.convertedValue = descriptor.stateValue();
+            if (!comparison.convertedValue.canConvert(comparison.convertedType) || !comparison.convertedValue.convert(comparison.convertedType)) {
+                // Convert at evaluation time
+                comparison.convertedType = QVariant::Invalid;
+            }
+        }
+    }
+    node.comparisonCount = m_comparisons.count() - node.firstComparison;
+
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        compile(childEvaluator, thingManager);
+    }
+
+    node.end = m_nodes.count();
+    m_nodes[index] = node;
+}
+
+bool CompiledStateEvaluator::evaluateNode(int index) const
+{
+    const Node &node = m_nodes.at(index);
+
+    bool descriptorMatching = !node.hasDescriptor;
+    for (int i = node.firstComparison; i < node.firstComparison + node.comparisonCount; i++) {
+        if (compare(m_comparisons.at(i))) {
+            descriptorMatching = true;
+            break;
+        }
+    }
+
+    if (node.operatorType == Types::StateOperatorOr) {
+        if (node.hasDescriptor && descriptorMatching) {
+            return true;
+        }
+        for (int child = index + 1; child < node.end; child = m_nodes.at(child).end) {
+            if (evaluateNode(child)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (!descriptorMatching) {
+        return false;
+    }
+    for (int child = index + 1; child < node.end; child = m_nodes.at(child).end) {
+        if (!evaluateNode(child)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CompiledStateEvaluator::compare(const Comparison &comparison) const
+{
+    if (comparison.thing.isNull()) {
+        return false;
+    }
+
+    QVariant stateValue = comparison.thing->stateValue(comparison.stateTypeId);
+    QVariant convertedValue = comparison.convertedValue;
+    if (stateValue.type() != comparison.convertedType) {
+        if (!comparison.value.canConvert(stateValue.type())) {
+            return false;
+        }
+        convertedValue = comparison.value;
+        convertedValue.convert(stateValue.type());
+    }
+
+    switch (comparison.operatorType) {
+    case Types::ValueOperatorEquals:
+        return convertedValue == stateValue;
+    case Types::ValueOperatorGreater:
+        return stateValue > convertedValue;
+    case Types::ValueOperatorGreaterOrEqual:
+        return stateValue >= convertedValue;
+    case Types::ValueOperatorLess:
+        return stateValue < convertedValue;
+    case Types::ValueOperatorLessOrEqual:
+        return stateValue <= convertedValue;
+    case Types::ValueOperatorNotEquals:
+        return convertedValue != stateValue;
+    }
+    return false;
+}
+
+}
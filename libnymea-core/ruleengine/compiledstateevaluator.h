@@ -0,0 +1,90 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COMPILEDSTATEEVALUATOR_H
+#define COMPILEDSTATEEVALUATOR_H
+
+#include "stateevaluator.h"
+
+#include <QPointer>
+#include <QVector>
+#include <QSet>
+
+class Thing;
+class ThingManager;
+
+namespace nymeaserver {
+
+class CompiledStateEvaluator
+{
+public:
+    CompiledStateEvaluator();
+    CompiledStateEvaluator(const StateEvaluator &stateEvaluator, ThingManager *thingManager);
+
+    bool evaluate() const;
+
+    bool dependsOnThing(const ThingId &thingId, const QStringList &interfaces = QStringList()) const;
+
+private:
+    // A state of a single thing compared against the descriptor value
+    struct Comparison {
+        QPointer<Thing> thing;
+        StateTypeId stateTypeId;
+        Types::ValueOperator operatorType;
+        QVariant value;
+        // The descriptor value converted to the state type at compile time
+        QVariant::Type convertedType = QVariant::Invalid;
+        QVariant convertedValue;
+    };
+
+    // Nodes are stored in depth first order. The children of a node follow it directly,
+    // end is the index of the first node after the subtree.
+    struct Node {
+        Types::StateOperator operatorType;
+        bool hasDescriptor;
+        int firstComparison;
+        int comparisonCount;
+        int end;
+    };
+
+    void compile(const StateEvaluator &stateEvaluator, ThingManager *thingManager);
+    bool evaluateNode(int index) const;
+    bool compare(const Comparison &comparison) const;
+
+    QVector<Node> m_nodes;
+    QVector<Comparison> m_comparisons;
+
+    QSet<ThingId> m_things;
+    QSet<QString> m_interfaces;
+};
+
+}
+
+#endif // COMPILEDSTATEEVALUATOR_H
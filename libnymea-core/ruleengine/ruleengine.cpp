@@ -166,18 +166,20 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
     }
 
     QList<Rule> rules;
-    foreach (const RuleId &id, ruleIds()) {
-        Rule rule = m_rules.value(id);
+    foreach (const RuleId &id, candidateRules(event, thingClass)) {
+        QHash<RuleId, Rule>::iterator it = m_rules.find(id);
+        if (it == m_rules.end()) {
+            continue;
+        }
+        Rule &rule = it.value();
         if (!rule.enabled()) {
             qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Skipping rule " << rule.name() << " (" << rule.id().toString() << ") "  << " because it is disabled.";
             continue;
         }
+        m_dirtyRules.remove(id);
 
-        // If we have a state based on this event
-        if (containsState(rule.stateEvaluator(), event)) {
-            rule.setStatesActive(rule.stateEvaluator().evaluate());
-            m_rules[rule.id()] = rule;
-        }
+        // The states might have been changed by this event
+        rule.setStatesActive(m_compiledEvaluators.value(id).evaluate());
 
         // If this rule does not base on an event, evaluate the rule
         if (rule.eventDescriptors().isEmpty() && rule.timeDescriptor().timeEventItems().isEmpty() && !rule.stateEvaluator().isEmpty()) {
@@ -185,7 +187,6 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
                 if (!m_activeRules.contains(rule.id())) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") active.";
                     rule.setActive(true);
-                    m_rules[rule.id()] = rule;
                     m_activeRules.append(rule.id());
                     rules.append(rule);
                 }
@@ -193,14 +194,13 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
                 if (m_activeRules.contains(rule.id())) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") inactive.";
                     rule.setActive(false);
-                    m_rules[rule.id()] = rule;
                     m_activeRules.removeAll(rule.id());
                     rules.append(rule);
                 }
             }
         } else {
             // Event based rule
-            if (containsEvent(rule, event, thing->thingClassId())) {
+            if (containsEvent(rule, event, thingClass)) {
                 qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Rule " << rule.name() << " (" << rule.id().toString() << ") contains event";
                 if (rule.statesActive() && rule.timeActive()) {
                     qCDebug(dcRuleEngine).nospace().noquote() << "Rule " << rule.name() << " (" + rule.id().toString() << ") contains event and all states match.";
@@ -489,7 +489,9 @@ RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit
     }
 
     m_ruleIds.takeAt(index);
-    m_rules.remove(ruleId);
+    unindexRule(m_rules.take(ruleId));
+    m_ruleOrder.remove(ruleId);
+    m_compiledEvaluators.remove(ruleId);
     m_activeRules.removeAll(ruleId);
 
     NymeaSettings settings(NymeaSettings::SettingsRoleRules);
@@ -523,6 +525,7 @@ RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
 
     rule.setEnabled(true);
     m_rules[ruleId] = rule;
+    m_dirtyRules.insert(ruleId);
     saveRule(rule);
     emit ruleConfigurationChanged(rule);
 
@@ -788,7 +791,9 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
     if (actions.isEmpty() && exitActions.isEmpty()) {
         // The rule doesn't have any actions any more and is useless at this point... let's remove it altogether
         qCDebug(dcRuleEngine()) << "Rule" << rule.name() << "(" + rule.id().toString() + ")" << "does not have any actions any more. Removing it.";
-        m_rules.take(id);
+        unindexRule(m_rules.take(id));
+        m_ruleOrder.remove(id);
+        m_compiledEvaluators.remove(id);
         emit ruleRemoved(id);
         return;
     }
@@ -801,14 +806,18 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
     newRule.setTimeDescriptor(rule.timeDescriptor());
     newRule.setActions(actions);
     newRule.setExitActions(exitActions);
+    unindexRule(rule);
     m_rules[id] = newRule;
+    indexRule(newRule);
+    m_compiledEvaluators.insert(id, CompiledStateEvaluator(newRule.stateEvaluator(), NymeaCore::instance()->thingManager()));
+    m_dirtyRules.insert(id);
 
     // save it
     saveRule(newRule);
     emit ruleConfigurationChanged(newRule);
 }
 
-bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId)
+bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const ThingClass &thingClass)
 {
     foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
         // If this is a thing based rule, eventTypeId and thingId must match
@@ -820,13 +829,12 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
 
         // If this is a interface based rule, the thing must implement the interface
         if (eventDescriptor.type() == EventDescriptor::TypeInterface) {
-            ThingClass dc = NymeaCore::instance()->thingManager()->findThingClass(thingClassId);
-            if (!dc.interfaces().contains(eventDescriptor.interface())) {
+            if (!thingClass.interfaces().contains(eventDescriptor.interface())) {
                 // ThingClass for this event doesn't implement the interface for this eventDescriptor
                 continue;
             }
 
-            EventType et = dc.eventTypes().findById(event.eventTypeId());
+            EventType et = thingClass.eventTypes().findById(event.eventTypeId());
             if (et.name() != eventDescriptor.interfaceEvent()) {
                 // The fired event name does not match with the eventDescriptor's interfaceEvent
                 continue;
@@ -845,8 +853,7 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
                     allOK = false;
                     continue;
                 }
-                ThingClass dc = NymeaCore::instance()->thingManager()->findThingClass(thingClassId);
-                EventType et = dc.eventTypes().findById(event.eventTypeId());
+                EventType et = thingClass.eventTypes().findById(event.eventTypeId());
                 ParamType pt = et.paramTypes().findByName(paramDescriptor.paramName());
                 paramValue = event.param(pt.id()).value();
             }
@@ -894,29 +901,91 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
     return false;
 }
 
-bool RuleEngine::containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent)
+void RuleEngine::indexRule(const Rule &rule)
+{
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        if (eventDescriptor.type() == EventDescriptor::TypeThing) {
+            m_thingIndex[qMakePair(eventDescriptor.thingId(), QUuid(eventDescriptor.eventTypeId()))].insert(rule.id());
+        } else {
+            m_interfaceEventIndex[qMakePair(eventDescriptor.interface(), eventDescriptor.interfaceEvent())].insert(rule.id());
+        }
+    }
+    indexStateEvaluator(rule.id(), rule.stateEvaluator(), true);
+}
+
+void RuleEngine::unindexRule(const Rule &rule)
 {
-    if (stateEvaluator.stateDescriptor().isValid()) {
-        if (stateEvaluator.stateDescriptor().type() == StateDescriptor::TypeThing) {
-            if (stateEvaluator.stateDescriptor().stateTypeId().toString() == stateChangeEvent.eventTypeId().toString()) {
-                return true;
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        if (eventDescriptor.type() == EventDescriptor::TypeThing) {
+            QPair<ThingId, QUuid> key = qMakePair(eventDescriptor.thingId(), QUuid(eventDescriptor.eventTypeId()));
+            m_thingIndex[key].remove(rule.id());
+            if (m_thingIndex.value(key).isEmpty()) {
+                m_thingIndex.remove(key);
             }
         } else {
-            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(stateChangeEvent.thingId());
-            ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
-            if (thingClass.interfaces().contains(stateEvaluator.stateDescriptor().interface())) {
-                return true;
+            QPair<QString, QString> key = qMakePair(eventDescriptor.interface(), eventDescriptor.interfaceEvent());
+            m_interfaceEventIndex[key].remove(rule.id());
+            if (m_interfaceEventIndex.value(key).isEmpty()) {
+                m_interfaceEventIndex.remove(key);
+            }
+        }
+    }
+    indexStateEvaluator(rule.id(), rule.stateEvaluator(), false);
+    m_dirtyRules.remove(rule.id());
+}
+
+void RuleEngine::indexStateEvaluator(const RuleId &ruleId, const StateEvaluator &stateEvaluator, bool add)
+{
+    const StateDescriptor &stateDescriptor = stateEvaluator.stateDescriptor();
+    if (stateDescriptor.isValid()) {
+        if (stateDescriptor.type() == StateDescriptor::TypeThing) {
+            // State change events use the stateTypeId as eventTypeId
+            QPair<ThingId, QUuid> key = qMakePair(stateDescriptor.thingId(), QUuid(stateDescriptor.stateTypeId()));
+            if (add) {
+                m_thingIndex[key].insert(ruleId);
+            } else {
+                m_thingIndex[key].remove(ruleId);
+                if (m_thingIndex.value(key).isEmpty()) {
+                    m_thingIndex.remove(key);
+                }
+            }
+        } else {
+            // Any event of a thing implementing the interface re-evaluates the states
+            if (add) {
+                m_interfaceStateIndex[stateDescriptor.interface()].insert(ruleId);
+            } else {
+                m_interfaceStateIndex[stateDescriptor.interface()].remove(ruleId);
+                if (m_interfaceStateIndex.value(stateDescriptor.interface()).isEmpty()) {
+                    m_interfaceStateIndex.remove(stateDescriptor.interface());
+                }
             }
         }
     }
 
     foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
-        if (containsState(childEvaluator, stateChangeEvent)) {
-            return true;
+        indexStateEvaluator(ruleId, childEvaluator, add);
+    }
+}
+
+QList<RuleId> RuleEngine::candidateRules(const Event &event, const ThingClass &thingClass)
+{
+    QSet<RuleId> candidates = m_dirtyRules;
+    candidates.unite(m_thingIndex.value(qMakePair(event.thingId(), QUuid(event.eventTypeId()))));
+
+    if (!m_interfaceEventIndex.isEmpty() || !m_interfaceStateIndex.isEmpty()) {
+        QString eventName = thingClass.eventTypes().findById(event.eventTypeId()).name();
+        foreach (const QString &interface, thingClass.interfaces()) {
+            candidates.unite(m_interfaceEventIndex.value(qMakePair(interface, eventName)));
+            candidates.unite(m_interfaceStateIndex.value(interface));
         }
     }
 
-    return false;
+    // Keep the order in which the rules have been added
+    QList<RuleId> ruleIds = candidates.toList();
+    std::sort(ruleIds.begin(), ruleIds.end(), [this](const RuleId &a, const RuleId &b){
+        return m_ruleOrder.value(a) < m_ruleOrder.value(b);
+    });
+    return ruleIds;
 }
 
 RuleEngine::RuleError RuleEngine::checkRuleAction(const RuleAction &ruleAction, const Rule &rule)
@@ -1099,10 +1168,38 @@ QVariant::Type RuleEngine::getEventParamType(const EventTypeId &eventTypeId, con
 void RuleEngine::appendRule(const Rule &rule)
 {
     Rule newRule = rule;
-    newRule.setStatesActive(newRule.stateEvaluator().evaluate());
+    CompiledStateEvaluator compiledEvaluator(newRule.stateEvaluator(), NymeaCore::instance()->thingManager());
+    m_compiledEvaluators.insert(rule.id(), compiledEvaluator);
+    newRule.setStatesActive(compiledEvaluator.evaluate());
     qCDebug(dcRuleEngine()) << "Adding Rule:" << newRule;
     m_rules.insert(rule.id(), newRule);
     m_ruleIds.append(rule.id());
+    m_ruleOrder.insert(rule.id(), m_nextRuleOrder++);
+    indexRule(newRule);
+    m_dirtyRules.insert(rule.id());
+}
+
+void RuleEngine::recompileRules(const ThingId &thingId, const QStringList &interfaces)
+{
+    QHash<RuleId, CompiledStateEvaluator>::iterator it;
+    for (it = m_compiledEvaluators.begin(); it != m_compiledEvaluators.end(); ++it) {
+        if (it.value().dependsOnThing(thingId, interfaces)) {
+            qCDebug(dcRuleEngineDebug()) << "Recompiling state evaluator of rule" << it.key().toString();
+            it.value() = CompiledStateEvaluator(m_rules.value(it.key()).stateEvaluator(), NymeaCore::instance()->thingManager());
+            m_dirtyRules.insert(it.key());
+        }
+    }
+}
+
+void RuleEngine::onThingAdded(Thing *thing)
+{
+    ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
+    recompileRules(thing->id(), thingClass.interfaces());
+}
+
+void RuleEngine::onThingRemoved(const ThingId &thingId)
+{
+    recompileRules(thingId, QStringList());
 }
 
 void RuleEngine::saveRule(const Rule &rule)
@@ -1341,6 +1438,9 @@ QList<RuleAction> RuleEngine::loadRuleActions(NymeaSettings *settings)
 
 void RuleEngine::init()
 {
+    connect(NymeaCore::instance()->thingManager(), &ThingManager::thingAdded, this, &RuleEngine::onThingAdded);
+    connect(NymeaCore::instance()->thingManager(), &ThingManager::thingRemoved, this, &RuleEngine::onThingRemoved);
+
     NymeaSettings settings(NymeaSettings::SettingsRoleRules);
     qCDebug(dcRuleEngine) << "Loading rules from" << settings.fileName();
     foreach (const QString &idString, settings.childGroups()) {
@@ -1524,7 +1624,6 @@ void RuleEngine::init()
         rule.setExitActions(exitActions);
         rule.setEnabled(enabled);
         rule.setExecutable(executable);
-        rule.setStatesActive(rule.stateEvaluator().evaluate());
         appendRule(rule);
         settings.endGroup();
     }
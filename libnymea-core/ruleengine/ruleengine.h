@@ -33,6 +33,7 @@
 
 #include "rule.h"
 #include "stateevaluator.h"
+#include "compiledstateevaluator.h"
 #include "types/event.h"
 #include "types/thingclass.h"
 
@@ -40,6 +41,8 @@
 #include <QList>
 #include <QUuid>
 #include <QSettings>
+#include <QHash>
+#include <QSet>
 
 namespace nymeaserver {
 
@@ -110,9 +113,17 @@ signals:
     void ruleRemoved(const RuleId &ruleId);
     void ruleConfigurationChanged(const Rule &rule);
 
+private slots:
+    void onThingAdded(Thing *thing);
+    void onThingRemoved(const ThingId &thingId);
+
 private:
-    bool containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId);
-    bool containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent);
+    bool containsEvent(const Rule &rule, const Event &event, const ThingClass &thingClass);
+
+    void indexRule(const Rule &rule);
+    void unindexRule(const Rule &rule);
+    void indexStateEvaluator(const RuleId &ruleId, const StateEvaluator &stateEvaluator, bool add);
+    QList<RuleId> candidateRules(const Event &event, const ThingClass &thingClass);
 
     RuleError checkRuleAction(const RuleAction &ruleAction, const Rule &rule);
     RuleError checkRuleActionParam(const RuleActionParam &ruleActionParam, const ActionType &actionType, const Rule &rule);
@@ -121,6 +132,7 @@ private:
     QVariant::Type getEventParamType(const EventTypeId &eventTypeId, const ParamTypeId &paramTypeId);
 
     void appendRule(const Rule &rule);
+    void recompileRules(const ThingId &thingId, const QStringList &interfaces);
     void saveRule(const Rule &rule);
     void saveRuleActions(NymeaSettings *settings, const QList<RuleAction> &ruleActions);
     QList<RuleAction> loadRuleActions(NymeaSettings *settings);
@@ -130,6 +142,17 @@ private:
     QHash<RuleId, Rule> m_rules; // ...but use a Hash for faster finding
     QList<RuleId> m_activeRules;
 
+    // Inverted indexes to find the rules an event might affect without looking at all the others
+    QHash<QPair<ThingId, QUuid>, QSet<RuleId>> m_thingIndex; // (thingId, eventTypeId or stateTypeId)
+    QHash<QPair<QString, QString>, QSet<RuleId>> m_interfaceEventIndex; // (interface, interfaceEvent)
+    QHash<QString, QSet<RuleId>> m_interfaceStateIndex; // interface
+    // Rules which need to be evaluated on the next event regardless of the indexes (e.g. just added or enabled)
+    QSet<RuleId> m_dirtyRules;
+    QHash<RuleId, quint64> m_ruleOrder;
+    quint64 m_nextRuleOrder = 0;
+
+    QHash<RuleId, CompiledStateEvaluator> m_compiledEvaluators;
+
     QDateTime m_lastEvaluationTime;
 };
 
@@ -110,6 +110,17 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
 
     // Interfaces
     m_jsonServer = new JsonRPCServerImplementation(m_sslConfiguration, this);
+    m_jsonServer->setMaxMessageSize(configuration->jsonRpcMaxMessageSize());
+    m_jsonServer->setCompression(configuration->jsonRpcCompressionLevel(), configuration->jsonRpcCompressionThreshold());
+
+    m_sendQueueConfiguration.highWatermark = configuration->jsonRpcSendQueueHighWatermark();
+    m_sendQueueConfiguration.lowWatermark = qMin(configuration->jsonRpcSendQueueLowWatermark(), configuration->jsonRpcSendQueueHighWatermark());
+    m_sendQueueConfiguration.maxQueueSize = configuration->jsonRpcSendQueueMaxSize();
+    if (configuration->jsonRpcSendQueuePolicy() == "dropOldest") {
+        m_sendQueueConfiguration.overflowPolicy = SendQueue::OverflowPolicyDropOldest;
+    } else {
+        m_sendQueueConfiguration.overflowPolicy = SendQueue::OverflowPolicyCoalesce;
+    }
 
     // Transports
     MockTcpServer *tcpServer = new MockTcpServer(this);
@@ -117,6 +128,7 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
     tcpServer->startServer();
     foreach (const ServerConfiguration &config, configuration->tcpServerConfigurations()) {
         TcpServer *tcpServer = new TcpServer(config, m_sslConfiguration, this);
+        tcpServer->setSendQueueConfiguration(m_sendQueueConfiguration);
         m_jsonServer->registerTransportInterface(tcpServer, config.authenticationEnabled);
         m_tcpServers.insert(config.id, tcpServer);
         if (tcpServer->startServer()) {
@@ -126,6 +138,7 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
 
     foreach (const ServerConfiguration &config, configuration->webSocketServerConfigurations()) {
         WebSocketServer *webSocketServer = new WebSocketServer(config, m_sslConfiguration, this);
+        webSocketServer->setSendQueueConfiguration(m_sendQueueConfiguration);
         m_jsonServer->registerTransportInterface(webSocketServer, config.authenticationEnabled);
         m_webSocketServers.insert(config.id, webSocketServer);
         if (webSocketServer->startServer()) {
@@ -202,6 +215,7 @@ void ServerManager::tcpServerConfigurationChanged(const QString &id)
     } else {
         qDebug(dcServerManager()) << "Received a TCP Server config change event but don't have a TCP Server instance for it. Creating new Server instance.";
         server = new TcpServer(config, m_sslConfiguration, this);
+        server->setSendQueueConfiguration(m_sendQueueConfiguration);
         m_tcpServers.insert(config.id, server);
     }
     m_jsonServer->registerTransportInterface(server, config.authenticationEnabled);
@@ -235,6 +249,7 @@ void ServerManager::webSocketServerConfigurationChanged(const QString &id)
     } else {
         qDebug(dcServerManager()) << "Received a WebSocket Server config change event but don't have a WebSocket Server instance for it. Creating new instance.";
         server = new WebSocketServer(config, m_sslConfiguration, this);
+        server->setSendQueueConfiguration(m_sendQueueConfiguration);
         m_webSocketServers.insert(server->configuration().id, server);
     }
     m_jsonServer->registerTransportInterface(server, config.authenticationEnabled);
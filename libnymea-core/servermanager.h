@@ -35,6 +35,7 @@
 
 #include "loggingcategories.h"
 #include "nymeaconfiguration.h"
+#include "servers/sendqueue.h"
 
 #include <QSslConfiguration>
 #include <QSslKey>
@@ -95,6 +96,7 @@ private:
     QHash<QString, WebSocketServer*> m_webSocketServers;
     QHash<QString, WebServer*> m_webServers;
     MockTcpServer *m_mockTcpServer;
+    SendQueue::Configuration m_sendQueueConfiguration;
 
     MqttBroker *m_mqttBroker;
 
@@ -38,6 +38,9 @@
     This class holds the header and the payload data of a network reply and represents a response
     from the nymea webserver to a \l{HttpRequest}.
 
+    Large payloads don't need to be held in memory. Instead, a \l{QIODevice} can be set as payload
+    device, which will be read piecewise by the \l{WebServer} while the data is being sent.
+
     \note RFC 7231 HTTP/1.1 Semantics and Content -> \l{http://tools.ietf.org/html/rfc7231}{http://tools.ietf.org/html/rfc7231}
 */
 
@@ -57,6 +60,8 @@
         The request has no content but it was expected.
     \value Found
         The resource was found.
+    \value NotModified
+        The resource has not been modified since the version given in the request.
     \value PermanentRedirect
         The resource redirects permanent to given url.
     \value BadRequest
@@ -172,7 +177,7 @@ HttpReply::HttpReply(QObject *parent) :
     setHeader(HttpHeaderType::CacheControlHeader, "no-cache");
     setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
     setRawHeader("Access-Control-Allow-Origin","*");
-    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout).toUtf8());
+    setRawHeader("Keep-Alive", QString("timeout=%1").arg(m_timeout / 1000).toUtf8());
     packReply();
 }
 
@@ -181,6 +186,7 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     m_statusCode(statusCode),
     m_type(type),
     m_payload(QByteArray()),
+    m_closeConnection(false),
     m_timedOut(false)
 {
     m_timer = new QTimer(this);
@@ -195,7 +201,7 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     setHeader(HttpHeaderType::CacheControlHeader, "no-cache");
     setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
     setRawHeader("Access-Control-Allow-Origin","*");
-    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout).toUtf8());
+    setRawHeader("Keep-Alive", QString("timeout=%1").arg(m_timeout / 1000).toUtf8());
     packReply();
 }
 
@@ -263,6 +269,11 @@ QUuid HttpReply::clientId() const
 /*! Set the payload of this \l{HttpReply} to the given \a data.*/
 void HttpReply::setPayload(const QByteArray &data)
 {
+    if (m_payloadDevice) {
+        m_payloadDevice->deleteLater();
+        m_payloadDevice = nullptr;
+        m_rawHeaderList.remove("Transfer-Encoding");
+    }
     m_payload = data;
     setHeader(HttpHeaderType::ContentLenghtHeader, QByteArray::number(data.length()));
     packReply();
@@ -274,6 +285,64 @@ QByteArray HttpReply::payload() const
     return m_payload;
 }
 
+/*! Set the payload of this \l{HttpReply} to the content of the given \a device. The \a device must be
+    opened for reading and the \l{HttpReply} takes ownership of it. The payload will be read from the
+    \a device piecewise while it is being sent, so it never needs to be fully held in memory.
+
+    If the \a size of the content is known, it will be sent with a Content-Length header. Otherwise,
+    the payload will be sent with chunked transfer encoding until the end of the \a device is reached.
+
+    \sa takePayloadDevice()
+*/
+void HttpReply::setPayloadDevice(QIODevice *device, qint64 size)
+{
+    if (m_payloadDevice) {
+        m_payloadDevice->deleteLater();
+    }
+
+    m_payload.clear();
+    m_payloadDevice = device;
+    m_payloadDevice->setParent(this);
+    m_payloadDeviceSize = size;
+    if (size >= 0) {
+        m_rawHeaderList.remove("Transfer-Encoding");
+        setHeader(HttpHeaderType::ContentLenghtHeader, QByteArray::number(size));
+    } else {
+        m_rawHeaderList.remove(getHeaderType(HttpHeaderType::ContentLenghtHeader));
+        setRawHeader("Transfer-Encoding", "chunked");
+    }
+}
+
+/*! Returns the payload device of this \l{HttpReply}, or nullptr if the payload is held in memory.*/
+QIODevice *HttpReply::payloadDevice() const
+{
+    return m_payloadDevice;
+}
+
+/*! Returns the payload device of this \l{HttpReply} and releases the ownership of it. The caller
+    is responsible for deleting the device.
+*/
+QIODevice *HttpReply::takePayloadDevice()
+{
+    QIODevice *device = m_payloadDevice;
+    m_payloadDevice = nullptr;
+    if (device) {
+        device->setParent(nullptr);
+    }
+    return device;
+}
+
+/*! Returns the size of the payload of this \l{HttpReply}, or -1 if the size of the payload
+    device is not known and the payload is sent with chunked transfer encoding.
+*/
+qint64 HttpReply::payloadSize() const
+{
+    if (m_payloadDevice) {
+        return m_payloadDeviceSize;
+    }
+    return m_payload.size();
+}
+
 /*! This method appends a raw header to the header list of this \l{HttpReply}.
     The Header will be set to \a headerType : \a value.
 */
@@ -316,6 +385,13 @@ QByteArray HttpReply::rawHeader() const
 void HttpReply::setCloseConnection(const bool &close)
 {
     m_closeConnection = close;
+    if (close) {
+        m_rawHeaderList.remove("Keep-Alive");
+        setHeader(HttpHeaderType::ConnectionHeader, "close");
+    } else {
+        setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
+        setRawHeader("Keep-Alive", QString("timeout=%1").arg(m_timeout / 1000).toUtf8());
+    }
 }
 
 /*! Returns the connection close parameter of this \l{HttpReply}. If close is true, the connection
@@ -329,7 +405,7 @@ bool HttpReply::closeConnection() const
 /*! Returns true if the raw header and the payload of this \l{HttpReply} is empty.*/
 bool HttpReply::isEmpty() const
 {
-    return m_rawHeader.isEmpty() && m_payload.isEmpty() && m_rawHeaderList.isEmpty();
+    return m_rawHeader.isEmpty() && m_payload.isEmpty() && !m_payloadDevice && m_rawHeaderList.isEmpty();
 }
 
 /*! Clears all data of this \l{HttpReply}. */
@@ -340,15 +416,18 @@ void HttpReply::clear()
     m_statusCode = Ok;
     m_rawHeader.clear();
     m_payload.clear();
+    if (m_payloadDevice) {
+        m_payloadDevice->deleteLater();
+        m_payloadDevice = nullptr;
+    }
     m_rawHeaderList.clear();
 }
-/*! Packs the whole reply data of this \l{HttpReply}. The data can be accessed with \l{HttpReply::data()}.
+/*! Packs the header of this \l{HttpReply}. The header can be accessed with \l{HttpReply::rawHeader()}.
     \sa data()
 */
 void HttpReply::packReply()
 {
     // set status code
-    m_data.clear();
     m_rawHeader.clear();
     m_rawHeader.append("HTTP/1.1 " + QByteArray::number(m_statusCode) + " " + getHttpReasonPhrase(m_statusCode) + "\r\n");
 
@@ -358,13 +437,17 @@ void HttpReply::packReply()
     }
 
     m_rawHeader.append("\r\n");
-    m_data = QByteArray(m_rawHeader).append(m_payload);
 }
 
-/*! Returns the current raw data (header + payload) of this \l{HttpReply}.*/
+/*! Returns the current raw data (header + payload) of this \l{HttpReply}. The content of a
+    payload device is not included.
+
+    \note This copies the whole payload. In order to send the reply, write the \l{rawHeader()}
+    and the \l{payload()} separately.
+*/
 QByteArray HttpReply::data() const
 {
-    return m_data;
+    return QByteArray(m_rawHeader).append(m_payload);
 }
 
 /*! Return true if the response took to long for the request.*/
@@ -392,6 +475,9 @@ QByteArray HttpReply::getHttpReasonPhrase(const HttpReply::HttpStatusCode &statu
     case Found:
         response = QString("Found").toUtf8();
         break;
+    case NotModified:
+        response = QString("Not Modified").toUtf8();
+        break;
     case PermanentRedirect:
         response = QString("Permanent Redirect").toUtf8();
         break;
@@ -33,6 +33,7 @@
 
 #include <QObject>
 #include <QByteArray>
+#include <QIODevice>
 #include <QHash>
 #include <QTimer>
 #include <QUuid>
@@ -52,6 +53,7 @@ public:
         Accepted                = 202,
         NoContent               = 204,
         Found                   = 302,
+        NotModified             = 304,
         PermanentRedirect       = 308,
         BadRequest              = 400,
         Forbidden               = 403,
@@ -104,6 +106,11 @@ public:
     void setPayload(const QByteArray &data);
     QByteArray payload() const;
 
+    void setPayloadDevice(QIODevice *device, qint64 size = -1);
+    QIODevice *payloadDevice() const;
+    QIODevice *takePayloadDevice();
+    qint64 payloadSize() const;
+
     void setRawHeader(const QByteArray headerType, const QByteArray &value);
     void setHeader(const HttpHeaderType &headerType, const QByteArray &value);
     QHash<QByteArray, QByteArray> rawHeaderList() const;
@@ -129,7 +136,8 @@ private:
 
     QByteArray m_rawHeader;
     QByteArray m_payload;
-    QByteArray m_data;
+    QIODevice *m_payloadDevice = nullptr;
+    qint64 m_payloadDeviceSize = -1;
 
     QHash<QByteArray, QByteArray> m_rawHeaderList;
 
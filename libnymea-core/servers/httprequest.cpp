@@ -78,13 +78,14 @@ HttpRequest::HttpRequest() :
 {
 }
 
-/*! Construct a \l{HttpRequest} with the given \a rawData. The \a rawData will be parsed in this constructor. You can check
-    if the data is valid with \l{isValid()}. You can check if the request is complete with \l{isComplete}.
+/*! Construct a \l{HttpRequest} with the given \a rawData, starting at \a offset. The \a rawData will be parsed in this
+    constructor. You can check if the data is valid with \l{isValid()}. You can check if the request is complete with \l{isComplete}.
 
     \sa isValid(), isComplete()
 */
-HttpRequest::HttpRequest(QByteArray rawData) :
+HttpRequest::HttpRequest(QByteArray rawData, int offset) :
     m_rawData(rawData),
+    m_start(offset),
     m_valid(false),
     m_isComplete(false)
 {
@@ -148,7 +149,7 @@ bool HttpRequest::isValid() const
     return m_valid;
 }
 
-/*! Returns true if this \l{HttpRequest} is complete. A HTTP request is complete if "Content-Length" header value matches the actual payload size. Bigger packages will be sent in multiple TCP packages. */
+/*! Returns true if this \l{HttpRequest} is complete. A HTTP request is complete if the whole header and as many payload bytes as given in the "Content-Length" header have been received. Bigger packages will be sent in multiple TCP packages. */
 bool HttpRequest::isComplete() const
 {
     return m_isComplete;
@@ -160,6 +161,23 @@ bool HttpRequest::hasPayload() const
     return !m_payload.isEmpty();
 }
 
+/*! Returns true if the client wants to keep the connection open after the reply to this \l{HttpRequest}.
+ *  Connections are persistent by default for HTTP/1.1, unless the client sends "Connection: close".
+ *  HTTP/1.0 clients have to request a persistent connection with "Connection: keep-alive".
+*/
+bool HttpRequest::keepAlive() const
+{
+    QList<QByteArray> connectionOptions;
+    foreach (const QByteArray &option, headerValue("Connection").toLower().split(',')) {
+        connectionOptions.append(option.trimmed());
+    }
+
+    if (m_httpVersion == "HTTP/1.0")
+        return connectionOptions.contains("keep-alive");
+
+    return !connectionOptions.contains("close");
+}
+
 /*! Appends the given \a data to the current raw data of this \l{HttpRequest}.
  *  This method will be used if a \l{HttpRequest} is not complete yet.
  *
@@ -171,93 +189,201 @@ void HttpRequest::appendData(const QByteArray &data)
     validate();
 }
 
-void HttpRequest::validate()
+/*! Returns the data which was received after this complete \l{HttpRequest}. Clients may send
+ *  further requests without waiting for the reply (pipelining), the returned data is the start of the next request.
+*/
+QByteArray HttpRequest::pipelinedData() const
 {
-    m_isComplete = true; m_valid = false;
+    return m_receivedData.mid(m_pipelinedOffset);
+}
 
-    // Parese the HTTP request. The request is invalid, until the end of the parse process.
-    if (m_rawData.isEmpty())
-        return;
+/*! Returns true if further data was received after this complete \l{HttpRequest}.
 
-    // split the data into header and payload
-    int headerEndIndex = m_rawData.indexOf("\r\n\r\n");
-    if (headerEndIndex < 0) {
-        qCWarning(dcWebServer()) << "Could not parse end of HTTP header (empty line between header and body):" << m_rawData;
-        return;
-    }
+  \sa pipelinedData()
+*/
+bool HttpRequest::hasPipelinedData() const
+{
+    return m_pipelinedOffset < m_receivedData.size();
+}
 
-    m_rawHeader = m_rawData.left(headerEndIndex);
-    m_payload = m_rawData.right(m_rawData.length() - headerEndIndex).simplified();
+/*! Returns the \l{HttpRequest} parsed from the data received after this one. Unlike parsing the
+ *  pipelinedData(), this does not copy the remaining data for each pipelined request.
 
-    // parse status line
-    QStringList headerLines = QString(m_rawHeader).split(QRegExp("\r\n"));
-    QString statusLine = headerLines.takeFirst();
-    QStringList statusLineTokens = statusLine.split(QRegExp("[ \r\n][ \r\n]*"));
-    if (statusLineTokens.count() != 3) {
-        qCWarning(dcWebServer()) << "Could not parse HTTP status line:" << statusLine;
-        return;
-    }
+  \sa hasPipelinedData()
+*/
+HttpRequest HttpRequest::nextPipelinedRequest() const
+{
+    return HttpRequest(m_receivedData, m_pipelinedOffset);
+}
 
-    // verify http version
-    m_httpVersion = statusLineTokens.at(2).toUtf8().simplified();
-    if (!m_httpVersion.contains("HTTP")) {
-        qCWarning(dcWebServer()) << "Unknown HTTP version:" << m_httpVersion;
-        return;
-    }
-    m_methodString = statusLineTokens.at(0).simplified();
-    m_method = getRequestMethodType(m_methodString);
+// Returns true if the data at from could be the beginning of a request line, i.e. "GET / HTTP/1.1"
+static bool startsWithRequestLine(const QByteArray &data, int from)
+{
+    int index = from;
+    while (index < data.size() && data.at(index) >= 'A' && data.at(index) <= 'Z')
+        index++;
 
-    m_url = QUrl("http://example.com" + statusLineTokens.at(1).simplified());
+    return index > from && (index == data.size() || data.at(index) == ' ');
+}
 
-    if (m_url.hasQuery())
-        m_urlQuery = QUrlQuery(m_url.query());
+// Skips the whitespace in front of a request. Empty lines in front of a request must be ignored (RFC 7230, 3.5)
+static int requestStart(const QByteArray &data, int from = 0)
+{
+    while (from < data.size() && QChar(data.at(from)).isSpace())
+        from++;
 
-    // verify header formating
-    foreach (const QString &line, headerLines) {
-        if (!line.contains(":")) {
-            qCWarning(dcWebServer()) << "Invalid HTTP header:" << line;
-            return;
-        }
-        int index = line.indexOf(":");
-        QByteArray key = line.left(index).toUtf8().simplified();
-        QByteArray value = line.right(line.count() - index - 1).toUtf8().simplified();
-        m_rawHeaderList.insert(key, value);
-    }
+    return from;
+}
 
-    // check User-Agent
-    if (!m_rawHeaderList.contains("User-Agent"))
-        qCWarning(dcWebServer()) << "User-Agent header is missing";
+void HttpRequest::validate()
+{
+    static const int maxHeaderSize = 64 * 1024;
 
+    m_isComplete = true; m_valid = false;
+
+    // The header gets parsed only once, appended data only completes the payload
+    if (m_payloadOffset < 0) {
+        m_start = requestStart(m_rawData, m_start);
 
-    // verify content length with actual payload
-    if (m_rawHeaderList.contains("Content-Length")) {
-        bool ok = false;
-        int contentLength = m_rawHeaderList.value("Content-Length").toInt(&ok);
-        if (!ok) {
-            qCWarning(dcWebServer()) << "Could not parse Content-Length.";
+        // Parese the HTTP request. The request is invalid, until the end of the parse process.
+        if (m_start >= m_rawData.size()) {
+            m_rawData.clear();
+            m_start = 0;
+            m_isComplete = false;
             return;
         }
-        // check if we have all data
-        if (m_payload.size() < contentLength) {
-            qCDebug(dcWebServer()) << "Request incomplete:";
-            qCDebug(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCDebug(dcWebServer()) << "   -> Payload size  :" << payload().size();
+
+        // split the data into header and payload
+        int headerEndIndex = m_rawData.indexOf("\r\n\r\n", m_start);
+        if (headerEndIndex < 0) {
+            if (m_rawData.size() - m_start > maxHeaderSize) {
+                qCWarning(dcWebServer()) << "Could not parse end of HTTP header within" << maxHeaderSize << "bytes.";
+                return;
+            }
+            // Wait for the rest of the header
+            keepIncompleteRequest();
             m_isComplete = false;
             return;
         }
-        // check if the content length bigger than header Content-Length
-        if (m_payload.size() > contentLength) {
-            qCWarning(dcWebServer()) << "Payload size greater than header Content-Length:";
-            qCWarning(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCWarning(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = true;
+
+        m_rawHeader = m_rawData.mid(m_start, headerEndIndex - m_start);
+
+        // parse status line
+        QStringList headerLines = QString(m_rawHeader).split(QRegExp("\r\n"));
+        QString statusLine = headerLines.takeFirst();
+        QStringList statusLineTokens = statusLine.split(QRegExp("[ \r\n][ \r\n]*"));
+        if (statusLineTokens.count() != 3) {
+            qCWarning(dcWebServer()) << "Could not parse HTTP status line:" << statusLine;
+            return;
+        }
+
+        // verify http version
+        m_httpVersion = statusLineTokens.at(2).toUtf8().simplified();
+        if (!m_httpVersion.contains("HTTP")) {
+            qCWarning(dcWebServer()) << "Unknown HTTP version:" << m_httpVersion;
             return;
         }
+        m_methodString = statusLineTokens.at(0).simplified();
+        m_method = getRequestMethodType(m_methodString);
+
+        m_url = QUrl("http://example.com" + statusLineTokens.at(1).simplified());
+
+        if (m_url.hasQuery())
+            m_urlQuery = QUrlQuery(m_url.query());
+
+        // verify header formating
+        foreach (const QString &line, headerLines) {
+            if (!line.contains(":")) {
+                qCWarning(dcWebServer()) << "Invalid HTTP header:" << line;
+                return;
+            }
+            int index = line.indexOf(":");
+            QByteArray key = line.left(index).toUtf8().simplified();
+            QByteArray value = line.right(line.count() - index - 1).toUtf8().simplified();
+            m_rawHeaderList.insert(key, value);
+        }
+
+        // check User-Agent
+        if (!m_rawHeaderList.contains("User-Agent"))
+            qCWarning(dcWebServer()) << "User-Agent header is missing";
+
+        // Without Content-Length the request has no payload
+        m_contentLength = 0;
+        if (!headerValue("Content-Length").isEmpty()) {
+            bool ok = false;
+            m_contentLength = headerValue("Content-Length").toInt(&ok);
+            if (!ok || m_contentLength < 0) {
+                qCWarning(dcWebServer()) << "Could not parse Content-Length.";
+                return;
+            }
+        }
+
+        m_payloadOffset = headerEndIndex + 4;
+    }
+
+    // check if we have all data
+    if (m_rawData.size() - m_payloadOffset < m_contentLength) {
+        qCDebug(dcWebServer()) << "Request incomplete:";
+        qCDebug(dcWebServer()) << "   -> Content-Length:" << m_contentLength;
+        qCDebug(dcWebServer()) << "   -> Payload size  :" << m_rawData.size() - m_payloadOffset;
+        keepIncompleteRequest();
+        m_isComplete = false;
+        return;
+    }
+
+    m_payload = m_rawData.mid(m_payloadOffset, m_contentLength);
 
+    // Data following the payload is either the next pipelined request or more payload than announced
+    int requestEnd = m_payloadOffset + m_contentLength;
+    int nextRequest = requestStart(m_rawData, requestEnd);
+    if (nextRequest < m_rawData.size() && !startsWithRequestLine(m_rawData, nextRequest)) {
+        qCWarning(dcWebServer()) << "Payload size greater than header Content-Length:";
+        qCWarning(dcWebServer()) << "   -> Content-Length:" << m_contentLength;
+        qCWarning(dcWebServer()) << "   -> Payload size  :" << m_rawData.size() - m_payloadOffset;
+        return;
     }
+
+    // Only this request is copied out of the received data
+    m_receivedData = m_rawData;
+    m_pipelinedOffset = nextRequest;
+    m_rawData = m_receivedData.mid(m_start, requestEnd - m_start);
+    m_payloadOffset -= m_start;
+    m_start = 0;
+
     m_valid = true;
 }
 
+// Drops the data in front of this request while waiting for the rest of it. This is the last
+// request in the received data, so this copies the remaining data at most once.
+void HttpRequest::keepIncompleteRequest()
+{
+    if (m_start == 0)
+        return;
+
+    m_rawData.remove(0, m_start);
+    if (m_payloadOffset >= 0)
+        m_payloadOffset -= m_start;
+    m_start = 0;
+}
+
+/*! Returns the value of the header with the given \a headerName, compared case insensitively.
+    Returns an empty QByteArray if the request has no such header.
+*/
+QByteArray HttpRequest::headerValue(const QByteArray &headerName) const
+{
+    // Header names are case insensitive
+    QHash<QByteArray, QByteArray>::const_iterator it = m_rawHeaderList.constFind(headerName);
+    if (it != m_rawHeaderList.constEnd())
+        return it.value();
+
+    foreach (const QByteArray &key, m_rawHeaderList.keys()) {
+        if (key.toLower() == headerName.toLower()) {
+            return m_rawHeaderList.value(key);
+        }
+    }
+    return QByteArray();
+}
+
 HttpRequest::RequestMethod HttpRequest::getRequestMethodType(const QString &methodString)
 {
     if (methodString == "GET") {
@@ -51,10 +51,11 @@ public:
     };
 
     HttpRequest();
-    HttpRequest(QByteArray rawData);
+    HttpRequest(QByteArray rawData, int offset = 0);
 
     QByteArray rawHeader() const;
     QHash<QByteArray, QByteArray> rawHeaderList() const;
+    QByteArray headerValue(const QByteArray &headerName) const;
 
     RequestMethod method() const;
     QString methodString() const;
@@ -68,15 +69,19 @@ public:
     bool isValid() const;
     bool isComplete() const;
     bool hasPayload() const;
+    bool keepAlive() const;
 
     void appendData(const QByteArray &data);
+    QByteArray pipelinedData() const;
+    bool hasPipelinedData() const;
+    HttpRequest nextPipelinedRequest() const;
 
 private:
     QByteArray m_rawData;
     QByteArray m_rawHeader;
     QHash<QByteArray, QByteArray> m_rawHeaderList;
 
-    RequestMethod m_method;
+    RequestMethod m_method = Unhandled;
     QString m_methodString;
     QByteArray m_httpVersion;
 
@@ -85,10 +90,21 @@ private:
 
     QByteArray m_payload;
 
+    // The received data this request was parsed from. Pipelined requests following this one are
+    // parsed from the same data, starting at m_pipelinedOffset, so it is not copied for each of them.
+    QByteArray m_receivedData;
+    int m_pipelinedOffset = 0;
+
+    // Start of this request and of its payload in m_rawData, -1 as long as the header has not been parsed
+    int m_start = 0;
+    int m_payloadOffset = -1;
+    int m_contentLength = 0;
+
     bool m_valid;
     bool m_isComplete;
 
     void validate();
+    void keepIncompleteRequest();
     RequestMethod getRequestMethodType(const QString &methodString);
 };
 
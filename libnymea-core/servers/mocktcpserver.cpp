@@ -50,6 +50,7 @@ MockTcpServer::MockTcpServer(QObject *parent):
 
     connect(this, &TransportInterface::clientDisconnected, this, [this](const QUuid &clientId){
         m_connectedClients.removeAll(clientId);
+        m_bytesToWrite.remove(clientId);
     });
 }
 
@@ -66,7 +67,7 @@ void MockTcpServer::sendData(const QUuid &clientId, const QByteArray &data)
 void MockTcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
     foreach (const QUuid &clientId, clients) {
-        sendData(clientId, data + '\n');
+        sendData(clientId, data);
     }
 }
 
@@ -76,6 +77,17 @@ void MockTcpServer::terminateClientConnection(const QUuid &clientId)
     emit clientDisconnected(clientId);
 }
 
+bool MockTcpServer::binaryModeSupported() const
+{
+    // Injected data and outgoing data are passed as whole messages in binary mode
+    return true;
+}
+
+qint64 MockTcpServer::bytesToWrite(const QUuid &clientId) const
+{
+    return m_bytesToWrite.value(clientId);
+}
+
 QList<MockTcpServer *> MockTcpServer::servers()
 {
     return s_allServers;
@@ -87,6 +99,12 @@ void MockTcpServer::injectData(const QUuid &clientId, const QByteArray &data)
     emit dataAvailable(clientId, data);
 }
 
+void MockTcpServer::setBytesToWrite(const QUuid &clientId, qint64 bytesToWrite)
+{
+    // Simulates a client which does not read its data fast enough
+    m_bytesToWrite.insert(clientId, bytesToWrite);
+}
+
 bool MockTcpServer::reconfigureServer(const QHostAddress &address, const uint &port)
 {
     Q_UNUSED(address)
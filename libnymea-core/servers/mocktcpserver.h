@@ -33,6 +33,7 @@
 
 #include <QObject>
 #include <QNetworkInterface>
+#include <QHash>
 #include <QDebug>
 
 #include "transportinterface.h"
@@ -52,9 +53,13 @@ public:
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
     void terminateClientConnection(const QUuid &clientId) override;
 
+    bool binaryModeSupported() const override;
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+
 /************** Used for testing **************************/
     static QList<MockTcpServer*> servers();
     void injectData(const QUuid &clientId, const QByteArray &data);
+    void setBytesToWrite(const QUuid &clientId, qint64 bytesToWrite);
 signals:
     void outgoingData(const QUuid &clientId, const QByteArray &data);
     void connectionTerminated(const QUuid &clientId);
@@ -69,6 +74,7 @@ private:
     static QList<MockTcpServer*> s_allServers;
 
     QList<QUuid> m_connectedClients;
+    QHash<QUuid, qint64> m_bytesToWrite;
 };
 
 }
@@ -0,0 +1,192 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::SendQueue
+    \brief Bounded outgoing message queue for a single client connection.
+
+    \ingroup server
+    \inmodule core
+
+    Transports write messages directly to the connection as long as the client keeps up. Once the
+    connection buffers more than the high watermark, further messages are held back in the SendQueue
+    and written only after the connection has drained below the low watermark again.
+
+    Replies are never dropped. Notifications are limited to the maximum queue size: with the
+    \l{OverflowPolicyCoalesce} policy a queued notification is replaced by a newer one with the same
+    coalescing key, and if the queue still exceeds its size, the oldest notifications are dropped.
+
+    \sa TcpServer, WebSocketServer
+*/
+
+/*! \enum nymeaserver::SendQueue::MessageType
+
+    \value MessageTypeReply
+        A reply to a request. Replies are never dropped.
+    \value MessageTypeNotification
+        A notification which may be coalesced or dropped if the client does not keep up.
+*/
+
+/*! \enum nymeaserver::SendQueue::OverflowPolicy
+
+    \value OverflowPolicyDropOldest
+        Drop the oldest queued notifications when the queue exceeds its maximum size.
+    \value OverflowPolicyCoalesce
+        Replace queued notifications with newer ones with the same coalescing key and drop the
+        oldest notifications when the queue still exceeds its maximum size.
+*/
+
+#include "sendqueue.h"
+
+#include <algorithm>
+
+namespace nymeaserver {
+
+/*! Constructs an empty SendQueue with the given \a configuration. */
+SendQueue::SendQueue(const Configuration &configuration):
+    m_configuration(configuration)
+{
+}
+
+/*! Returns the watermarks and the overflow policy of this queue. */
+SendQueue::Configuration SendQueue::configuration() const
+{
+    return m_configuration;
+}
+
+/*! Sets the watermarks and the overflow policy of this queue to the given \a configuration. */
+void SendQueue::setConfiguration(const Configuration &configuration)
+{
+    m_configuration = configuration;
+}
+
+/*! Returns true if more messages may be written to a connection which currently buffers \a bytesToWrite bytes.
+    Writing stops once the high watermark is reached and resumes when the buffer drained below the low watermark.
+*/
+bool SendQueue::canWrite(qint64 bytesToWrite)
+{
+    if (m_blocked && bytesToWrite <= m_configuration.lowWatermark) {
+        m_blocked = false;
+    } else if (!m_blocked && bytesToWrite >= m_configuration.highWatermark) {
+        m_blocked = true;
+    }
+    return !m_blocked;
+}
+
+/*! Appends the given \a message to the queue. */
+void SendQueue::enqueue(const Message &message)
+{
+    bool coalescable = message.type == MessageTypeNotification
+            && !message.coalescingKey.isEmpty()
+            && m_configuration.overflowPolicy == OverflowPolicyCoalesce;
+
+    if (coalescable && m_coalescableEntries.contains(message.coalescingKey)) {
+        // Replace the queued notification in place so it keeps its position in the queue
+        int index = indexOf(m_coalescableEntries.value(message.coalescingKey));
+        Entry &entry = m_entries[index];
+        m_queuedBytes += message.data.size() - entry.message.data.size();
+        entry.message = message;
+        m_coalescedNotifications++;
+        return;
+    }
+
+    Entry entry;
+    entry.sequence = m_nextSequence++;
+    entry.message = message;
+    m_entries.append(entry);
+    m_queuedBytes += message.data.size();
+    if (coalescable) {
+        m_coalescableEntries.insert(message.coalescingKey, entry.sequence);
+    }
+
+    // Replies are never dropped, so only queued notifications are removed to make room
+    int index = 0;
+    while (m_queuedBytes > m_configuration.maxQueueSize && index < m_entries.count()) {
+        if (m_entries.at(index).message.type != MessageTypeNotification) {
+            index++;
+            continue;
+        }
+        removeAt(index);
+        m_droppedNotifications++;
+    }
+}
+
+/*! Removes the first message from the queue and returns it. The queue must not be empty. */
+SendQueue::Message SendQueue::takeFirst()
+{
+    Message message = m_entries.first().message;
+    removeAt(0);
+    return message;
+}
+
+/*! Returns true if no messages are queued. */
+bool SendQueue::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+/*! Returns the number of bytes held in the queue. */
+qint64 SendQueue::size() const
+{
+    return m_queuedBytes;
+}
+
+/*! Returns the current queue depth and the number of dropped and coalesced notifications. */
+SendQueue::Statistics SendQueue::statistics() const
+{
+    Statistics statistics;
+    statistics.queuedMessages = m_entries.count();
+    statistics.queuedBytes = m_queuedBytes;
+    statistics.droppedNotifications = m_droppedNotifications;
+    statistics.coalescedNotifications = m_coalescedNotifications;
+    return statistics;
+}
+
+int SendQueue::indexOf(quint64 sequence) const
+{
+    // Entries are ordered by their sequence
+    auto it = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), sequence, [](const Entry &entry, quint64 sequence) {
+        return entry.sequence < sequence;
+    });
+    return static_cast<int>(it - m_entries.constBegin());
+}
+
+void SendQueue::removeAt(int index)
+{
+    const Entry &entry = m_entries.at(index);
+    auto it = m_coalescableEntries.find(entry.message.coalescingKey);
+    if (it != m_coalescableEntries.end() && it.value() == entry.sequence) {
+        m_coalescableEntries.erase(it);
+    }
+    m_queuedBytes -= entry.message.data.size();
+    m_entries.removeAt(index);
+}
+
+}
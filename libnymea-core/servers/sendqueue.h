@@ -0,0 +1,119 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENDQUEUE_H
+#define SENDQUEUE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+
+namespace nymeaserver {
+
+class SendQueue
+{
+public:
+    enum MessageType {
+        MessageTypeReply,
+        MessageTypeNotification
+    };
+
+    enum OverflowPolicy {
+        OverflowPolicyDropOldest,
+        OverflowPolicyCoalesce
+    };
+
+    class Configuration {
+    public:
+        qint64 highWatermark = 256 * 1024;
+        qint64 lowWatermark = 64 * 1024;
+        qint64 maxQueueSize = 1024 * 1024;
+        OverflowPolicy overflowPolicy = OverflowPolicyCoalesce;
+    };
+
+    class Statistics {
+    public:
+        int queuedMessages = 0;
+        qint64 queuedBytes = 0;
+        quint64 droppedNotifications = 0;
+        quint64 coalescedNotifications = 0;
+    };
+
+    class Message {
+    public:
+        QByteArray data;
+        MessageType type = MessageTypeReply;
+        QByteArray coalescingKey;
+        // Message based transports send the message as binary message
+        bool binary = false;
+    };
+
+    explicit SendQueue(const Configuration &configuration = Configuration());
+
+    Configuration configuration() const;
+    void setConfiguration(const Configuration &configuration);
+
+    bool canWrite(qint64 bytesToWrite);
+
+    void enqueue(const Message &message);
+    Message takeFirst();
+
+    bool isEmpty() const;
+    qint64 size() const;
+
+    Statistics statistics() const;
+
+private:
+    class Entry {
+    public:
+        quint64 sequence = 0;
+        Message message;
+    };
+
+    int indexOf(quint64 sequence) const;
+    void removeAt(int index);
+
+    Configuration m_configuration;
+    bool m_blocked = false;
+
+    QList<Entry> m_entries;
+    quint64 m_nextSequence = 0;
+    qint64 m_queuedBytes = 0;
+
+    // Coalescing key => sequence of the queued notification with that key
+    QHash<QByteArray, quint64> m_coalescableEntries;
+
+    quint64 m_droppedNotifications = 0;
+    quint64 m_coalescedNotifications = 0;
+};
+
+}
+
+#endif // SENDQUEUE_H
@@ -77,6 +77,7 @@
 #include "nymeacore.h"
 
 #include <QDebug>
+#include <QtEndian>
 
 namespace nymeaserver {
 
@@ -107,15 +108,28 @@ QUrl TcpServer::serverUrl() const
 /*! Sending \a data to a list of \a clients.*/
 void TcpServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
-    foreach (const QUuid &client, clients) {
-        sendData(client, data);
-    }
+    sendMessage(clients, data, SendQueue::MessageTypeReply, QByteArray());
+}
+
+/*! Sending the notification \a data to a list of \a clients. Notifications queued for clients which
+ *  do not keep up are coalesced by their \a coalescingKey or dropped.
+ *
+ * \sa TransportInterface::sendNotification()
+ */
+void TcpServer::sendNotification(const QList<QUuid> &clients, const QByteArray &data, const QByteArray &coalescingKey)
+{
+    sendMessage(clients, data, SendQueue::MessageTypeNotification, coalescingKey);
 }
 
 void TcpServer::terminateClientConnection(const QUuid &clientId)
 {
     QTcpSocket *client = m_clientList.value(clientId);
     if (client) {
+        // Hand everything still queued to the socket, it is flushed before the connection is closed
+        SendQueue &queue = m_sendQueues[clientId];
+        while (!queue.isEmpty()) {
+            client->write(queue.takeFirst().data);
+        }
         client->close();
     }
 }
@@ -123,21 +137,147 @@ void TcpServer::terminateClientConnection(const QUuid &clientId)
 /*! Sending \a data to the client with the given \a clientId.*/
 void TcpServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
-    QTcpSocket *client = nullptr;
-    client = m_clientList.value(clientId);
-    if (client) {
+    sendMessage(QList<QUuid>() << clientId, data, SendQueue::MessageTypeReply, QByteArray());
+}
+
+/*! Returns true. The TcpServer frames binary messages with a 32 bit big endian length prefix.
+ *
+ * \sa TransportInterface::binaryModeSupported()
+ */
+bool TcpServer::binaryModeSupported() const
+{
+    return true;
+}
+
+/*! Enables or disables length prefixed binary framing for the client with the given \a clientId.
+ *
+ * \sa TransportInterface::setBinaryMode()
+ */
+void TcpServer::setBinaryMode(const QUuid &clientId, bool binaryMode)
+{
+    if (!m_clientList.contains(clientId)) {
+        return;
+    }
+    if (binaryMode) {
+        if (!m_binaryBuffers.contains(clientId)) {
+            m_binaryBuffers.insert(clientId, QByteArray());
+        }
+    } else {
+        m_binaryBuffers.remove(clientId);
+    }
+}
+
+/*! Returns the number of bytes buffered in the socket and the send queue of the client with the given \a clientId.
+ *
+ * \sa TransportInterface::bytesToWrite()
+ */
+qint64 TcpServer::bytesToWrite(const QUuid &clientId) const
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    if (!client) {
+        return 0;
+    }
+    return pendingBytes(client) + m_sendQueues.value(clientId).size();
+}
+
+/*! Returns the send queue statistics of the client with the given \a clientId.
+ *
+ * \sa TransportInterface::sendQueueStatistics()
+ */
+SendQueue::Statistics TcpServer::sendQueueStatistics(const QUuid &clientId) const
+{
+    return m_sendQueues.value(clientId).statistics();
+}
+
+QByteArray TcpServer::frameMessage(const QUuid &clientId, const QByteArray &data) const
+{
+    if (!m_binaryBuffers.contains(clientId)) {
+        return data + '\n';
+    }
+    QByteArray frame(4, 0);
+    qToBigEndian<quint32>(static_cast<quint32>(data.size()), reinterpret_cast<uchar*>(frame.data()));
+    frame.append(data);
+    return frame;
+}
+
+void TcpServer::sendMessage(const QList<QUuid> &clients, const QByteArray &data, SendQueue::MessageType type, const QByteArray &coalescingKey)
+{
+    // Framed copies are only needed for queued messages and are shared by all clients using the same framing
+    QByteArray message;
+    QByteArray binaryMessage;
+    foreach (const QUuid &clientId, clients) {
+        QTcpSocket *client = m_clientList.value(clientId);
+        if (!client) {
+            qCWarning(dcTcpServer()) << "Client" << clientId << "unknown to this transport";
+            continue;
+        }
         qCDebug(dcTcpServerTraffic()) << "Sending to client" << clientId.toString() << data;
-        client->write(data + '\n');
+        SendQueue &queue = m_sendQueues[clientId];
+        if (queue.isEmpty() && queue.canWrite(pendingBytes(client))) {
+            writeMessage(client, clientId, data);
+            continue;
+        }
+
+        // Messages are framed when queued as the client might switch to binary mode before they are written
+        SendQueue::Message queuedMessage;
+        if (m_binaryBuffers.contains(clientId)) {
+            if (binaryMessage.isEmpty()) {
+                binaryMessage = frameMessage(clientId, data);
+            }
+            queuedMessage.data = binaryMessage;
+        } else {
+            if (message.isEmpty()) {
+                message = frameMessage(clientId, data);
+            }
+            queuedMessage.data = message;
+        }
+        queuedMessage.type = type;
+        queuedMessage.coalescingKey = coalescingKey;
+        queue.enqueue(queuedMessage);
+    }
+}
+
+void TcpServer::writeMessage(QTcpSocket *client, const QUuid &clientId, const QByteArray &data)
+{
+    // The socket copies into its write buffer anyways, write the framing separately instead of concatenating
+    if (m_binaryBuffers.contains(clientId)) {
+        char prefix[4];
+        qToBigEndian<quint32>(static_cast<quint32>(data.size()), reinterpret_cast<uchar*>(prefix));
+        client->write(prefix, 4);
+        client->write(data);
     } else {
-        qCWarning(dcTcpServer()) << "Client" << clientId << "unknown to this transport";
+        client->write(data);
+        client->write("\n", 1);
     }
 }
 
+void TcpServer::flushSendQueue(const QUuid &clientId)
+{
+    QTcpSocket *client = m_clientList.value(clientId);
+    QHash<QUuid, SendQueue>::iterator queue = m_sendQueues.find(clientId);
+    if (!client || queue == m_sendQueues.end()) {
+        return;
+    }
+    while (!queue.value().isEmpty() && queue.value().canWrite(pendingBytes(client))) {
+        client->write(queue.value().takeFirst().data);
+    }
+}
+
+qint64 TcpServer::pendingBytes(QTcpSocket *client) const
+{
+    // Encrypted data is buffered separately by SSL sockets
+    QSslSocket *sslSocket = qobject_cast<QSslSocket*>(client);
+    return client->bytesToWrite() + (sslSocket ? sslSocket->encryptedBytesToWrite() : 0);
+}
+
 void TcpServer::onClientConnected(QSslSocket *socket)
 {
     QUuid clientId = QUuid::createUuid();
     qCDebug(dcTcpServer()) << "New client connected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
     m_clientList.insert(clientId, socket);
+    m_sendQueues.insert(clientId, SendQueue(sendQueueConfiguration()));
+    connect(socket, &QSslSocket::bytesWritten, this, [this, clientId](){ flushSendQueue(clientId); });
+    connect(socket, &QSslSocket::encryptedBytesWritten, this, [this, clientId](){ flushSendQueue(clientId); });
     emit clientConnected(clientId);
 }
 
@@ -146,6 +286,8 @@ void TcpServer::onClientDisconnected(QSslSocket *socket)
     QUuid clientId = m_clientList.key(socket);
     qCDebug(dcTcpServer()) << "Client disconnected:" << clientId.toString() << "(Remote address:" << socket->peerAddress().toString() << ")";
     m_clientList.take(clientId);
+    m_binaryBuffers.remove(clientId);
+    m_sendQueues.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -160,7 +302,38 @@ void TcpServer::onDataAvailable(QSslSocket * socket, const QByteArray &data)
 {
     qCDebug(dcTcpServerTraffic()) << "Emitting data available";
     QUuid clientId = m_clientList.key(socket);
-    emit dataAvailable(clientId, data);
+    if (!m_binaryBuffers.contains(clientId)) {
+        emit dataAvailable(clientId, data);
+        return;
+    }
+
+    // Split the stream into length prefixed frames
+    QByteArray buffer = m_binaryBuffers.value(clientId) + data;
+    QList<QByteArray> frames;
+    int offset = 0;
+    while (buffer.size() - offset >= 4) {
+        quint32 frameSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData() + offset));
+        if (frameSize > static_cast<quint32>(m_maxFrameSize)) {
+            qCWarning(dcTcpServer()) << "Client" << clientId.toString() << "announced a frame of" << frameSize << "bytes. Dropping client connection.";
+            m_binaryBuffers[clientId].clear();
+            socket->close();
+            return;
+        }
+        if (buffer.size() - offset - 4 < static_cast<int>(frameSize)) {
+            break;
+        }
+        frames.append(buffer.mid(offset + 4, static_cast<int>(frameSize)));
+        offset += 4 + static_cast<int>(frameSize);
+    }
+    m_binaryBuffers[clientId] = buffer.mid(offset);
+
+    foreach (const QByteArray &frame, frames) {
+        emit dataAvailable(clientId, frame);
+        // The client might have been disconnected while processing the frame
+        if (!m_clientList.contains(clientId)) {
+            return;
+        }
+    }
 }
 
 
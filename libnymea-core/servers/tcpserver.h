@@ -86,15 +86,35 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    void sendNotification(const QList<QUuid> &clients, const QByteArray &data, const QByteArray &coalescingKey = QByteArray()) override;
 
     void terminateClientConnection(const QUuid &clientId) override;
 
+    bool binaryModeSupported() const override;
+    void setBinaryMode(const QUuid &clientId, bool binaryMode) override;
+
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+    SendQueue::Statistics sendQueueStatistics(const QUuid &clientId) const override;
+
 private:
+    QByteArray frameMessage(const QUuid &clientId, const QByteArray &data) const;
+    void sendMessage(const QList<QUuid> &clients, const QByteArray &data, SendQueue::MessageType type, const QByteArray &coalescingKey);
+    void writeMessage(QTcpSocket *client, const QUuid &clientId, const QByteArray &data);
+    void flushSendQueue(const QUuid &clientId);
+    qint64 pendingBytes(QTcpSocket *client) const;
+
     QTimer *m_timer;
 
     SslServer * m_server;
     QHash<QUuid, QTcpSocket *> m_clientList;
 
+    // Incomplete length prefixed frames of clients in binary mode
+    QHash<QUuid, QByteArray> m_binaryBuffers;
+    int m_maxFrameSize = 1024 * 1024;
+
+    // Messages held back while a client's socket buffers more than the high watermark
+    QHash<QUuid, SendQueue> m_sendQueues;
+
     QSslConfiguration m_sslConfig;
 
 private slots:
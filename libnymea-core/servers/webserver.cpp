@@ -150,44 +150,121 @@ void WebServer::sendHttpReply(HttpReply *reply)
     reply->packReply();
     qCDebug(dcWebServerTraffic()) << "Send reply to" << socket->peerAddress().toString() << reply;
     qCDebug(dcWebServer()) << "Respond" << socket->peerAddress().toString() << reply->httpStatusCode() << reply->httpReasonPhrase();
-    socket->write(reply->data());
+
+    QIODevice *payloadDevice = reply->takePayloadDevice();
+    if (!payloadDevice && !m_payloadStreams.contains(socket)) {
+        socket->write(reply->rawHeader());
+        socket->write(reply->payload());
+        if (reply->closeConnection()) {
+            // Pending data will be written before the connection gets closed
+            socket->disconnectFromHost();
+        }
+        return;
+    }
+
+    // Either this reply has to be streamed or an other reply is still being streamed to this socket
+    PayloadStream stream;
+    stream.header = reply->rawHeader();
+    stream.closeConnection = reply->closeConnection();
+    if (payloadDevice) {
+        stream.device = payloadDevice;
+        stream.remaining = reply->payloadSize();
+    } else {
+        QBuffer *buffer = new QBuffer();
+        buffer->setData(reply->payload());
+        buffer->open(QBuffer::ReadOnly);
+        stream.device = buffer;
+        stream.remaining = buffer->size();
+    }
+    // The device gets deleted along with the socket if the client disconnects while streaming
+    stream.device->setParent(socket);
+    connect(stream.device, &QIODevice::readyRead, socket, [this, socket](){ writePayloadStreams(socket); });
+    connect(stream.device, &QIODevice::readChannelFinished, socket, [this, socket](){ writePayloadStreams(socket); });
+    m_payloadStreams[socket].append(stream);
+    writePayloadStreams(socket);
 }
 
-bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
+void WebServer::writePayloadStreams(QSslSocket *socket)
+{
+    // Keep at most one piece queued in the socket so the memory usage stays flat for large payloads
+    static const qint64 pieceSize = 64 * 1024;
+
+    while (m_payloadStreams.contains(socket) && socket->bytesToWrite() < pieceSize) {
+        PayloadStream &stream = m_payloadStreams[socket].first();
+        if (!stream.header.isEmpty()) {
+            socket->write(stream.header);
+            stream.header.clear();
+        }
+
+        bool chunked = stream.remaining < 0;
+        QByteArray data = stream.device->read(chunked ? pieceSize : qMin(pieceSize, stream.remaining));
+        if (!data.isEmpty()) {
+            if (chunked) {
+                socket->write(QByteArray::number(data.size(), 16) + "\r\n");
+                socket->write(data);
+                socket->write("\r\n");
+            } else {
+                socket->write(data);
+                stream.remaining -= data.size();
+            }
+        }
+
+        bool finished = chunked ? stream.device->atEnd() : stream.remaining == 0;
+        if (!finished) {
+            if (!data.isEmpty()) {
+                continue;
+            }
+            if (!stream.device->atEnd()) {
+                // Sequential device without data yet, wait for readyRead()
+                return;
+            }
+            // The device ended before the announced Content-Length, the reply can't be completed
+            qCWarning(dcWebServer()) << "Payload device ended" << stream.remaining << "bytes early. Closing connection to" << socket->peerAddress().toString();
+            m_payloadStreams.remove(socket);
+            socket->abort();
+            return;
+        }
+
+        if (chunked) {
+            socket->write("0\r\n\r\n");
+        }
+        if (stream.closeConnection) {
+            m_payloadStreams.remove(socket);
+            socket->disconnectFromHost();
+            return;
+        }
+        stream.device->deleteLater();
+        m_payloadStreams[socket].removeFirst();
+        if (m_payloadStreams.value(socket).isEmpty()) {
+            m_payloadStreams.remove(socket);
+        }
+    }
+}
+
+HttpReply *WebServer::verifyFile(const QString &fileName)
 {
     QFileInfo file(fileName);
 
     // make sure the file exists
     if (!file.exists()) {
         qCWarning(dcWebServer()) << "requested file" << file.filePath() << "does not exist.";
-        HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
-        reply->setClientId(m_clientList.key(socket));
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return false;
+        return HttpReply::createErrorReply(HttpReply::NotFound);
     }
 
     // make sure the file is in the public directory
     if (!file.canonicalFilePath().startsWith(QDir(m_configuration.publicFolder).canonicalPath())) {
         qCWarning(dcWebServer()) << "Requested file" << file.fileName() << "is outside the public folder.";
-        HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
-        reply->setClientId(m_clientList.key(socket));
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return false;
+        return HttpReply::createErrorReply(HttpReply::Forbidden);
     }
 
     // make sure we can read the file
     if (!file.isReadable()) {
         qCWarning(dcWebServer()) << "Requested file" << file.fileName() << "is not readable.";
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::Forbidden);
-        reply->setClientId(m_clientList.key(socket));
         reply->setPayload("403 Forbidden. File not readable");
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return false;
+        return reply;
     }
-    return true;
+    return nullptr;
 }
 
 QString WebServer::fileName(const QString &query)
@@ -224,6 +301,46 @@ HttpReply *WebServer::processIconRequest(const QString &fileName)
     return HttpReply::createErrorReply(HttpReply::NotFound);
 }
 
+HttpReply *WebServer::processFileRequest(const HttpRequest &request, const WebServerAssetCache::Asset &asset)
+{
+    QByteArray encoding = asset.preferredEncoding(request.headerValue("Accept-Encoding"));
+    QByteArray ifNoneMatch = request.headerValue("If-None-Match");
+
+    HttpReply *reply = nullptr;
+    if (!ifNoneMatch.isEmpty() && asset.matches(ifNoneMatch, encoding)) {
+        reply = new HttpReply(HttpReply::NotModified, HttpReply::TypeSync);
+    } else if (asset.isBuffered()) {
+        reply = HttpReply::createSuccessReply();
+        if (!asset.contentType.isEmpty()) {
+            reply->setHeader(HttpReply::ContentTypeHeader, asset.contentType);
+        }
+        if (encoding != "identity") {
+            reply->setRawHeader("Content-Encoding", encoding);
+        }
+        reply->setPayload(asset.encodings.value(encoding));
+    } else {
+        // Too large for the cache, stream it from disk
+        QFile *file = new QFile(asset.fileName);
+        if (!file->open(QFile::ReadOnly)) {
+            qCWarning(dcWebServer()) << "Could not open file" << asset.fileName << file->errorString();
+            delete file;
+            return HttpReply::createErrorReply(HttpReply::Forbidden);
+        }
+        reply = HttpReply::createSuccessReply();
+        if (!asset.contentType.isEmpty()) {
+            reply->setHeader(HttpReply::ContentTypeHeader, asset.contentType);
+        }
+        reply->setPayloadDevice(file, asset.size);
+    }
+
+    reply->setRawHeader("ETag", asset.etagForEncoding(encoding));
+    reply->setRawHeader("Last-Modified", asset.lastModified);
+    if (asset.encodings.count() > 1) {
+        reply->setRawHeader("Vary", "Accept-Encoding");
+    }
+    return reply;
+}
+
 void WebServer::incomingConnection(qintptr socketDescriptor)
 {
     if (!m_enabled)
@@ -238,30 +355,24 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     }
 
     // check webserver client
-    bool existing = false;
-    foreach (WebServerClient *client, m_webServerClients) {
-        if (client->address() == socket->peerAddress()) {
-            if (client->connections().count() >= 50) {
-                qCWarning(dcWebServer()).noquote() << QString("Maximum connections for this client reached: rejecting connection from client %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
-                socket->close();
-                delete socket;
-                return;
-            }
-            client->addConnection(socket);
-            existing = true;
-            break;
+    WebServerClient *webServerClient = m_webServerClients.value(socket->peerAddress());
+    if (webServerClient) {
+        if (webServerClient->connectionCount() >= 50) {
+            qCWarning(dcWebServer()).noquote() << QString("Maximum connections for this client reached: rejecting connection from client %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+            socket->close();
+            delete socket;
+            return;
         }
+    } else {
+        webServerClient = new WebServerClient(socket->peerAddress());
+        m_webServerClients.insert(socket->peerAddress(), webServerClient);
     }
-
-    if (!existing) {
-        WebServerClient *webServerClient = new WebServerClient(socket->peerAddress());
-        webServerClient->addConnection(socket);
-        m_webServerClients.append(webServerClient);
-    }
+    webServerClient->addConnection(socket);
 
     // append the new client to the client list
     QUuid clientId = QUuid::createUuid();
     m_clientList.insert(clientId, socket);
+    m_clientIds.insert(socket, clientId);
 
     qCDebug(dcWebServer()).noquote() << QString("Webserver client %1:%2 connected").arg(socket->peerAddress().toString()).arg(socket->peerPort());
 
@@ -276,6 +387,7 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
 
     connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
     connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
 
     emit clientConnected(clientId);
@@ -287,7 +399,7 @@ void WebServer::readClient()
         return;
 
     QSslSocket *socket = qobject_cast<QSslSocket *>(sender());
-    QUuid clientId = m_clientList.key(socket);
+    QUuid clientId = m_clientIds.value(socket);
 
     // Check client
     if (clientId.isNull()) {
@@ -299,70 +411,105 @@ void WebServer::readClient()
     // Read HTTP request
     QByteArray data = socket->readAll();
 
+    // The connection is closing after a "Connection: close" request, further requests are ignored
+    if (socket->state() != QAbstractSocket::ConnectedState)
+        return;
+
+    // Reset timout
+    WebServerClient *webServerClient = m_webServerClients.value(socket->peerAddress());
+    if (webServerClient)
+        webServerClient->resetTimout(socket);
+
+    processClientData(socket, data);
+}
+
+void WebServer::processClientData(QSslSocket *socket, const QByteArray &data)
+{
+    // Requests after one with a pending async reply have to wait for it
+    if (m_pendingReplies.contains(socket)) {
+        m_pausedData[socket].append(data);
+        return;
+    }
+
+    QUuid clientId = m_clientIds.value(socket);
+
     HttpRequest request;
-    if (m_incompleteRequests.contains(socket)) {
+    QHash<QSslSocket *, HttpRequest>::iterator incompleteRequest = m_incompleteRequests.find(socket);
+    if (incompleteRequest != m_incompleteRequests.end()) {
         qCDebug(dcWebServer()) << "Append data to incomlete request";
+        incompleteRequest->appendData(data);
+        if (!incompleteRequest->isComplete())
+            return;
+
         request = m_incompleteRequests.take(socket);
-        request.appendData(data);
     } else {
         request = HttpRequest(data);
     }
 
-    // Check if the request is complete
-    if (!request.isComplete()) {
-        m_incompleteRequests.insert(socket, request);
-        return;
-    }
+    // Process all complete requests in the received data. Clients may pipeline requests.
+    while (true) {
+        // Check if the request is complete
+        if (!request.isComplete()) {
+            m_incompleteRequests.insert(socket, request);
+            return;
+        }
 
-    qCDebug(dcWebServerTraffic()) << "Received request from" << clientId.toString() << socket->peerAddress().toString() << request;
+        qCDebug(dcWebServerTraffic()) << "Received request from" << clientId.toString() << socket->peerAddress().toString() << request;
 
-    // Check if the request is valid
-    if (!request.isValid()) {
-        qCWarning(dcWebServer()) << "Got invalid request:" << request.url().path();
-        HttpReply *reply = HttpReply::createErrorReply(HttpReply::BadRequest);
+        HttpReply *reply = processRequest(socket, request);
         reply->setClientId(clientId);
+
+        // Invalid requests can't be parsed any further, so the connection has to be closed as well
+        bool keepAlive = request.isValid() && request.keepAlive();
+        reply->setCloseConnection(!keepAlive);
+
+        // Handle async replies, the remaining requests are processed once it is sent
+        if (reply->type() == HttpReply::TypeAsync) {
+            connect(reply, &HttpReply::finished, this, &WebServer::onAsyncReplyFinished);
+            m_pendingReplies.insert(socket, reply);
+            if (keepAlive && request.hasPipelinedData())
+                m_pausedData.insert(socket, request.pipelinedData());
+
+            reply->startWait();
+            return;
+        }
+
         sendHttpReply(reply);
         reply->deleteLater();
-        return;
+
+        if (!keepAlive || !request.hasPipelinedData())
+            return;
+
+        request = request.nextPipelinedRequest();
+    }
+}
+
+HttpReply *WebServer::processRequest(QSslSocket *socket, const HttpRequest &request)
+{
+    // Check if the request is valid
+    if (!request.isValid()) {
+        qCWarning(dcWebServer()) << "Got invalid request:" << request.url().path();
+        return HttpReply::createErrorReply(HttpReply::BadRequest);
     }
 
     // Check HTTP version
     if (request.httpVersion() != "HTTP/1.1" && request.httpVersion() != "HTTP/1.0") {
         qCWarning(dcWebServer()) << "HTTP version is not supported." << request.httpVersion();
-        HttpReply *reply = HttpReply::createErrorReply(HttpReply::HttpVersionNotSupported);
-        reply->setClientId(clientId);
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return;
+        return HttpReply::createErrorReply(HttpReply::HttpVersionNotSupported);
     }
 
     qCDebug(dcWebServer()).noquote() << QString("Got valid request from %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()) << request.methodString() << request.url().path() << request.urlQuery().toString();
 
-    // Reset timout
-    foreach (WebServerClient *webserverClient, m_webServerClients) {
-        if (webserverClient->address() == socket->peerAddress()) {
-            webserverClient->resetTimout(socket);
-            break;
-        }
-    }
-
     // Verify method
     if (request.method() == HttpRequest::Unhandled) {
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::MethodNotAllowed);
-        reply->setClientId(clientId);
         reply->setHeader(HttpReply::AllowHeader, "GET, PUT, POST, DELETE, OPTIONS");
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return;
+        return reply;
     }
 
     // Check icon call
     if (request.url().path().startsWith("/icons/") && request.method() == HttpRequest::Get) {
-        HttpReply *reply = processIconRequest(request.url().path());
-        reply->setClientId(clientId);
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return;
+        return processIconRequest(request.url().path());
     }
 
     // Check if this is a debug call
@@ -372,33 +519,15 @@ void WebServer::readClient()
             // Verify methods
             if (request.method() != HttpRequest::Get && request.method() != HttpRequest::Options) {
                 HttpReply *reply = HttpReply::createErrorReply(HttpReply::MethodNotAllowed);
-                reply->setClientId(clientId);
                 reply->setHeader(HttpReply::AllowHeader, "GET, OPTIONS");
-                sendHttpReply(reply);
-                reply->deleteLater();
-                return;
+                return reply;
             }
 
             qCDebug(dcDebugServer()) << "Request:" << request.url().toString();
-            HttpReply *reply = NymeaCore::instance()->debugServerHandler()->processDebugRequest(request.url().path(), request.urlQuery());
-            reply->setClientId(clientId);
-
-            // Handle async replies
-            if (reply->type() == HttpReply::TypeAsync) {
-                connect(reply, &HttpReply::finished, this, &WebServer::onAsyncReplyFinished);
-                reply->startWait();
-            } else {
-                sendHttpReply(reply);
-                reply->deleteLater();
-            }
-            return;
+            return NymeaCore::instance()->debugServerHandler()->processDebugRequest(request.url().path(), request.urlQuery());
         } else {
             qCWarning(dcWebServer()) << "The debug server handler is disabled. You can enable it by adding \'debugServerEnabled=true\' in the \'nymead\' section of the nymead.conf file.";
-            HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
-            reply->setClientId(clientId);
-            sendHttpReply(reply);
-            reply->deleteLater();
-            return;
+            return HttpReply::createErrorReply(HttpReply::NotFound);
         }
     }
 
@@ -408,74 +537,35 @@ void WebServer::readClient()
         HttpReply *reply = HttpReply::createSuccessReply();
         reply->setHeader(HttpReply::ContentTypeHeader, "text/xml");
         reply->setPayload(createServerXmlDocument(socket->localAddress()));
-        reply->setClientId(clientId);
-        sendHttpReply(reply);
-        reply->deleteLater();
-        return;
+        return reply;
     }
 
 
     // Request for a file...
     if (request.method() == HttpRequest::Get) {
-        // Check if the webinterface dir does exist, otherwise a filerequest is not relevant
+        QString path = fileName(request.url().path());
+
+        // Check if the webinterface dir does exist, otherwise a filerequest is not relevant. No need
+        // to check that again for files which are cached already.
         // FIXME: return a default webpage containing server information
-        if (!QDir(m_configuration.publicFolder).exists()) {
+        if (!m_assetCache.contains(path) && !QDir(m_configuration.publicFolder).exists()) {
             qCWarning(dcWebServer()) << "Webinterface folder" << m_configuration.publicFolder << "does not exist.";
-            HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
-            reply->setClientId(clientId);
-            sendHttpReply(reply);
-            reply->deleteLater();
-            return;
+            return HttpReply::createErrorReply(HttpReply::NotFound);
         }
 
-        QString path = fileName(request.url().path());
-        if (!verifyFile(socket, path))
-            return;
-
-        QFile file(path);
-        if (file.open(QFile::ReadOnly | QFile::Truncate)) {
-            qCDebug(dcWebServer()) << "Load file" << file.fileName();
-            HttpReply *reply = HttpReply::createSuccessReply();
-
-            // Check content type
-            if (file.fileName().endsWith(".html")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/html; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".css")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/css; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".pdf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/pdf");
-            } else if (file.fileName().endsWith(".js")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/javascript; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".ttf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-ttf");
-            } else if (file.fileName().endsWith(".eot")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/vnd.ms-fontobject");
-            } else if (file.fileName().endsWith(".woff")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-woff");
-            } else if (file.fileName().endsWith(".jpg") || file.fileName().endsWith(".jpeg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/jpeg");
-            } else if (file.fileName().endsWith(".png") || file.fileName().endsWith(".PNG")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/png");
-            } else if (file.fileName().endsWith(".ico")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/x-icon");
-            } else if (file.fileName().endsWith(".svg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/svg+xml; charset=\"utf-8\";");
-            }
+        HttpReply *errorReply = verifyFile(path);
+        if (errorReply)
+            return errorReply;
 
-            reply->setPayload(file.readAll());
-            reply->setClientId(clientId);
-            sendHttpReply(reply);
-            reply->deleteLater();
-            return;
+        WebServerAssetCache::Asset asset = m_assetCache.asset(path);
+        if (asset.isValid()) {
+            return processFileRequest(request, asset);
         }
     }
 
     // Reject everything else...
     qCWarning(dcWebServer()) << "Unknown message received.";
-    HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotImplemented);
-    reply->setClientId(clientId);
-    sendHttpReply(reply);
-    reply->deleteLater();
+    return HttpReply::createErrorReply(HttpReply::NotImplemented);
 }
 
 void WebServer::onDisconnected()
@@ -483,38 +573,53 @@ void WebServer::onDisconnected()
     QSslSocket* socket = static_cast<QSslSocket *>(sender());
 
     // Remove connection from server client
-    foreach (WebServerClient *client, m_webServerClients) {
-        if (client->address() == socket->peerAddress()) {
-            client->removeConnection(socket);
-            if (client->connections().isEmpty()) {
-                qCDebug(dcWebServer()) << "Delete client" << client->address().toString();
-                m_webServerClients.removeAll(client);
-                client->deleteLater();
-            }
-            break;
+    WebServerClient *client = m_webServerClients.value(socket->peerAddress());
+    if (client) {
+        client->removeConnection(socket);
+        if (client->connectionCount() == 0) {
+            qCDebug(dcWebServer()) << "Delete client" << client->address().toString();
+            m_webServerClients.remove(client->address());
+            client->deleteLater();
         }
     }
 
     qCDebug(dcWebServer()).noquote() << QString("Webserver client disonnected %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
 
     // clean up
-    QUuid clientId = m_clientList.key(socket);
+    QUuid clientId = m_clientIds.take(socket);
     m_clientList.remove(clientId);
     m_incompleteRequests.remove(socket);
+    m_pendingReplies.remove(socket);
+    m_pausedData.remove(socket);
+    m_payloadStreams.remove(socket);
     emit clientDisconnected(clientId);
 
     socket->deleteLater();
 }
 
+void WebServer::onBytesWritten()
+{
+    QSslSocket* socket = static_cast<QSslSocket *>(sender());
+    if (m_payloadStreams.contains(socket)) {
+        // Don't let long downloads run into the idle timeout
+        WebServerClient *webServerClient = m_webServerClients.value(socket->peerAddress());
+        if (webServerClient)
+            webServerClient->resetTimout(socket);
+
+        writePayloadStreams(socket);
+    }
+}
+
 void WebServer::onEncrypted()
 {
     QSslSocket* socket = static_cast<QSslSocket *>(sender());
     qCDebug(dcWebServer()).noquote() << QString("Encrypted connection %1:%2 successfully established.").arg(socket->peerAddress().toString()).arg(socket->peerPort());
     connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
     connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
 
-    emit clientConnected(m_clientList.key(socket));
+    emit clientConnected(m_clientIds.value(socket));
 }
 
 void WebServer::onError(QAbstractSocket::SocketError error)
@@ -537,12 +642,24 @@ void WebServer::onAsyncReplyFinished()
 
     // check if the reply timeouted
     if (reply->timedOut()) {
+        bool closeConnection = reply->closeConnection();
         reply->clear();
         reply->setHttpStatusCode(HttpReply::GatewayTimeout);
+        reply->setCloseConnection(closeConnection);
     }
 
     sendHttpReply(reply);
     reply->deleteLater();
+
+    // Continue with the requests received while waiting for this reply
+    QSslSocket *socket = m_clientList.value(reply->clientId());
+    if (!socket || m_pendingReplies.value(socket) != reply)
+        return;
+
+    m_pendingReplies.remove(socket);
+    QByteArray data = m_pausedData.take(socket);
+    if (!data.isEmpty() && !reply->closeConnection() && socket->state() == QAbstractSocket::ConnectedState)
+        processClientData(socket, data);
 }
 
 /*! Set the configuration of this \l{WebServer} to the given \a config.
@@ -561,6 +678,7 @@ void WebServer::reconfigureServer(const WebServerConfiguration &config)
 
     stopServer();
     m_configuration = config;
+    m_assetCache.clear();
     startServer();
 }
 
@@ -788,7 +906,13 @@ QHostAddress WebServerClient::address() const
 /*! Returns the list of connections (sockets) of this \l{WebServerClient}. */
 QList<QSslSocket *> WebServerClient::connections()
 {
-    return m_connections;
+    return m_connections.keys();
+}
+
+/*! Returns the number of connections of this \l{WebServerClient}. */
+int WebServerClient::connectionCount() const
+{
+    return m_connections.count();
 }
 
 /*! Adds a new connection (\a socket) to this \l{WebServerClient}. A \l{WebServerClient}
@@ -800,10 +924,9 @@ void WebServerClient::addConnection(QSslSocket *socket)
     QTimer *timer = new QTimer(this);
     timer->setSingleShot(true);
     timer->setInterval(65000);
-    connect(timer, &QTimer::timeout, this, &WebServerClient::onTimout);
+    connect(timer, &QTimer::timeout, this, [this, socket](){ onTimout(socket); });
 
-    m_runningConnections.insert(timer, socket);
-    m_connections.append(socket);
+    m_connections.insert(socket, timer);
 
     timer->start();
 }
@@ -811,28 +934,26 @@ void WebServerClient::addConnection(QSslSocket *socket)
 /*! Removes a connection the given \a socket from the connection list of this \l{WebServerClient}. */
 void WebServerClient::removeConnection(QSslSocket *socket)
 {
-    QTimer *timer = m_runningConnections.key(socket);
-    m_runningConnections.remove(timer);
-    m_connections.removeAll(socket);
-
-    delete timer;
+    // This might be called from the timeout of the timer itself
+    QTimer *timer = m_connections.take(socket);
+    if (timer) {
+        timer->stop();
+        timer->deleteLater();
+    }
 }
 
-/*! Resets the connection timeout for the given \a socket. If the socket will not be used for 12 seconds the
+/*! Resets the connection timeout for the given \a socket. If the socket will not be used for 65 seconds the
  *  connection will be closed.
  */
 void WebServerClient::resetTimout(QSslSocket *socket)
 {
-    QTimer *timer = nullptr;
-    timer = m_runningConnections.key(socket);
+    QTimer *timer = m_connections.value(socket);
     if (timer)
         timer->start();
 }
 
-void WebServerClient::onTimout()
+void WebServerClient::onTimout(QSslSocket *socket)
 {
-    QTimer *timer =  static_cast<QTimer *>(sender());
-    QSslSocket *socket = m_runningConnections.value(timer);
     qCDebug(dcWebServer()).noquote() << QString("Client connection timout %1:%2 -> closing connection").arg(socket->peerAddress().toString()).arg(socket->peerPort());
     removeConnection(socket);
     socket->close();
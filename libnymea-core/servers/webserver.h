@@ -32,6 +32,7 @@
 #define WEBSERVER_H
 
 #include <QObject>
+#include <QHostAddress>
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QHash>
@@ -45,6 +46,7 @@
 #include <QSslKey>
 
 #include "nymeaconfiguration.h"
+#include "webserverassetcache.h"
 
 // Note: Hypertext Transfer Protocol (HTTP/1.1) from the Internet Engineering Task Force (IETF):
 //       https://tools.ietf.org/html/rfc7231
@@ -63,6 +65,7 @@ public:
     QHostAddress address() const;
 
     QList<QSslSocket *> connections();
+    int connectionCount() const;
     void addConnection(QSslSocket *socket);
     void removeConnection(QSslSocket *socket);
 
@@ -70,11 +73,11 @@ public:
 
 private:
     QHostAddress m_address;
-    QList<QSslSocket *> m_connections;
-    QHash<QTimer *, QSslSocket *> m_runningConnections;
+    // Idle timer for each connection
+    QHash<QSslSocket *, QTimer *> m_connections;
 
 private slots:
-    void onTimout();
+    void onTimout(QSslSocket *socket);
 };
 
 
@@ -91,21 +94,45 @@ public:
 
 private:
     QHash<QUuid, QSslSocket *> m_clientList;
-    QList<WebServerClient *> m_webServerClients;
+    QHash<QSslSocket *, QUuid> m_clientIds;
+    QHash<QHostAddress, WebServerClient *> m_webServerClients;
     QHash<QSslSocket *, HttpRequest> m_incompleteRequests;
 
+    // While an async reply is pending for a socket, pipelined requests are not processed
+    // so the replies go out in request order. Data received meanwhile is kept until then.
+    QHash<QSslSocket *, HttpReply *> m_pendingReplies;
+    QHash<QSslSocket *, QByteArray> m_pausedData;
+
     QString m_serverName;
     WebServerConfiguration m_configuration;
     QSslConfiguration m_sslConfiguration;
 
     bool m_enabled = false;
 
-    bool verifyFile(QSslSocket *socket, const QString &fileName);
+    WebServerAssetCache m_assetCache;
+
+    // Payloads from devices are written piecewise, whenever the socket has sent most of the
+    // previous piece. Replies sent meanwhile are queued behind them. A remaining size of -1
+    // means the payload is sent with chunked transfer encoding.
+    struct PayloadStream {
+        QByteArray header;
+        QIODevice *device = nullptr;
+        qint64 remaining = -1;
+        bool closeConnection = false;
+    };
+    QHash<QSslSocket *, QList<PayloadStream>> m_payloadStreams;
+
+    void writePayloadStreams(QSslSocket *socket);
+    void processClientData(QSslSocket *socket, const QByteArray &data);
+
+    HttpReply *verifyFile(const QString &fileName);
     QString fileName(const QString &query);
 
     QByteArray createServerXmlDocument(QHostAddress address);
+    HttpReply *processRequest(QSslSocket *socket, const HttpRequest &request);
     HttpReply *processIconRequest(const QString &fileName);
     HttpReply *processDebugRequest(const QString &requestPath);
+    HttpReply *processFileRequest(const HttpRequest &request, const WebServerAssetCache::Asset &asset);
 
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
@@ -118,6 +145,7 @@ signals:
 private slots:
     void readClient();
     void onDisconnected();
+    void onBytesWritten();
     void onEncrypted();
     void onError(QAbstractSocket::SocketError error);
     void onAsyncReplyFinished();
@@ -0,0 +1,262 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::WebServerAssetCache
+    \brief This class caches the files served by the \l{WebServer}.
+
+    \ingroup server
+    \inmodule core
+
+    Files are kept in memory in a least recently used cache, bounded by the total size of the
+    cached data. Each file gets an ETag and a Last-Modified value based on its modification
+    time and size. Whenever a cached file is requested, the modification time and size of the
+    file and its precompressed variants are checked, and the file is read again if any of them
+    has changed on disk.
+
+    If precompressed variants of a file exist next to it (i.e. \tt index.html.gz or
+    \tt index.html.br), they are cached along with it and can be sent to clients which
+    accept the encoding.
+
+    Files which are larger than the whole cache are not read at all. Only their metadata is
+    returned, so the \l{WebServer} can stream them from disk.
+
+    \sa WebServer
+*/
+
+#include "webserverassetcache.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+
+namespace nymeaserver {
+
+static const QList<QPair<QByteArray, QString>> precompressedVariants = {
+    {"br", ".br"},
+    {"gzip", ".gz"}
+};
+
+static QByteArray fileStamp(const QFileInfo &fileInfo)
+{
+    return QByteArray::number(fileInfo.size(), 16) + '-' + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch(), 16);
+}
+
+/*! Returns true if this asset represents a readable file. */
+bool WebServerAssetCache::Asset::isValid() const
+{
+    return !fileName.isEmpty();
+}
+
+/*! Returns true if the data of this asset is held in memory. If not, the file needs to be read from disk. */
+bool WebServerAssetCache::Asset::isBuffered() const
+{
+    return encodings.contains("identity");
+}
+
+/*! Returns the best encoding of this asset for the given \a acceptEncoding header value. */
+QByteArray WebServerAssetCache::Asset::preferredEncoding(const QByteArray &acceptEncoding) const
+{
+    QList<QByteArray> accepted;
+    foreach (const QByteArray &entry, acceptEncoding.split(',')) {
+        QList<QByteArray> tokens = entry.split(';');
+        // Skip encodings the client explicitly refuses with "q=0"
+        if (tokens.count() > 1 && tokens.at(1).trimmed().startsWith("q=") && tokens.at(1).trimmed().mid(2).toDouble() == 0.0) {
+            continue;
+        }
+        accepted.append(tokens.first().trimmed());
+    }
+
+    for (int i = 0; i < precompressedVariants.count(); i++) {
+        const QByteArray &encoding = precompressedVariants.at(i).first;
+        if (encodings.contains(encoding) && accepted.contains(encoding)) {
+            return encoding;
+        }
+    }
+    return "identity";
+}
+
+/*! Returns the ETag of this asset in the given \a encoding. */
+QByteArray WebServerAssetCache::Asset::etagForEncoding(const QByteArray &encoding) const
+{
+    if (encoding == "identity") {
+        return '"' + etag + '"';
+    }
+    // The variant may be replaced on its own, so its ETag depends on its own file
+    return '"' + m_variantStamps.value(encoding, etag) + '-' + encoding + '"';
+}
+
+/*! Returns true if the given \a ifNoneMatch header value matches this asset in the given \a encoding. */
+bool WebServerAssetCache::Asset::matches(const QByteArray &ifNoneMatch, const QByteArray &encoding) const
+{
+    QByteArray currentETag = etagForEncoding(encoding);
+    foreach (QByteArray entry, ifNoneMatch.split(',')) {
+        entry = entry.trimmed();
+        // Weak comparison is enough for GET requests
+        if (entry.startsWith("W/")) {
+            entry.remove(0, 2);
+        }
+        if (entry == "*" || entry == currentETag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! Constructs a \l{WebServerAssetCache} holding up to \a maxSize bytes. */
+WebServerAssetCache::WebServerAssetCache(int maxSize):
+    m_assets(maxSize)
+{
+
+}
+
+/*! Returns true if the file with the given \a fileName is in the cache. */
+bool WebServerAssetCache::contains(const QString &fileName) const
+{
+    return m_assets.contains(fileName);
+}
+
+/*! Returns the asset for the given \a fileName. It is taken from the cache if the file has not
+    been modified since it was cached, otherwise it is read from disk. If the file can't be read,
+    the returned asset is invalid.
+*/
+WebServerAssetCache::Asset WebServerAssetCache::asset(const QString &fileName)
+{
+    QFileInfo fileInfo(fileName);
+    if (!fileInfo.isFile()) {
+        m_assets.remove(fileName);
+        return Asset();
+    }
+
+    // Precompressed variants are only used if they live next to the file and are not outdated
+    QHash<QByteArray, QByteArray> variantStamps;
+    for (int i = 0; i < precompressedVariants.count(); i++) {
+        QFileInfo variantInfo(fileName + precompressedVariants.at(i).second);
+        if (!variantInfo.isFile() || variantInfo.canonicalPath() != fileInfo.canonicalPath() || variantInfo.lastModified() < fileInfo.lastModified()) {
+            continue;
+        }
+        variantStamps.insert(precompressedVariants.at(i).first, fileStamp(variantInfo));
+    }
+
+    Asset *cachedAsset = m_assets.object(fileName);
+    if (cachedAsset && cachedAsset->m_modified == fileInfo.lastModified() && cachedAsset->size == fileInfo.size() && cachedAsset->m_variantStamps == variantStamps) {
+        return *cachedAsset;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(dcWebServer()) << "Could not open file" << fileName << file.errorString();
+        m_assets.remove(fileName);
+        return Asset();
+    }
+
+    Asset asset;
+    asset.fileName = fileName;
+    asset.m_modified = fileInfo.lastModified();
+    asset.size = fileInfo.size();
+    asset.contentType = contentType(fileName);
+    asset.etag = fileStamp(fileInfo);
+    asset.lastModified = QLocale::c().toString(asset.m_modified.toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toUtf8();
+
+    // Files larger than the whole cache are streamed from disk without reading them here
+    if (asset.size > m_assets.maxCost()) {
+        qCDebug(dcWebServer()) << "File" << file.fileName() << "exceeds the cache size. It will be streamed.";
+        m_assets.remove(fileName);
+        return asset;
+    }
+
+    qCDebug(dcWebServer()) << "Load file" << file.fileName();
+    asset.encodings.insert("identity", file.readAll());
+
+    asset.m_variantStamps = variantStamps;
+
+    int cost = asset.encodings.value("identity").size();
+    for (int i = 0; i < precompressedVariants.count(); i++) {
+        const QByteArray &encoding = precompressedVariants.at(i).first;
+        if (!variantStamps.contains(encoding)) {
+            continue;
+        }
+        QFile variantFile(fileName + precompressedVariants.at(i).second);
+        if (variantFile.open(QFile::ReadOnly)) {
+            QByteArray data = variantFile.readAll();
+            cost += data.size();
+            asset.encodings.insert(encoding, data);
+        }
+    }
+
+    // Precompressed variants may still push the asset over the cache size
+    if (cost <= m_assets.maxCost()) {
+        m_assets.insert(fileName, new Asset(asset), cost);
+    } else {
+        m_assets.remove(fileName);
+    }
+    return asset;
+}
+
+/*! Returns the maximum number of bytes held in this cache. */
+int WebServerAssetCache::maxSize() const
+{
+    return m_assets.maxCost();
+}
+
+/*! Sets the maximum number of bytes held in this cache to \a maxSize. */
+void WebServerAssetCache::setMaxSize(int maxSize)
+{
+    m_assets.setMaxCost(maxSize);
+}
+
+/*! Removes all files from this cache. */
+void WebServerAssetCache::clear()
+{
+    m_assets.clear();
+}
+
+/*! Returns the content type for the file with the given \a fileName, or an empty value if unknown. */
+QByteArray WebServerAssetCache::contentType(const QString &fileName)
+{
+    static const QHash<QString, QByteArray> contentTypes = {
+        {"html", "text/html; charset=\"utf-8\";"},
+        {"css", "text/css; charset=\"utf-8\";"},
+        {"pdf", "application/pdf"},
+        {"js", "text/javascript; charset=\"utf-8\";"},
+        {"ttf", "application/x-font-ttf"},
+        {"eot", "application/vnd.ms-fontobject"},
+        {"woff", "application/x-font-woff"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"png", "image/png"},
+        {"ico", "image/x-icon"},
+        {"svg", "image/svg+xml; charset=\"utf-8\";"}
+    };
+    return contentTypes.value(QFileInfo(fileName).suffix().toLower());
+}
+
+}
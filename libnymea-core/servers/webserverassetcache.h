@@ -0,0 +1,86 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef WEBSERVERASSETCACHE_H
+#define WEBSERVERASSETCACHE_H
+
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+
+namespace nymeaserver {
+
+class WebServerAssetCache
+{
+public:
+    class Asset
+    {
+    public:
+        bool isValid() const;
+        bool isBuffered() const;
+
+        QString fileName;
+        qint64 size = 0;
+        QByteArray contentType;
+        QByteArray etag;
+        QByteArray lastModified;
+        // Content-Encoding -> data. "identity" is the file itself, "gzip" and "br" are precompressed variants
+        QHash<QByteArray, QByteArray> encodings;
+
+        QByteArray preferredEncoding(const QByteArray &acceptEncoding) const;
+        QByteArray etagForEncoding(const QByteArray &encoding) const;
+        bool matches(const QByteArray &ifNoneMatch, const QByteArray &encoding) const;
+
+    private:
+        QDateTime m_modified;
+        // Encoding -> size and modification time of the precompressed variant file
+        QHash<QByteArray, QByteArray> m_variantStamps;
+        friend class WebServerAssetCache;
+    };
+
+    explicit WebServerAssetCache(int maxSize = 8 * 1024 * 1024);
+
+    bool contains(const QString &fileName) const;
+    Asset asset(const QString &fileName);
+
+    int maxSize() const;
+    void setMaxSize(int maxSize);
+    void clear();
+
+    static QByteArray contentType(const QString &fileName);
+
+private:
+    QCache<QString, Asset> m_assets;
+};
+
+}
+
+#endif // WEBSERVERASSETCACHE_H
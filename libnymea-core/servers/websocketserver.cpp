@@ -96,14 +96,7 @@ QUrl WebSocketServer::serverUrl() const
  */
 void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
 {
-    QWebSocket *client = nullptr;
-    client = m_clientList.value(clientId);
-    if (client) {
-        qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
-        client->sendTextMessage(data + '\n');
-    } else {
-        qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
-    }
+    sendMessage(QList<QUuid>() << clientId, data, SendQueue::MessageTypeReply, QByteArray());
 }
 
 /*! Send the given \a data map to the given list of \a clients.
@@ -112,19 +105,127 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
  */
 void WebSocketServer::sendData(const QList<QUuid> &clients, const QByteArray &data)
 {
-    foreach (const QUuid &client, clients) {
-        sendData(client, data);
-    }
+    sendMessage(clients, data, SendQueue::MessageTypeReply, QByteArray());
+}
+
+/*! Send the notification \a data to the given list of \a clients. Notifications queued for clients which
+ *  do not keep up are coalesced by their \a coalescingKey or dropped.
+ *
+ * \sa TransportInterface::sendNotification()
+ */
+void WebSocketServer::sendNotification(const QList<QUuid> &clients, const QByteArray &data, const QByteArray &coalescingKey)
+{
+    sendMessage(clients, data, SendQueue::MessageTypeNotification, coalescingKey);
 }
 
 void WebSocketServer::terminateClientConnection(const QUuid &clientId)
 {
     QWebSocket *client = m_clientList.value(clientId);
     if (client) {
+        // Hand everything still queued to the socket, it is flushed before the connection is closed
+        SendQueue &queue = m_sendQueues[clientId];
+        while (!queue.isEmpty()) {
+            writeMessage(client, clientId, queue.takeFirst());
+        }
         client->close();
     }
 }
 
+/*! Returns true. Clients in binary mode exchange binary WebSocket messages.
+ *
+ * \sa TransportInterface::binaryModeSupported()
+ */
+bool WebSocketServer::binaryModeSupported() const
+{
+    return true;
+}
+
+/*! Enables or disables binary messages for the client with the given \a clientId.
+ *
+ * \sa TransportInterface::setBinaryMode()
+ */
+void WebSocketServer::setBinaryMode(const QUuid &clientId, bool binaryMode)
+{
+    if (binaryMode && m_clientList.contains(clientId)) {
+        m_binaryClients.insert(clientId);
+    } else {
+        m_binaryClients.remove(clientId);
+    }
+}
+
+/*! Returns the number of bytes sent or queued for the client with the given \a clientId which have not been written yet.
+ *
+ * \sa TransportInterface::bytesToWrite()
+ */
+qint64 WebSocketServer::bytesToWrite(const QUuid &clientId) const
+{
+    return m_bytesToWrite.value(clientId) + m_sendQueues.value(clientId).size();
+}
+
+/*! Returns the send queue statistics of the client with the given \a clientId.
+ *
+ * \sa TransportInterface::sendQueueStatistics()
+ */
+SendQueue::Statistics WebSocketServer::sendQueueStatistics(const QUuid &clientId) const
+{
+    return m_sendQueues.value(clientId).statistics();
+}
+
+void WebSocketServer::sendMessage(const QList<QUuid> &clients, const QByteArray &data, SendQueue::MessageType type, const QByteArray &coalescingKey)
+{
+    QString textMessage;
+    foreach (const QUuid &clientId, clients) {
+        QWebSocket *client = m_clientList.value(clientId);
+        if (!client) {
+            qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
+            continue;
+        }
+        qCDebug(dcWebSocketServerTraffic()) << "Sending data to client" << data;
+        bool binary = m_binaryClients.contains(clientId);
+        SendQueue &queue = m_sendQueues[clientId];
+        if (queue.isEmpty() && queue.canWrite(m_bytesToWrite.value(clientId))) {
+            if (binary) {
+                m_bytesToWrite[clientId] += client->sendBinaryMessage(data);
+            } else {
+                if (textMessage.isNull()) {
+                    textMessage = QString::fromUtf8(data + '\n');
+                }
+                m_bytesToWrite[clientId] += client->sendTextMessage(textMessage);
+            }
+            continue;
+        }
+
+        // The message type is fixed when queued as the client might switch to binary mode before it is written
+        SendQueue::Message queuedMessage;
+        queuedMessage.data = data;
+        queuedMessage.type = type;
+        queuedMessage.coalescingKey = coalescingKey;
+        queuedMessage.binary = binary;
+        queue.enqueue(queuedMessage);
+    }
+}
+
+void WebSocketServer::flushSendQueue(const QUuid &clientId)
+{
+    QWebSocket *client = m_clientList.value(clientId);
+    QHash<QUuid, SendQueue>::iterator queue = m_sendQueues.find(clientId);
+    if (!client || queue == m_sendQueues.end()) {
+        return;
+    }
+    while (!queue.value().isEmpty() && queue.value().canWrite(m_bytesToWrite.value(clientId))) {
+        writeMessage(client, clientId, queue.value().takeFirst());
+    }
+}
+
+void WebSocketServer::writeMessage(QWebSocket *client, const QUuid &clientId, const SendQueue::Message &message)
+{
+    if (message.binary) {
+        m_bytesToWrite[clientId] += client->sendBinaryMessage(message.data);
+    } else {
+        m_bytesToWrite[clientId] += client->sendTextMessage(QString::fromUtf8(message.data + '\n'));
+    }
+}
+
 void WebSocketServer::onClientConnected()
 {
     // got a new client connected
@@ -144,8 +245,10 @@ void WebSocketServer::onClientConnected()
 
     // append the new client to the client list
     m_clientList.insert(clientId, client);
+    m_sendQueues.insert(clientId, SendQueue(sendQueueConfiguration()));
 
     connect(client, SIGNAL(pong(quint64,QByteArray)), this, SLOT(onPing(quint64,QByteArray)));
+    connect(client, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
     connect(client, SIGNAL(binaryMessageReceived(QByteArray)), this, SLOT(onBinaryMessageReceived(QByteArray)));
     connect(client, SIGNAL(textMessageReceived(QString)), this, SLOT(onTextMessageReceived(QString)));
     connect(client, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onClientError(QAbstractSocket::SocketError)));
@@ -160,6 +263,9 @@ void WebSocketServer::onClientDisconnected()
     QUuid clientId = m_clientList.key(client);
     qCDebug(dcWebSocketServer()) << "Client" << clientId.toString() << "disconnected. (Remote address:" << client->peerAddress().toString() << ")" ;
     m_clientList.take(clientId)->deleteLater();
+    m_binaryClients.remove(clientId);
+    m_bytesToWrite.remove(clientId);
+    m_sendQueues.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -168,6 +274,11 @@ void WebSocketServer::onBinaryMessageReceived(const QByteArray &data)
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
     QUuid clientId = m_clientList.key(client);
     qCDebug(dcWebSocketServerTraffic()) << "Binary message from" << clientId.toString() << ":" << data;
+    if (!m_binaryClients.contains(clientId)) {
+        qCWarning(dcWebSocketServer()) << "Ignoring binary message from client" << clientId.toString() << "which is not in binary mode.";
+        return;
+    }
+    emit dataAvailable(clientId, data);
 }
 
 void WebSocketServer::onTextMessageReceived(const QString &message)
@@ -178,6 +289,18 @@ void WebSocketServer::onTextMessageReceived(const QString &message)
     emit dataAvailable(clientId, message.toUtf8());
 }
 
+void WebSocketServer::onBytesWritten(qint64 bytes)
+{
+    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
+    QUuid clientId = m_clientList.key(client);
+    if (!m_bytesToWrite.contains(clientId)) {
+        return;
+    }
+    // Written bytes include the frame headers, don't let the estimate drop below zero
+    m_bytesToWrite[clientId] = qMax<qint64>(0, m_bytesToWrite.value(clientId) - bytes);
+    flushSendQueue(clientId);
+}
+
 void WebSocketServer::onClientError(QAbstractSocket::SocketError error)
 {
     QWebSocket *client = qobject_cast<QWebSocket *>(sender());
@@ -35,6 +35,7 @@
 #include <QUuid>
 #include <QVariant>
 #include <QList>
+#include <QSet>
 #include <QWebSocket>
 #include <QWebSocketServer>
 
@@ -58,12 +59,28 @@ public:
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
     void sendData(const QList<QUuid> &clients, const QByteArray &data) override;
+    void sendNotification(const QList<QUuid> &clients, const QByteArray &data, const QByteArray &coalescingKey = QByteArray()) override;
 
     void terminateClientConnection(const QUuid &clientId) override;
 
+    bool binaryModeSupported() const override;
+    void setBinaryMode(const QUuid &clientId, bool binaryMode) override;
+
+    qint64 bytesToWrite(const QUuid &clientId) const override;
+    SendQueue::Statistics sendQueueStatistics(const QUuid &clientId) const override;
+
 private:
+    void sendMessage(const QList<QUuid> &clients, const QByteArray &data, SendQueue::MessageType type, const QByteArray &coalescingKey);
+    void flushSendQueue(const QUuid &clientId);
+    void writeMessage(QWebSocket *client, const QUuid &clientId, const SendQueue::Message &message);
+
     QWebSocketServer *m_server = nullptr;
     QHash<QUuid, QWebSocket *> m_clientList;
+    QSet<QUuid> m_binaryClients;
+    // QWebSocket does not expose its send buffer, so it is tracked by the sent and written bytes
+    QHash<QUuid, qint64> m_bytesToWrite;
+    // Messages held back while more than the high watermark is waiting to be written to a client
+    QHash<QUuid, SendQueue> m_sendQueues;
     QSslConfiguration m_sslConfiguration;
     bool m_enabled;
 
@@ -75,6 +92,7 @@ private slots:
     void onClientError(QAbstractSocket::SocketError error);
     void onServerError(QAbstractSocket::SocketError error);
     void onPing(quint64 elapsedTime, const QByteArray & payload);
+    void onBytesWritten(qint64 bytes);
 
 public slots:
     void reconfigureServer(const ServerConfiguration &config);
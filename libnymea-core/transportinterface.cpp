@@ -112,6 +112,71 @@ ServerConfiguration TransportInterface::configuration() const
     return m_config;
 }
 
+/*! Returns true if this TransportInterface can exchange binary messages with its clients.
+    The default implementation returns false.
+    \sa setBinaryMode()
+*/
+bool TransportInterface::binaryModeSupported() const
+{
+    return false;
+}
+
+/*! Switches the connection to the client with the given \a clientId to binary messages if \a binaryMode is true.
+    Stream based transports frame binary messages with a 32 bit big endian length prefix instead of
+    separating them with newlines, message based transports send them as binary messages.
+    The default implementation does nothing.
+    \sa binaryModeSupported()
+*/
+void TransportInterface::setBinaryMode(const QUuid &clientId, bool binaryMode)
+{
+    Q_UNUSED(clientId)
+    Q_UNUSED(binaryMode)
+}
+
+/*! Returns the number of bytes which have been sent to the client with the given \a clientId but
+    not been written to the connection yet. The JSON-RPC server reduces the notification rate for
+    clients which do not keep up. The default implementation returns 0.
+*/
+qint64 TransportInterface::bytesToWrite(const QUuid &clientId) const
+{
+    Q_UNUSED(clientId)
+    return 0;
+}
+
+/*! Sends the notification \a data to \a clients. Transports which queue outgoing messages may coalesce
+    the notification with a queued one carrying the same \a coalescingKey or drop it if a client does not
+    keep up. The default implementation sends the data like any other message.
+    \sa SendQueue
+*/
+void TransportInterface::sendNotification(const QList<QUuid> &clients, const QByteArray &data, const QByteArray &coalescingKey)
+{
+    Q_UNUSED(coalescingKey)
+    sendData(clients, data);
+}
+
+/*! Sets the watermarks and the overflow policy used for the send queues of new clients to the given \a configuration.
+    \sa SendQueue
+*/
+void TransportInterface::setSendQueueConfiguration(const SendQueue::Configuration &configuration)
+{
+    m_sendQueueConfiguration = configuration;
+}
+
+/*! Returns the configuration used for the send queues of new clients. */
+SendQueue::Configuration TransportInterface::sendQueueConfiguration() const
+{
+    return m_sendQueueConfiguration;
+}
+
+/*! Returns the send queue statistics of the client with the given \a clientId. Transports without
+    send queues return empty statistics, which is the default implementation.
+*/
+SendQueue::Statistics TransportInterface::sendQueueStatistics(const QUuid &clientId) const
+{
+    Q_UNUSED(clientId)
+    return SendQueue::Statistics();
+}
+
 /*! Set the name of this TransportInterface to the given \a serverName. */
 void TransportInterface::setServerName(const QString &serverName)
 {
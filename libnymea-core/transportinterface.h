@@ -37,6 +37,7 @@
 #include <QUuid>
 
 #include "nymeaconfiguration.h"
+#include "servers/sendqueue.h"
 
 namespace nymeaserver {
 
@@ -49,9 +50,19 @@ public:
 
     virtual void sendData(const QUuid &clientId, const QByteArray &data) = 0;
     virtual void sendData(const QList<QUuid> &clients, const QByteArray &data) = 0;
+    virtual void sendNotification(const QList<QUuid> &clients, const QByteArray &data, const QByteArray &coalescingKey = QByteArray());
 
     virtual void terminateClientConnection(const QUuid &clientId) = 0;
 
+    virtual bool binaryModeSupported() const;
+    virtual void setBinaryMode(const QUuid &clientId, bool binaryMode);
+
+    virtual qint64 bytesToWrite(const QUuid &clientId) const;
+
+    void setSendQueueConfiguration(const SendQueue::Configuration &configuration);
+    SendQueue::Configuration sendQueueConfiguration() const;
+    virtual SendQueue::Statistics sendQueueStatistics(const QUuid &clientId) const;
+
     void setConfiguration(const ServerConfiguration &config);
     ServerConfiguration configuration() const;
 
@@ -70,6 +81,7 @@ public slots:
 
 private:
     ServerConfiguration m_config;
+    SendQueue::Configuration m_sendQueueConfiguration;
 };
 
 }
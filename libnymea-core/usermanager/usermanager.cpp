@@ -61,6 +61,10 @@
         The permission is denied. Either invalid username, password or token.
 */
 
+/*! \fn void nymeaserver::UserManager::tokenRemoved(const QByteArray &token);
+    This signal is emitted when the given \a token has been removed and is not valid any more.
+*/
+
 /*! \fn void nymeaserver::UserManager::pushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
     This signal is emitted when the push authentication for the given \a transactionId is finished.
     If \a success is true, the resulting \a token contains a non empty string.
@@ -110,6 +114,8 @@ UserManager::UserManager(const QString &dbName, QObject *parent):
         }
     }
 
+    loadTokens();
+
     m_pushButtonDBusService = new PushButtonDBusService("/io/guh/nymead/UserManager", this);
     connect(m_pushButtonDBusService, &PushButtonDBusService::pushButtonPressed, this, &UserManager::onPushButtonPressed);
     m_pushButtonTransaction = qMakePair<int, QString>(-1, QString());
@@ -121,15 +127,9 @@ UserManager::UserManager(const QString &dbName, QObject *parent):
  */
 bool UserManager::initRequired() const
 {
-    QString getTokensQuery = QString("SELECT id, username, creationdate, deviceName FROM tokens;");
-    QSqlQuery result = m_db.exec(getTokensQuery);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qCWarning(dcUserManager) << "Query for tokens failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getTokensQuery;
-        // Note: do not return true in case the database access fails.
-        return false;
-    }
-
-    return users().isEmpty() && !result.first();
+    // Users and tokens are kept in sync with the database, no need to query it.
+    // Note: a user count of -1 means the database access failed, which doesn't require an init.
+    return m_userCount == 0 && m_tokens.isEmpty();
 }
 
 /*! Returns the list of user names for this UserManager. */
@@ -175,6 +175,9 @@ UserManager::UserError UserManager::createUser(const QString &username, const QS
         qCWarning(dcUserManager) << "Error creating user:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
         return UserErrorBackendError;
     }
+    if (m_userCount >= 0) {
+        m_userCount++;
+    }
     return UserErrorNoError;
 }
 
@@ -225,6 +228,7 @@ UserManager::UserError UserManager::removeUser(const QString &username)
 
     QString dropTokensQuery = QString("DELETE FROM tokens WHERE lower(username) = \"%1\";").arg(username.toLower());
     m_db.exec(dropTokensQuery);
+    loadTokens();
 
     return UserErrorNoError;
 }
@@ -259,9 +263,10 @@ QByteArray UserManager::authenticate(const QString &username, const QString &pas
         return QByteArray();
     }
 
+    QUuid tokenId = QUuid::createUuid();
     QByteArray token = QCryptographicHash::hash(QUuid::createUuid().toByteArray(), QCryptographicHash::Sha256).toBase64();
     QString storeTokenQuery = QString("INSERT INTO tokens(id, username, token, creationdate, devicename) VALUES(\"%1\", \"%2\", \"%3\", \"%4\", \"%5\");")
-            .arg(QUuid::createUuid().toString())
+            .arg(tokenId.toString())
             .arg(username.toLower())
             .arg(QString::fromUtf8(token))
             .arg(NymeaCore::instance()->timeManager()->currentDateTime().toString("yyyy-MM-dd hh:mm:ss"))
@@ -272,6 +277,7 @@ QByteArray UserManager::authenticate(const QString &username, const QString &pas
         qCWarning(dcUserManager) << "Error storing token in DB:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
         return QByteArray();
     }
+    m_tokens.insert(token, tokenId);
     return token;
 }
 
@@ -411,29 +417,29 @@ UserManager::UserError UserManager::removeToken(const QUuid &tokenId)
     }
 
     qCDebug(dcUserManager) << "Token" << tokenId << "removed from DB";
+    QByteArray token = m_tokens.key(tokenId);
+    if (token.isEmpty()) {
+        // Not loaded, so no client can be authenticated with it
+        qCWarning(dcUserManager) << "Token" << tokenId << "was not loaded";
+        return UserErrorNoError;
+    }
+    m_tokens.remove(token);
+    emit tokenRemoved(token);
     return UserErrorNoError;
 }
 
 /*! Returns true, if the given \a token is valid. */
 bool UserManager::verifyToken(const QByteArray &token)
 {
+    if (m_tokens.contains(token)) {
+        return true;
+    }
     if (!validateToken(token)) {
         qCWarning(dcUserManager) << "Token failed character validation" << token;
         return false;
     }
-    QString getTokenQuery = QString("SELECT * FROM tokens WHERE token = \"%1\";")
-            .arg(QString::fromUtf8(token));
-    QSqlQuery result = m_db.exec(getTokenQuery);
-    if (m_db.lastError().type() != QSqlError::NoError) {
-        qCWarning(dcUserManager) << "Query for token failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getTokenQuery;
-        return false;
-    }
-    if (!result.first()) {
-        qCDebug(dcUserManager) << "Authorization failed for token" << token;
-        return false;
-    }
-    //qCDebug(dcUserManager) << "Token authorized for user" << result.value("username").toString();
-    return true;
+    qCDebug(dcUserManager) << "Authorization failed for token" << token;
+    return false;
 }
 
 bool UserManager::initDB()
@@ -469,6 +475,37 @@ bool UserManager::initDB()
     return true;
 }
 
+void UserManager::loadTokens()
+{
+    QSqlQuery userCountResult = m_db.exec("SELECT COUNT(*) FROM users;");
+    if (m_db.lastError().type() != QSqlError::NoError || !userCountResult.first()) {
+        qCWarning(dcUserManager) << "Query for users failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
+        m_userCount = -1;
+    } else {
+        m_userCount = userCountResult.value(0).toInt();
+    }
+
+    QString getTokensQuery = QString("SELECT id, token FROM tokens;");
+    QSqlQuery result = m_db.exec(getTokensQuery);
+    if (m_db.lastError().type() != QSqlError::NoError) {
+        qCWarning(dcUserManager) << "Query for tokens failed:" << m_db.lastError().databaseText() << m_db.lastError().driverText() << getTokensQuery;
+        m_userCount = -1;
+        return;
+    }
+
+    QHash<QByteArray, QUuid> tokens;
+    while (result.next()) {
+        tokens.insert(result.value("token").toByteArray(), result.value("id").toUuid());
+    }
+
+    foreach (const QByteArray &token, m_tokens.keys()) {
+        if (!tokens.contains(token)) {
+            emit tokenRemoved(token);
+        }
+    }
+    m_tokens = tokens;
+}
+
 void UserManager::rotate(const QString &dbName)
 {
     int index = 1;
@@ -520,9 +557,10 @@ void UserManager::onPushButtonPressed()
         return;
     }
 
+    QUuid tokenId = QUuid::createUuid();
     QByteArray token = QCryptographicHash::hash(QUuid::createUuid().toByteArray(), QCryptographicHash::Sha256).toBase64();
     QString storeTokenQuery = QString("INSERT INTO tokens(id, username, token, creationdate, devicename) VALUES(\"%1\", \"%2\", \"%3\", \"%4\", \"%5\");")
-            .arg(QUuid::createUuid().toString())
+            .arg(tokenId.toString())
             .arg("")
             .arg(QString::fromUtf8(token))
             .arg(NymeaCore::instance()->timeManager()->currentDateTime().toString("yyyy-MM-dd hh:mm:ss"))
@@ -535,6 +573,7 @@ void UserManager::onPushButtonPressed()
         emit pushButtonAuthFinished(m_pushButtonTransaction.first, false, QByteArray());
     } else {
         qCDebug(dcUserManager()) << "PushButton Auth succeeded.";
+        m_tokens.insert(token, tokenId);
         emit pushButtonAuthFinished(m_pushButtonTransaction.first, true, token);
     }
 
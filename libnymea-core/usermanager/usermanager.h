@@ -36,6 +36,7 @@
 
 #include <QObject>
 #include <QSqlDatabase>
+#include <QHash>
 
 namespace nymeaserver {
 
@@ -83,9 +84,11 @@ public:
 
 signals:
     void pushButtonAuthFinished(int transactionId, bool success, const QByteArray &token);
+    void tokenRemoved(const QByteArray &token);
 
 private:
     bool initDB();
+    void loadTokens();
     void rotate(const QString &dbName);
     bool validateUsername(const QString &username) const;
     bool validatePassword(const QString &password) const;
@@ -100,6 +103,11 @@ private:
     int m_pushButtonTransactionIdCounter = 0;
     QPair<int, QString> m_pushButtonTransaction;
 
+    // All valid tokens and their token ids, kept in sync with the tokens table
+    QHash<QByteArray, QUuid> m_tokens;
+    // Number of users in the users table, -1 if it could not be read
+    int m_userCount = -1;
+
 };
 }
 Q_DECLARE_METATYPE(nymeaserver::UserManager::UserError)
@@ -300,61 +300,56 @@ bool Thing::hasParam(const ParamTypeId &paramTypeId) const
 void Thing::setStates(const States &states)
 {
     m_states = states;
+
+    m_statesIndexed = m_states.count() == m_thingClass.stateTypes().count();
+    for (int i = 0; i < m_states.count() && m_statesIndexed; i++) {
+        m_statesIndexed = m_thingClass.stateTypeIndex(m_states.at(i).stateTypeId()) == i;
+    }
 }
 
 /*! Returns true, a \l{State} with the given \a stateTypeId exists for this thing. */
 bool Thing::hasState(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return true;
-        }
-    }
-    return false;
+    return stateIndex(stateTypeId) >= 0;
 }
 
 /*! For convenience, this finds the \l{State} matching the given \a stateTypeId and returns the current valie in this thing. */
 QVariant Thing::stateValue(const StateTypeId &stateTypeId) const
 {
-    foreach (const State &state, m_states) {
-        if (state.stateTypeId() == stateTypeId) {
-            return state.value();
-        }
+    int index = stateIndex(stateTypeId);
+    if (index < 0) {
+        return QVariant();
     }
-    return QVariant();
+    return m_states.at(index).value();
 }
 
 /*! For convenience, this finds the \l{State} matching the given \a stateTypeId in this thing and sets the current value to \a value. */
 void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
 {
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            if (m_states.at(i).value() == value)
-                return;
+    int index = stateIndex(stateTypeId);
+    if (index < 0) {
+        qCWarning(dcThingManager) << "Failed setting state for" << m_name << value;
+        return;
+    }
 
+    if (m_states.at(index).value() == value)
+        return;
 
-            // TODO: check min/max value + possible values
-            //       to prevent an invalid state type from the plugin side
+    // TODO: check min/max value + possible values
+    //       to prevent an invalid state type from the plugin side
 
-            State newState(stateTypeId, m_id);
-            newState.setValue(value);
-            m_states[i] = newState;
-            emit stateValueChanged(stateTypeId, value);
-            return;
-        }
-    }
-    qCWarning(dcThingManager) << "Failed setting state for" << m_name << value;
+    m_states[index].setValue(value);
+    emit stateValueChanged(stateTypeId, value);
 }
 
 /*! Returns the \l{State} with the given \a stateTypeId of this thing. */
 State Thing::state(const StateTypeId &stateTypeId) const
 {
-    for (int i = 0; i < m_states.count(); ++i) {
-        if (m_states.at(i).stateTypeId() == stateTypeId) {
-            return m_states.at(i);
-        }
+    int index = stateIndex(stateTypeId);
+    if (index < 0) {
+        return State(StateTypeId(), ThingId());
     }
-    return State(StateTypeId(), ThingId());
+    return m_states.at(index);
 }
 
 /*! Returns the \l{ThingId} of the parent of this thing. If the parentId
@@ -416,6 +411,19 @@ void Thing::setSetupStatus(Thing::ThingSetupStatus status, Thing::ThingError set
     emit setupStatusChanged();
 }
 
+int Thing::stateIndex(const StateTypeId &stateTypeId) const
+{
+    if (m_statesIndexed) {
+        return m_thingClass.stateTypeIndex(stateTypeId);
+    }
+    for (int i = 0; i < m_states.count(); ++i) {
+        if (m_states.at(i).stateTypeId() == stateTypeId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 Things::Things(const QList<Thing*> &other)
 {
     foreach (Thing* thing, other) {
@@ -161,6 +161,7 @@ private:
     Thing(const PluginId &pluginId, const ThingClass &thingClass, QObject *parent = nullptr);
 
     void setSetupStatus(ThingSetupStatus status, ThingError setupError, const QString &displayMessage = QString());
+    int stateIndex(const StateTypeId &stateTypeId) const;
 
 private:
     ThingClass m_thingClass;
@@ -171,6 +172,8 @@ private:
     ParamList m_params;
     ParamList m_settings;
     States m_states;
+    // True if m_states is laid out like m_thingClass.stateTypes() so its index can be used
+    bool m_statesIndexed = false;
     bool m_autoCreated = false;
 
     ThingSetupStatus m_setupStatus = ThingSetupStatusNone;
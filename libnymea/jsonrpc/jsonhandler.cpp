@@ -34,13 +34,36 @@
 
 #include <QDebug>
 #include <QDateTime>
+#include <QMetaProperty>
+#include <QJsonDocument>
+#include <QCryptographicHash>
 
-JsonHandler::JsonHandler(QObject *parent) : QObject(parent)
+class JsonHandler::Private
+{
+public:
+    struct CachedReply {
+        QVariantMap data;
+        QString etag;
+    };
+    // Reply data of methods supporting "ifNoneMatch", keyed by method and locale
+    QHash<QString, CachedReply> replyCache;
+
+    // Serializers are built on first use from the registered types and dropped whenever a type is registered
+    QHash<const char*, QSharedPointer<ObjectSerializer>> serializers;
+};
+
+JsonHandler::JsonHandler(QObject *parent) :
+    QObject(parent),
+    d(new Private)
 {
     qRegisterMetaType<QVariant::Type>();
     registerEnum<BasicType>();
 }
 
+JsonHandler::~JsonHandler()
+{
+}
+
 QVariantMap JsonHandler::translateNotification(const QString &notification, const QVariantMap &params, const QLocale &locale)
 {
     Q_UNUSED(notification)
@@ -172,6 +195,68 @@ JsonReply *JsonHandler::createReply(const QVariantMap &data) const
     return JsonReply::createReply(const_cast<JsonHandler*>(this), data);
 }
 
+// Returns the ETags of all methods accepting an "ifNoneMatch" param for the given locale, keyed by
+// the full method name. Replies which are not cached yet are created by calling the method.
+QVariantMap JsonHandler::replyETags(const QLocale &locale)
+{
+    QVariantMap ret;
+    foreach (const QString &method, m_methods.keys()) {
+        if (!m_methods.value(method).toMap().value("params").toMap().contains("o:ifNoneMatch")) {
+            continue;
+        }
+
+        QString cacheKey = method + '/' + locale.name();
+        if (!d->replyCache.contains(cacheKey)) {
+            JsonReply *reply = nullptr;
+            JsonContext context(QUuid(), locale);
+            QMetaObject::invokeMethod(this, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, QVariantMap()), Q_ARG(JsonContext, context));
+            if (reply) {
+                reply->deleteLater();
+            }
+        }
+        if (d->replyCache.contains(cacheKey)) {
+            ret.insert(name() + '.' + method, d->replyCache.value(cacheKey).etag);
+        }
+    }
+    return ret;
+}
+
+// The data returned by createData is created once per method and locale and cached until
+// clearReplyCache() is called. If the "ifNoneMatch" param matches the ETag of the cached data,
+// lists and objects are left out of the reply and "notModified" is set instead.
+JsonReply *JsonHandler::createCachedReply(const QString &method, const QVariantMap &params, const QLocale &locale, std::function<QVariantMap ()> createData) const
+{
+    QString cacheKey = method + '/' + locale.name();
+    if (!d->replyCache.contains(cacheKey)) {
+        Private::CachedReply cachedReply;
+        cachedReply.data = createData();
+        QByteArray content = QJsonDocument::fromVariant(cachedReply.data).toJson(QJsonDocument::Compact);
+        cachedReply.etag = QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex();
+        d->replyCache.insert(cacheKey, cachedReply);
+    }
+
+    const Private::CachedReply &cachedReply = d->replyCache[cacheKey];
+    QVariantMap returns;
+    if (params.value("ifNoneMatch").toString() == cachedReply.etag) {
+        foreach (const QString &key, cachedReply.data.keys()) {
+            QVariant::Type type = cachedReply.data.value(key).type();
+            if (type != QVariant::List && type != QVariant::Map) {
+                returns.insert(key, cachedReply.data.value(key));
+            }
+        }
+        returns.insert("notModified", true);
+    } else {
+        returns = cachedReply.data;
+    }
+    returns.insert("etag", cachedReply.etag);
+    return createReply(returns);
+}
+
+void JsonHandler::clearReplyCache()
+{
+    d->replyCache.clear();
+}
+
 JsonReply *JsonHandler::createAsyncReply(const QString &method) const
 {
     return JsonReply::createAsyncReply(const_cast<JsonHandler*>(this), method);
@@ -220,6 +305,7 @@ void JsonHandler::registerObject(const QMetaObject &metaObject)
     }
     m_objects.insert(className, description);
     m_metaObjects.insert(className, metaObject);
+    invalidateSerializers();
 }
 
 void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject)
@@ -231,253 +317,342 @@ void JsonHandler::registerObject(const QMetaObject &metaObject, const QMetaObjec
     m_metaObjects.insert(listTypeName, listMetaObject);
     m_listMetaObjects.insert(listTypeName, listMetaObject);
     m_listEntryTypes.insert(listTypeName, objectTypeName);
+    invalidateSerializers();
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("put(QVariant)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE void put(QVariant variant)\" method!").arg(listTypeName).toUtf8());
 }
 
-QVariant JsonHandler::pack(const QMetaObject &metaObject, const void *value) const
+/* Describes how a single property of a registered object is packed and unpacked.
+   Everything that can be looked up by name is resolved once when the serializer is built. */
+struct JsonHandler::PropertySerializer
+{
+    enum Kind {
+        KindValue,
+        KindDateTime,
+        KindTime,
+        KindBasicType,
+        KindEnum,
+        KindFlags,
+        KindObject,
+        KindList,
+        KindIntList,
+        KindUuidList,
+        KindUnhandledList,
+        KindUnregistered
+    };
+
+    QMetaProperty metaProperty;
+    QString name;
+    Kind kind = KindValue;
+    bool optional = false;
+    QMetaEnum metaEnum; // Enums and flags
+    QMetaObject metaObject; // Objects and lists
+    QMetaMethod isValidMethod; // Objects, invalid if the object has no isValid() method
+};
+
+struct JsonHandler::ObjectSerializer
+{
+    int typeId = 0;
+    bool isList = false;
+
+    // Lists
+    QMetaProperty countProperty;
+    QMetaMethod getMethod;
+    QMetaMethod putMethod;
+    QMetaObject entryMetaObject;
+
+    // Objects
+    QVector<PropertySerializer> properties;
+};
+
+void JsonHandler::invalidateSerializers()
 {
+    d->serializers.clear();
+}
+
+QSharedPointer<JsonHandler::ObjectSerializer> JsonHandler::serializer(const QMetaObject &metaObject) const
+{
+    // className() points into the static meta object data and is the same for all copies of a QMetaObject
+    QSharedPointer<ObjectSerializer> objectSerializer = d->serializers.value(metaObject.className());
+    if (objectSerializer) {
+        return objectSerializer;
+    }
+
     QString className = QString(metaObject.className()).split("::").last();
+    if (!m_metaObjects.contains(className)) {
+        return objectSerializer;
+    }
+
+    objectSerializer = QSharedPointer<ObjectSerializer>::create();
+    objectSerializer->typeId = QMetaType::type(metaObject.className());
+
     if (m_listMetaObjects.contains(className)) {
+        objectSerializer->isList = true;
+        objectSerializer->countProperty = metaObject.property(metaObject.indexOfProperty("count"));
+        objectSerializer->getMethod = metaObject.method(metaObject.indexOfMethod("get(int)"));
+        objectSerializer->putMethod = metaObject.method(metaObject.indexOfMethod("put(QVariant)"));
+        objectSerializer->entryMetaObject = m_metaObjects.value(m_listEntryTypes.value(className));
+        d->serializers.insert(metaObject.className(), objectSerializer);
+        return objectSerializer;
+    }
+
+    for (int i = 0; i < metaObject.propertyCount(); i++) {
+        PropertySerializer property;
+        property.metaProperty = metaObject.property(i);
+        property.name = property.metaProperty.name();
+
+        // Skip QObject's objectName property
+        if (property.name == QStringLiteral("objectName")) {
+            continue;
+        }
+
+        property.optional = property.metaProperty.isUser();
+        QString propertyTypeName = QString(property.metaProperty.typeName()).split("::").last();
+
+        if (property.metaProperty.isFlagType()) {
+            Q_ASSERT_X(m_metaFlags.contains(propertyTypeName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(propertyTypeName).toUtf8());
+            property.kind = PropertySerializer::KindFlags;
+            property.metaEnum = m_metaFlags.value(propertyTypeName);
+        } else if (property.metaProperty.isEnumType()) {
+            Q_ASSERT_X(m_metaEnums.contains(propertyTypeName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(property.metaProperty.typeName()).toUtf8());
+            property.kind = PropertySerializer::KindEnum;
+            property.metaEnum = m_metaEnums.value(propertyTypeName);
+        } else if (property.metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
+            property.kind = PropertySerializer::KindBasicType;
+        } else if (m_listMetaObjects.contains(propertyTypeName)) {
+            property.kind = PropertySerializer::KindList;
+            property.metaObject = m_listMetaObjects.value(propertyTypeName);
+        } else if (m_metaObjects.contains(propertyTypeName)) {
+            property.kind = PropertySerializer::KindObject;
+            property.metaObject = m_metaObjects.value(propertyTypeName);
+            int isValidIndex = property.metaObject.indexOfMethod("isValid()");
+            if (isValidIndex >= 0) {
+                property.isValidMethod = property.metaObject.method(isValidIndex);
+            }
+        } else if (property.metaProperty.typeName() == QStringLiteral("QList<int>")) {
+            property.kind = PropertySerializer::KindIntList;
+        } else if (property.metaProperty.typeName() == QStringLiteral("QList<QUuid>")) {
+            property.kind = PropertySerializer::KindUuidList;
+        } else if (QString(property.metaProperty.typeName()).startsWith("QList<")) {
+            Q_ASSERT_X(false, this->metaObject()->className(), QString("Unhandled list type: %1").arg(property.metaProperty.typeName()).toUtf8());
+            qCWarning(dcJsonRpc()) << "Cannot pack property of unhandled list type" << property.metaProperty.typeName();
+            property.kind = PropertySerializer::KindUnhandledList;
+        } else if (property.metaProperty.type() == QVariant::UserType) {
+            property.kind = PropertySerializer::KindUnregistered;
+        } else if (property.metaProperty.type() == QVariant::DateTime) {
+            property.kind = PropertySerializer::KindDateTime;
+        } else if (property.metaProperty.type() == QVariant::Time) {
+            property.kind = PropertySerializer::KindTime;
+        }
+
+        objectSerializer->properties.append(property);
+    }
+
+    d->serializers.insert(metaObject.className(), objectSerializer);
+    return objectSerializer;
+}
+
+QVariant JsonHandler::pack(const QMetaObject &metaObject, const void *value) const
+{
+    QSharedPointer<ObjectSerializer> objectSerializer = serializer(metaObject);
+    if (!objectSerializer) {
+        QString className = QString(metaObject.className()).split("::").last();
+        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(className).toUtf8());
+        qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << className;
+        return QVariant();
+    }
+    return pack(*objectSerializer, value);
+}
+
+QVariant JsonHandler::pack(const ObjectSerializer &objectSerializer, const void *value) const
+{
+    if (objectSerializer.isList) {
         QVariantList ret;
-        QMetaProperty countProperty = metaObject.property(metaObject.indexOfProperty("count"));
-        QMetaObject entryMetaObject = m_metaObjects.value(m_listEntryTypes.value(className));
-        int count = countProperty.readOnGadget(value).toInt();
-        QMetaMethod getMethod = metaObject.method(metaObject.indexOfMethod("get(int)"));
+        QSharedPointer<ObjectSerializer> entrySerializer = serializer(objectSerializer.entryMetaObject);
+        int count = objectSerializer.countProperty.readOnGadget(value).toInt();
+        ret.reserve(count);
         for (int i = 0; i < count; i++) {
             QVariant entry;
-            getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
-            ret.append(pack(entryMetaObject, entry.data()));
+            objectSerializer.getMethod.invokeOnGadget(const_cast<void*>(value), Q_RETURN_ARG(QVariant, entry), Q_ARG(int, i));
+            ret.append(pack(*entrySerializer, entry.data()));
         }
         return ret;
     }
 
-    if (m_metaObjects.contains(className)) {
-        QVariantMap ret;
-        for (int i = 0; i < metaObject.propertyCount(); i++) {
-            QMetaProperty metaProperty = metaObject.property(i);
-
-            // Skip QObject's objectName property
-            if (metaProperty.name() == QStringLiteral("objectName")) {
-                continue;
-            }
-
-            QVariant propertyValue = metaProperty.readOnGadget(value);
-            // If it's optional and empty, we may skip it
-            if (metaProperty.isUser() && (!propertyValue.isValid() || propertyValue.isNull())) {
-                continue;
-            }
+    QVariantMap ret;
+    foreach (const PropertySerializer &property, objectSerializer.properties) {
+        QVariant propertyValue = property.metaProperty.readOnGadget(value);
+        // If it's optional and empty, we may skip it
+        if (property.optional && (!propertyValue.isValid() || propertyValue.isNull())) {
+            continue;
+        }
 
-            // Pack flags
-            if (metaProperty.isFlagType()) {
-                QString flagName = QString(metaProperty.typeName()).split("::").last();
-                Q_ASSERT_X(m_metaFlags.contains(flagName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(flagName).toUtf8());
-                QMetaEnum metaFlag = m_metaFlags.value(flagName);
-                int flagValue = propertyValue.toInt();
-                QStringList flags;
-                for (int i = 0; i < metaFlag.keyCount(); i++) {
-                    if ((metaFlag.value(i) & flagValue) > 0) {
-                        flags.append(metaFlag.key(i));
-                    }
+        switch (property.kind) {
+        case PropertySerializer::KindFlags: {
+            int flagValue = propertyValue.toInt();
+            QStringList flags;
+            for (int i = 0; i < property.metaEnum.keyCount(); i++) {
+                if ((property.metaEnum.value(i) & flagValue) > 0) {
+                    flags.append(property.metaEnum.key(i));
                 }
-                ret.insert(metaProperty.name(), flags);
-                continue;
             }
-
-            // Pack enums
-            if (metaProperty.isEnumType()) {
-                QString enumName = QString(metaProperty.typeName()).split("::").last();
-                Q_ASSERT_X(m_metaEnums.contains(enumName), this->metaObject()->className(), QString("Cannot pack %1. %2 is not registered in this handler.").arg(className).arg(metaProperty.typeName()).toUtf8());
-                QMetaEnum metaEnum = m_metaEnums.value(enumName);
-                ret.insert(metaProperty.name(), metaEnum.key(propertyValue.toInt()));
-                continue;
+            ret.insert(property.name, flags);
+            break;
+        }
+        case PropertySerializer::KindEnum:
+            ret.insert(property.name, property.metaEnum.key(propertyValue.toInt()));
+            break;
+        case PropertySerializer::KindBasicType: {
+            QMetaEnum metaEnum = QMetaEnum::fromType<BasicType>();
+            ret.insert(property.name, metaEnum.key(variantTypeToBasicType(propertyValue.template value<QVariant::Type>())));
+            break;
+        }
+        case PropertySerializer::KindList: {
+            QVariant packed = pack(*serializer(property.metaObject), propertyValue.data());
+            if (!property.optional || packed.toList().count() > 0) {
+                ret.insert(property.name, packed);
             }
-
-            // Basic type/Variant type
-            if (metaProperty.typeName() == QStringLiteral("QVariant::Type")) {
-                QMetaEnum metaEnum = QMetaEnum::fromType<BasicType>();
-                ret.insert(metaProperty.name(), metaEnum.key(variantTypeToBasicType(propertyValue.template value<QVariant::Type>())));
-                continue;
+            break;
+        }
+        case PropertySerializer::KindObject: {
+            QVariant packed = pack(*serializer(property.metaObject), propertyValue.data());
+            bool isValid = true;
+            if (property.isValidMethod.isValid()) {
+                property.isValidMethod.invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
             }
-
-            // Our own objects
-            if (metaProperty.type() == QVariant::UserType) {
-                QString propertyTypeName = QString(metaProperty.typeName()).split("::").last();
-                if (m_listMetaObjects.contains(propertyTypeName)) {
-                    QMetaObject entryMetaObject = m_listMetaObjects.value(propertyTypeName);
-                    QVariant packed = pack(entryMetaObject, propertyValue.data());
-                    if (!metaProperty.isUser() || packed.toList().count() > 0) {
-                        ret.insert(metaProperty.name(), packed);
-                    }
-                    continue;
-                }
-
-                if (m_metaObjects.contains(propertyTypeName)) {
-                    QMetaObject entryMetaObject = m_metaObjects.value(propertyTypeName);
-                    QVariant packed = pack(entryMetaObject, propertyValue.data());
-                    int isValidIndex = entryMetaObject.indexOfMethod("isValid()");
-                    bool isValid = true;
-                    if (isValidIndex >= 0) {
-                        QMetaMethod isValidMethod = entryMetaObject.method(isValidIndex);
-                        isValidMethod.invokeOnGadget(propertyValue.data(), Q_RETURN_ARG(bool, isValid));
-                    }
-                    if (isValid || !metaProperty.isUser()) {
-                        ret.insert(metaProperty.name(), packed);
-                    }
-                    continue;
+            if (isValid || !property.optional) {
+                ret.insert(property.name, packed);
+            }
+            break;
+        }
+        case PropertySerializer::KindIntList:
+        case PropertySerializer::KindUuidList: {
+            // Manually converting QList<BasicType>... Only QVariantList is known to the meta system
+            QVariantList list;
+            if (property.kind == PropertySerializer::KindIntList) {
+                foreach (int entry, propertyValue.value<QList<int>>()) {
+                    list << entry;
                 }
-
-                // Manually converting QList<BasicType>... Only QVariantList is known to the meta system
-                if (propertyTypeName.startsWith("QList<")) {
-                    QVariantList list;
-                    if (propertyTypeName == "QList<int>") {
-                        foreach (int entry, propertyValue.value<QList<int>>()) {
-                            list << entry;
-                        }
-                    } else if (propertyTypeName == "QList<QUuid>") {
-                        foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
-                            list << entry;
-                        }
-                    } else {
-                        Q_ASSERT_X(false, this->metaObject()->className(), QString("Unhandled list type: %1").arg(propertyTypeName).toUtf8());
-                        qCWarning(dcJsonRpc()) << "Cannot pack property of unhandled list type" << propertyTypeName;
-                    }
-
-                    if (!list.isEmpty() || !metaProperty.isUser()) {
-                        ret.insert(metaProperty.name(), list);
-                    }
-                    continue;
+            } else {
+                foreach (const QUuid &entry, propertyValue.value<QList<QUuid>>()) {
+                    list << entry;
                 }
-
-                Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered property type: %1").arg(propertyTypeName).toUtf8());
-                qCWarning(dcJsonRpc()) << "Cannot pack property of unregistered object type" << propertyTypeName;
-                continue;
             }
-
-            // Standard properties, QString, int etc...
+            if (!list.isEmpty() || !property.optional) {
+                ret.insert(property.name, list);
+            }
+            break;
+        }
+        case PropertySerializer::KindUnhandledList:
+            break;
+        case PropertySerializer::KindUnregistered:
+            Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered property type: %1").arg(property.metaProperty.typeName()).toUtf8());
+            qCWarning(dcJsonRpc()) << "Cannot pack property of unregistered object type" << property.metaProperty.typeName();
+            break;
+        case PropertySerializer::KindDateTime: {
             // Special treatment for QDateTime (converting to time_t)
-            if (metaProperty.type() == QVariant::DateTime) {
-                QDateTime dateTime = propertyValue.toDateTime();
-                if (metaProperty.isUser() && dateTime.toTime_t() == 0) {
-                    continue;
-                }
-                propertyValue = propertyValue.toDateTime().toTime_t();
-            } else if (metaProperty.type() == QVariant::Time) {
-                propertyValue = propertyValue.toTime().toString("hh:mm");
+            uint timestamp = propertyValue.toDateTime().toTime_t();
+            if (!property.optional || timestamp != 0) {
+                ret.insert(property.name, timestamp);
             }
-            ret.insert(metaProperty.name(), propertyValue);
+            break;
+        }
+        case PropertySerializer::KindTime:
+            ret.insert(property.name, propertyValue.toTime().toString("hh:mm"));
+            break;
+        case PropertySerializer::KindValue:
+            // Standard properties, QString, int etc...
+            ret.insert(property.name, propertyValue);
+            break;
         }
-        return ret;
     }
-
-    Q_ASSERT_X(false, this->metaObject()->className(), QString("Unregistered object type: %1").arg(className).toUtf8());
-    qCWarning(dcJsonRpc()) << "Cannot pack object of unregistered type" << className;
-    return QVariant();    
+    return ret;
 }
 
 QVariant JsonHandler::unpack(const QMetaObject &metaObject, const QVariant &value) const
 {
-    QString typeName = QString(metaObject.className()).split("::").last();
+    QSharedPointer<ObjectSerializer> objectSerializer = serializer(metaObject);
+    if (!objectSerializer) {
+        return QVariant();
+    }
+
+    Q_ASSERT_X(objectSerializer->typeId != 0, this->metaObject()->className(), QString("Cannot handle unregistered meta type %1").arg(metaObject.className()).toUtf8());
 
     // If it's a list object, loop over count
-    if (m_listMetaObjects.contains(typeName)) {
+    if (objectSerializer->isList) {
         if (value.type() != QVariant::List) {
-//            qCWarning(dcJsonRpc()) << "Cannot unpack" << typeName << ". Value is not in list format:" << value;
             return QVariant();
         }
 
-        QVariantList list = value.toList();
-
-        int typeId = QMetaType::type(metaObject.className());
-        void* ptr = QMetaType::create(typeId);
-        Q_ASSERT_X(typeId != 0, this->metaObject()->className(), QString("Cannot handle unregistered meta type %1").arg(metaObject.className()).toUtf8());
-
-        QMetaObject entryMetaObject = m_metaObjects.value(m_listEntryTypes.value(typeName));
-        QMetaMethod putMethod = metaObject.method(metaObject.indexOfMethod("put(QVariant)"));
-
-        foreach (const QVariant &variant, list) {
-            QVariant value = unpack(entryMetaObject, variant);
-            putMethod.invokeOnGadget(ptr, Q_ARG(QVariant, value));
+        void* ptr = QMetaType::create(objectSerializer->typeId);
+        foreach (const QVariant &variant, value.toList()) {
+            QVariant entry = unpack(objectSerializer->entryMetaObject, variant);
+            objectSerializer->putMethod.invokeOnGadget(ptr, Q_ARG(QVariant, entry));
         }
 
-        QVariant ret = QVariant(typeId, ptr);
-        QMetaType::destroy(typeId, ptr);
+        QVariant ret = QVariant(objectSerializer->typeId, ptr);
+        QMetaType::destroy(objectSerializer->typeId, ptr);
         return ret;
     }
 
     // if it's an object, loop over all properties
-    if (m_metaObjects.contains(typeName)) {
-        QVariantMap map = value.toMap();
-        int typeId = QMetaType::type(metaObject.className());
-        Q_ASSERT_X(typeId != 0, this->metaObject()->className(), QString("Cannot handle unregistered meta type %1").arg(typeName).toUtf8());
-        void* ptr = QMetaType::create(typeId);
-        for (int i = 0; i < metaObject.propertyCount(); i++) {
-            QMetaProperty metaProperty = metaObject.property(i);
-            if (metaProperty.name() == QStringLiteral("objectName")) {
-                continue;
-            }
-            if (!metaProperty.isWritable()) {
-                continue;
-            }
-            if (!metaProperty.isUser()) {
-                Q_ASSERT_X(map.contains(metaProperty.name()), this->metaObject()->className(), QString("Missing property %1 in map.").arg(metaProperty.name()).toUtf8());
-            }
-
-            if (map.contains(metaProperty.name())) {
-
-                QString propertyTypeName = QString(metaProperty.typeName()).split("::").last();
-                QVariant variant = map.value(metaProperty.name());
-
-                // recurse into child lists
-                if (m_listMetaObjects.contains(propertyTypeName)) {
-                    QMetaObject propertyMetaObject = m_listMetaObjects.value(propertyTypeName);
-                    metaProperty.writeOnGadget(ptr, unpack(propertyMetaObject, variant));
-                    continue;
-                }
-
-                // recurse into child objects
-                if (m_metaObjects.contains(propertyTypeName)) {
-                    QMetaObject propertyMetaObject = m_metaObjects.value(propertyTypeName);
-                    metaProperty.writeOnGadget(ptr, unpack(propertyMetaObject, variant));
-                    continue;
-                }
-
-                if (QString(metaProperty.typeName()).startsWith("QList<")) {
-                    if (metaProperty.typeName() == QStringLiteral("QList<int>")) {
-                        QList<int> intList;
-                        foreach (const QVariant &val, variant.toList()) {
-                            intList.append(val.toInt());
-                        }
-                        metaProperty.writeOnGadget(ptr, QVariant::fromValue(intList));
-                    } else if (metaProperty.typeName() == QStringLiteral("QList<QUuid>")) {
-                        QList<QUuid> uuidList;
-                        foreach (const QVariant &val, variant.toList()) {
-                            uuidList.append(val.toUuid());
-                        }
-                        metaProperty.writeOnGadget(ptr, QVariant::fromValue(uuidList));
-                    }
-                    continue;
-                }
-
-                // Special treatment for QDateTime (convert from time_t)
-                if (metaProperty.type() == QVariant::DateTime) {
-                    variant = QDateTime::fromTime_t(variant.toUInt());
-                } else if (metaProperty.type() == QVariant::Time) {
-                    variant = QTime::fromString(variant.toString(), "hh:mm");
-                }
+    QVariantMap map = value.toMap();
+    void* ptr = QMetaType::create(objectSerializer->typeId);
+    foreach (const PropertySerializer &property, objectSerializer->properties) {
+        if (!property.metaProperty.isWritable()) {
+            continue;
+        }
+        if (!property.optional) {
+            Q_ASSERT_X(map.contains(property.name), this->metaObject()->className(), QString("Missing property %1 in map.").arg(property.name).toUtf8());
+        }
 
-                // For basic properties just write the veriant as is
-                metaProperty.writeOnGadget(ptr, variant);
+        QVariantMap::const_iterator it = map.constFind(property.name);
+        if (it == map.constEnd()) {
+            continue;
+        }
+        QVariant variant = it.value();
+
+        switch (property.kind) {
+        case PropertySerializer::KindList:
+        case PropertySerializer::KindObject:
+            // recurse into child lists and objects
+            property.metaProperty.writeOnGadget(ptr, unpack(property.metaObject, variant));
+            break;
+        case PropertySerializer::KindIntList: {
+            QList<int> intList;
+            foreach (const QVariant &val, variant.toList()) {
+                intList.append(val.toInt());
             }
-
+            property.metaProperty.writeOnGadget(ptr, QVariant::fromValue(intList));
+            break;
+        }
+        case PropertySerializer::KindUuidList: {
+            QList<QUuid> uuidList;
+            foreach (const QVariant &val, variant.toList()) {
+                uuidList.append(val.toUuid());
+            }
+            property.metaProperty.writeOnGadget(ptr, QVariant::fromValue(uuidList));
+            break;
+        }
+        case PropertySerializer::KindUnhandledList:
+            break;
+        case PropertySerializer::KindDateTime:
+            // Special treatment for QDateTime (convert from time_t)
+            property.metaProperty.writeOnGadget(ptr, QDateTime::fromTime_t(variant.toUInt()));
+            break;
+        case PropertySerializer::KindTime:
+            property.metaProperty.writeOnGadget(ptr, QTime::fromString(variant.toString(), "hh:mm"));
+            break;
+        default:
+            // For basic properties just write the veriant as is
+            property.metaProperty.writeOnGadget(ptr, variant);
+            break;
         }
-        QVariant ret = QVariant(typeId, ptr);
-        QMetaType::destroy(typeId, ptr);
-        return ret;
     }
-
-    return QVariant();
+    QVariant ret = QVariant(objectSerializer->typeId, ptr);
+    QMetaType::destroy(objectSerializer->typeId, ptr);
+    return ret;
 }
 
 
@@ -37,6 +37,9 @@
 #include <QDebug>
 #include <QVariant>
 #include <QDateTime>
+#include <QSharedPointer>
+#include <QScopedPointer>
+#include <functional>
 
 #include "jsonreply.h"
 #include "jsoncontext.h"
@@ -61,7 +64,7 @@ public:
     Q_ENUM(BasicType)
 
     explicit JsonHandler(QObject *parent = nullptr);
-    virtual ~JsonHandler() = default;
+    virtual ~JsonHandler();
 
     virtual QString name() const = 0;
 
@@ -73,6 +76,7 @@ public:
     QVariantMap jsonMethods() const;
     QVariantMap jsonNotifications() const;
 
+    QVariantMap replyETags(const QLocale &locale);
 
     template<typename T> static QString enumRef();
     template<typename T> static QString objectRef();
@@ -109,12 +113,20 @@ protected:
 
     JsonReply *createReply(const QVariantMap &data) const;
     JsonReply *createAsyncReply(const QString &method) const;
+    JsonReply *createCachedReply(const QString &method, const QVariantMap &params, const QLocale &locale, std::function<QVariantMap()> createData) const;
+    void clearReplyCache();
 
 private:
     void registerObject(const QMetaObject &metaObject);
     void registerObject(const QMetaObject &metaObject, const QMetaObject &listMetaObject);
 
+    struct PropertySerializer;
+    struct ObjectSerializer;
+    QSharedPointer<ObjectSerializer> serializer(const QMetaObject &metaObject) const;
+    void invalidateSerializers();
+
     QVariant pack(const QMetaObject &metaObject, const void *gadget) const;
+    QVariant pack(const ObjectSerializer &objectSerializer, const void *gadget) const;
     QVariant unpack(const QMetaObject &metaObject, const QVariant &value) const;
 
 private:
@@ -129,6 +141,10 @@ private:
     QHash<QString, QString> m_listEntryTypes;
     QVariantMap m_methods;
     QVariantMap m_notifications;
+
+    // Caches kept out of the class layout, see jsonhandler.cpp
+    class Private;
+    QScopedPointer<Private> d;
 };
 Q_DECLARE_METATYPE(QVariant::Type)
 
@@ -142,6 +158,7 @@ void JsonHandler::registerEnum()
     }
     m_enums.insert(metaEnum.name(), values);
     m_metaEnums.insert(metaEnum.name(), metaEnum);
+    invalidateSerializers();
 }
 
 template<typename Enum, typename Flags>
@@ -153,6 +170,7 @@ void JsonHandler::registerEnum()
     m_metaFlags.insert(metaFlags.name(), metaFlags);
     m_flagsEnums.insert(metaFlags.name(), metaEnum.name());
     m_flags.insert(metaFlags.name(), QVariantList() << QString("$ref:%1").arg(metaEnum.name()));
+    invalidateSerializers();
 }
 
 template<typename ObjectType>
@@ -195,6 +213,7 @@ void JsonHandler::registerList(BasicTypeName typeName)
     QString listTypeName = QString(listMetaObject.className()).split("::").last();
     m_metaObjects.insert(listTypeName, listMetaObject);
     m_objects.insert(listTypeName, QVariantList() << QVariant(QString("$ref:%1").arg(enumValueName(typeName))));
+    invalidateSerializers();
     Q_ASSERT_X(listMetaObject.indexOfProperty("count") >= 0, "JsonHandler", QString("List type %1 does not implement \"count\" property!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("get(int)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE QVariant get(int index)\" method!").arg(listTypeName).toUtf8());
     Q_ASSERT_X(listMetaObject.indexOfMethod("put(QVariant)") >= 0, "JsonHandler", QString("List type %1 does not implement \"Q_INVOKABLE void put(QVariant variant)\" method!").arg(listTypeName).toUtf8());
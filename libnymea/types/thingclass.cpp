@@ -145,11 +145,11 @@ StateTypes ThingClass::stateTypes() const
  * If there is no matching \l{StateType}, an invalid \l{StateType} will be returned.*/
 StateType ThingClass::getStateType(const StateTypeId &stateTypeId)
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId)
-            return stateType;
+    int index = stateTypeIndex(stateTypeId);
+    if (index < 0) {
+        return StateType(StateTypeId());
     }
-    return StateType(StateTypeId());
+    return m_stateTypes.at(index);
 }
 
 /*! Set the \a stateTypes of this DeviceClass. \{Device}{Devices} created
@@ -157,17 +157,29 @@ StateType ThingClass::getStateType(const StateTypeId &stateTypeId)
 void ThingClass::setStateTypes(const StateTypes &stateTypes)
 {
     m_stateTypes = stateTypes;
+
+    QHash<StateTypeId, int> *indexes = new QHash<StateTypeId, int>();
+    indexes->reserve(m_stateTypes.count());
+    for (int i = 0; i < m_stateTypes.count(); i++) {
+        indexes->insert(m_stateTypes.at(i).id(), i);
+    }
+    m_stateTypeIndexes = QSharedPointer<const QHash<StateTypeId, int>>(indexes);
 }
 
 /*! Returns true if this DeviceClass has a \l{StateType} with the given \a stateTypeId. */
 bool ThingClass::hasStateType(const StateTypeId &stateTypeId)
 {
-    foreach (const StateType &stateType, m_stateTypes) {
-        if (stateType.id() == stateTypeId) {
-            return true;
-        }
+    return stateTypeIndex(stateTypeId) >= 0;
+}
+
+/*! Returns the position of the \l{StateType} with the given  stateTypeId in stateTypes() or -1
+    if this ThingClass has no such StateType. */
+int ThingClass::stateTypeIndex(const StateTypeId &stateTypeId) const
+{
+    if (!m_stateTypeIndexes) {
+        return -1;
     }
-    return false;
+    return m_stateTypeIndexes->value(stateTypeId, -1);
 }
 
 /*! Returns the eventTypes of this DeviceClass. \{Device}{Devices} created
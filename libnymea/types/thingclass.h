@@ -41,6 +41,8 @@
 
 #include <QList>
 #include <QUuid>
+#include <QHash>
+#include <QSharedPointer>
 
 class LIBNYMEA_EXPORT ThingClass
 {
@@ -99,6 +101,7 @@ public:
     StateType getStateType(const StateTypeId &stateTypeId);
     void setStateTypes(const StateTypes &stateTypes);
     bool hasStateType(const StateTypeId &stateTypeId);
+    int stateTypeIndex(const StateTypeId &stateTypeId) const;
 
     EventTypes eventTypes() const;
     void setEventTypes(const EventTypes &eventTypes);
@@ -143,6 +146,8 @@ private:
     QString m_displayName;
     bool m_browsable = false;
     StateTypes m_stateTypes;
+    // Position of each state type in m_stateTypes, shared by all copies of this class
+    QSharedPointer<const QHash<StateTypeId, int>> m_stateTypeIndexes;
     EventTypes m_eventTypes;
     ActionTypes m_actionTypes;
     ActionTypes m_browserItemActionTypes;
@@ -15,6 +15,7 @@ SUBDIRS = \
         plugins \
         rules \
         scripts \
+        sendqueue \
         states \
         tags \
         timemanager \
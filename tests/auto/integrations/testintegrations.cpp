@@ -152,6 +152,11 @@ private slots:
     void removeAutoThing();
 
     void discoverThingsParenting();
+
+    void benchmarkLookups_data();
+    void benchmarkLookups();
+
+    void benchmarkPackThingClasses();
 };
 
 void TestIntegrations::initTestCase()
@@ -2230,6 +2235,101 @@ void TestIntegrations::testTranslations()
 
 }
 
+void TestIntegrations::benchmarkLookups_data()
+{
+    QTest::addColumn<QString>("lookup");
+
+    QTest::newRow("findConfiguredThing") << "findConfiguredThing";
+    QTest::newRow("findThingClass") << "findThingClass";
+    QTest::newRow("findConfiguredThings(thingClassId)") << "thingClassId";
+    QTest::newRow("findConfiguredThings(interface)") << "interface";
+    QTest::newRow("findChilds") << "findChilds";
+    QTest::newRow("stateValue") << "stateValue";
+}
+
+void TestIntegrations::benchmarkLookups()
+{
+    QFETCH(QString, lookup);
+
+    ThingManager *thingManager = NymeaCore::instance()->thingManager();
+    Thing *mockThing = thingManager->findConfiguredThing(m_mockThingId);
+    QVERIFY(mockThing);
+
+    // The indexes must match what a full scan of the configured things returns
+    int thingClassCount = 0;
+    int interfaceCount = 0;
+    int childCount = 0;
+    foreach (Thing *thing, thingManager->configuredThings()) {
+        if (thing->thingClassId() == mockThingClassId) {
+            thingClassCount++;
+        }
+        if (thingManager->findThingClass(thing->thingClassId()).interfaces().contains("light")) {
+            interfaceCount++;
+        }
+        if (thing->parentId() == m_mockThingId) {
+            childCount++;
+        }
+    }
+    QCOMPARE(thingManager->findConfiguredThings(mockThingClassId).count(), thingClassCount);
+    QCOMPARE(thingManager->findConfiguredThings(QString("light")).count(), interfaceCount);
+    QCOMPARE(thingManager->findChilds(m_mockThingId).count(), childCount);
+
+    // States are laid out like the state types of the thing class
+    StateTypes stateTypes = thingManager->findThingClass(mockThingClassId).stateTypes();
+    QCOMPARE(mockThing->states().count(), stateTypes.count());
+    for (int i = 0; i < stateTypes.count(); i++) {
+        QVERIFY(mockThing->hasState(stateTypes.at(i).id()));
+        QCOMPARE(mockThing->state(stateTypes.at(i).id()).stateTypeId(), stateTypes.at(i).id());
+        QCOMPARE(mockThing->stateValue(stateTypes.at(i).id()), mockThing->states().at(i).value());
+    }
+    QVERIFY(!mockThing->hasState(StateTypeId::createStateTypeId()));
+
+    if (lookup == "findConfiguredThing") {
+        QBENCHMARK {
+            thingManager->findConfiguredThing(m_mockThingId);
+        }
+    } else if (lookup == "findThingClass") {
+        QBENCHMARK {
+            thingManager->findThingClass(mockThingClassId);
+        }
+    } else if (lookup == "thingClassId") {
+        QBENCHMARK {
+            thingManager->findConfiguredThings(mockThingClassId);
+        }
+    } else if (lookup == "interface") {
+        QBENCHMARK {
+            thingManager->findConfiguredThings(QString("light"));
+        }
+    } else if (lookup == "findChilds") {
+        QBENCHMARK {
+            thingManager->findChilds(m_mockThingId);
+        }
+    } else if (lookup == "stateValue") {
+        QBENCHMARK {
+            mockThing->stateValue(mockIntStateTypeId);
+        }
+    }
+}
+
+void TestIntegrations::benchmarkPackThingClasses()
+{
+    IntegrationsHandler handler(NymeaCore::instance()->thingManager());
+    ThingClasses thingClasses = NymeaCore::instance()->thingManager()->supportedThings();
+
+    QVariantList packed = handler.pack(thingClasses).toList();
+    QCOMPARE(packed.count(), thingClasses.count());
+    for (int i = 0; i < thingClasses.count(); i++) {
+        QVariantMap thingClassMap = packed.at(i).toMap();
+        QCOMPARE(thingClassMap.value("id").toUuid(), QUuid(thingClasses.at(i).id()));
+        QCOMPARE(thingClassMap.value("setupMethod").toString(), enumValueName(thingClasses.at(i).setupMethod()));
+        QCOMPARE(thingClassMap.value("stateTypes").toList().count(), thingClasses.at(i).stateTypes().count());
+    }
+
+    QBENCHMARK {
+        handler.pack(thingClasses);
+    }
+}
+
 #include "testintegrations.moc"
 QTEST_MAIN(TestIntegrations)
 
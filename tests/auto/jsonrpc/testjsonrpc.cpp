@@ -35,6 +35,13 @@
 #include "servers/mocktcpserver.h"
 #include "usermanager/usermanager.h"
 #include "nymeadbusservice.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+#include "cloud/cloudmanager.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,12,0)
+#include <QCborValue>
+#include <QCborMap>
+#endif
 
 using namespace nymeaserver;
 
@@ -76,6 +83,12 @@ private slots:
 
     void stateChangeEmitsNotifications();
 
+    void notificationFilter();
+
+    void notificationCoalescing();
+
+    void slowClientNotificationCoalescing();
+
     void pluginConfigChangeEmitsNotification();
 
     /*
@@ -118,6 +131,25 @@ private slots:
 
     void testGarbageData();
 
+    void testPipelinedRequests();
+    void testStrayDataBetweenMessages();
+
+    void testBatchRequests();
+
+    void testReplyETags();
+
+    void testSendQueues();
+
+    void testCompression();
+
+    void benchmarkNotifications_data();
+    void benchmarkNotifications();
+
+    void benchmarkValidation();
+
+    void benchmarkEncodings_data();
+    void benchmarkEncodings();
+
 private:
     QStringList extractRefs(const QVariant &variant);
 
@@ -1018,6 +1050,210 @@ void TestJSONRPC::stateChangeEmitsNotifications()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), newVal);
 }
 
+void TestJSONRPC::notificationFilter()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariant response = injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QVariantMap params;
+    params.insert("namespaces", QVariantList() << "Integrations");
+    response = injectAndWait("JSONRPC.SetNotificationStatus", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QVariantMap filter;
+    filter.insert("thingIds", QVariantList() << m_mockThingId);
+    filter.insert("interfaces", QVariantList() << "light");
+    filter.insert("stateTypeIds", QVariantList() << mockIntStateTypeId);
+    filter.insert("minValueChange", 5);
+    params.clear();
+    params.insert("filter", filter);
+    response = injectAndWait("JSONRPC.SetNotificationFilter", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("filter").toMap().value("minValueChange").toDouble(), 5.0);
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    int intValue = thing->stateValue(mockIntStateTypeId).toInt();
+    bool boolValue = thing->stateValue(mockBoolStateTypeId).toBool();
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    auto stateChanges = [&spy, clientId]() {
+        QVariantList stateChanges;
+        for (int i = 0; i < spy.count(); i++) {
+            if (spy.at(i).at(0).toUuid() != clientId) {
+                continue;
+            }
+            QVariantMap notification = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray()).toVariant().toMap();
+            if (notification.value("notification").toString() == "Integrations.StateChanged") {
+                stateChanges.append(notification.value("params"));
+            }
+        }
+        return stateChanges;
+    };
+
+    thing->setStateValue(mockIntStateTypeId, intValue + 10);
+    // Below the threshold
+    thing->setStateValue(mockIntStateTypeId, intValue + 12);
+    thing->setStateValue(mockIntStateTypeId, intValue + 20);
+    // Not in the state type filter
+    thing->setStateValue(mockBoolStateTypeId, !boolValue);
+
+    QList<int> values;
+    foreach (const QVariant &stateChange, stateChanges()) {
+        QCOMPARE(stateChange.toMap().value("thingId").toUuid(), QUuid(m_mockThingId));
+        QCOMPARE(stateChange.toMap().value("stateTypeId").toUuid(), QUuid(mockIntStateTypeId));
+        values.append(stateChange.toMap().value("value").toInt());
+    }
+    QCOMPARE(values, QList<int>() << intValue + 10 << intValue + 20);
+
+    // Things not implementing any of the interfaces are filtered out
+    filter.clear();
+    filter.insert("interfaces", QVariantList() << "weather");
+    params.insert("filter", filter);
+    response = injectAndWait("JSONRPC.SetNotificationFilter", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    spy.clear();
+    thing->setStateValue(mockBoolStateTypeId, boolValue);
+    QVERIFY(stateChanges().isEmpty());
+
+    // Without a filter all state changes are sent again
+    response = injectAndWait("JSONRPC.SetNotificationFilter", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    spy.clear();
+    thing->setStateValue(mockIntStateTypeId, intValue);
+    QCOMPARE(stateChanges().count(), 1);
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::notificationCoalescing()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariant response = injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QVariantMap params;
+    params.insert("namespaces", QVariantList() << "Integrations");
+    response = injectAndWait("JSONRPC.SetNotificationStatus", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QVariantMap filter;
+    filter.insert("coalescingInterval", 100);
+    filter.insert("batchStateChanges", true);
+    params.clear();
+    params.insert("filter", filter);
+    response = injectAndWait("JSONRPC.SetNotificationFilter", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    int intValue = thing->stateValue(mockIntStateTypeId).toInt();
+    bool boolValue = thing->stateValue(mockBoolStateTypeId).toBool();
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    for (int i = 1; i <= 10; i++) {
+        thing->setStateValue(mockIntStateTypeId, intValue + i);
+    }
+    thing->setStateValue(mockBoolStateTypeId, !boolValue);
+
+    // Nothing is sent before the coalescing interval has passed
+    for (int i = 0; i < spy.count(); i++) {
+        QVERIFY(spy.at(i).at(0).toUuid() != clientId);
+    }
+
+    QVariantList batches;
+    for (int i = 0; i < 10 && batches.isEmpty(); i++) {
+        spy.wait(50);
+        for (int j = 0; j < spy.count(); j++) {
+            if (spy.at(j).at(0).toUuid() != clientId) {
+                continue;
+            }
+            QVariantMap notification = QJsonDocument::fromJson(spy.at(j).at(1).toByteArray()).toVariant().toMap();
+            QVERIFY2(notification.value("notification").toString() != "Integrations.StateChanged", "State change was not coalesced");
+            if (notification.value("notification").toString() == "Integrations.StateChangedBatch") {
+                batches.append(notification.value("params"));
+            }
+        }
+    }
+    QCOMPARE(batches.count(), 1);
+
+    // Only the latest value of each state, in the order they changed first
+    QVariantList stateChanges = batches.first().toMap().value("stateChanges").toList();
+    QCOMPARE(stateChanges.count(), 2);
+    QCOMPARE(stateChanges.at(0).toMap().value("stateTypeId").toUuid(), QUuid(mockIntStateTypeId));
+    QCOMPARE(stateChanges.at(0).toMap().value("value").toInt(), intValue + 10);
+    QCOMPARE(stateChanges.at(1).toMap().value("stateTypeId").toUuid(), QUuid(mockBoolStateTypeId));
+    QCOMPARE(stateChanges.at(1).toMap().value("value").toBool(), !boolValue);
+
+    thing->setStateValue(mockIntStateTypeId, intValue);
+    thing->setStateValue(mockBoolStateTypeId, boolValue);
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::slowClientNotificationCoalescing()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariant response = injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QVariantMap params;
+    params.insert("namespaces", QVariantList() << "Integrations");
+    response = injectAndWait("JSONRPC.SetNotificationStatus", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_mockThingId);
+    QVERIFY(thing);
+    int intValue = thing->stateValue(mockIntStateTypeId).toInt();
+
+    auto stateChanges = [clientId](const QSignalSpy &spy) {
+        QVariantList values;
+        for (int i = 0; i < spy.count(); i++) {
+            if (spy.at(i).at(0).toUuid() != clientId) {
+                continue;
+            }
+            QVariantMap notification = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray()).toVariant().toMap();
+            if (notification.value("notification").toString() == "Integrations.StateChanged") {
+                values.append(notification.value("params").toMap().value("value"));
+            }
+        }
+        return values;
+    };
+
+    // Pretend the client doesn't read its data
+    m_mockTcpServer->setBytesToWrite(clientId, 1024 * 1024);
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    for (int i = 1; i <= 10; i++) {
+        thing->setStateValue(mockIntStateTypeId, intValue + i);
+    }
+    QVERIFY(stateChanges(spy).isEmpty());
+
+    // Still not reading, nothing must be sent
+    spy.wait(1500);
+    QVERIFY(stateChanges(spy).isEmpty());
+
+    // Once the buffer drained, only the latest value arrives
+    m_mockTcpServer->setBytesToWrite(clientId, 0);
+    for (int i = 0; i < 20 && stateChanges(spy).isEmpty(); i++) {
+        spy.wait(100);
+    }
+    QCOMPARE(stateChanges(spy).count(), 1);
+    QCOMPARE(stateChanges(spy).first().toInt(), intValue + 10);
+
+    // And it's back to immediate notifications
+    spy.clear();
+    thing->setStateValue(mockIntStateTypeId, intValue);
+    QCOMPARE(stateChanges(spy).count(), 1);
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
 void TestJSONRPC::pluginConfigChangeEmitsNotification()
 {
     QSignalSpy clientSpy(m_mockTcpServer, SIGNAL(outgoingData(QUuid,QByteArray)));
@@ -1388,6 +1624,464 @@ void TestJSONRPC::testGarbageData()
     QCOMPARE(spy.count(), 1);
 }
 
+void TestJSONRPC::testPipelinedRequests()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariant response = injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    // Send many requests in a single chunk, only some of them separated by newlines
+    QByteArray data;
+    QList<int> expectedIds;
+    for (int i = 0; i < 100; i++) {
+        data.append(QString("{\"id\": %1, \"token\": \"%2\", \"method\": \"JSONRPC.Version\"}").arg(1000 + i).arg(QString(m_apiToken)).toUtf8());
+        if (i % 3 == 0) {
+            data.append("\n");
+        }
+        expectedIds.append(1000 + i);
+    }
+    // Braces and escaped quotes within strings must not confuse the framing
+    data.append(QString("{\"id\": 2000, \"token\": \"%1\", \"method\": \"JSONRPC.Version\", \"params\": {}, \"dummy\": \"}{ \\\"}\\\\\"}\n").arg(QString(m_apiToken)).toUtf8());
+    expectedIds.append(2000);
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    m_mockTcpServer->injectData(clientId, data);
+    while (spy.count() < expectedIds.count() && spy.wait()) { }
+
+    QList<int> ids;
+    for (int i = 0; i < spy.count(); i++) {
+        if (spy.at(i).at(0).toUuid() != clientId) {
+            continue;
+        }
+        QVariantMap reply = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray()).toVariant().toMap();
+        QCOMPARE(reply.value("status").toString(), QString("success"));
+        ids.append(reply.value("id").toInt());
+    }
+    QCOMPARE(ids, expectedIds);
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::testStrayDataBetweenMessages()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariant response = injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    // Data which is not part of a message is reported and must not break the following message
+    QByteArray data("garbage\n");
+    data.append(QString("{\"id\": 42, \"token\": \"%1\", \"method\": \"JSONRPC.Version\"}\n").arg(QString(m_apiToken)).toUtf8());
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    m_mockTcpServer->injectData(clientId, data);
+    while (spy.count() < 2 && spy.wait()) { }
+    QCOMPARE(spy.count(), 2);
+
+    QVariantMap reply = QJsonDocument::fromJson(spy.at(0).at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(reply.value("status").toString(), QString("error"));
+    reply = QJsonDocument::fromJson(spy.at(1).at(1).toByteArray()).toVariant().toMap();
+    QCOMPARE(reply.value("id").toInt(), 42);
+    QCOMPARE(reply.value("status").toString(), QString("success"));
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::testBatchRequests()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariant response = injectAndWait("JSONRPC.Hello", QVariantMap(), clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    // Sync calls, an invalid call and an async call in one batch
+    QVariantList batch;
+    QVariantMap request;
+    request.insert("token", QString(m_apiToken));
+    request.insert("id", 1);
+    request.insert("method", "JSONRPC.Version");
+    batch.append(request);
+    request.insert("id", 2);
+    request.insert("method", "Integrations.GetThings");
+    batch.append(request);
+    request.insert("id", 3);
+    request.insert("method", "Foo.Bar");
+    batch.append(request);
+    QVariantMap actionParams;
+    actionParams.insert("thingId", m_mockThingId.toString());
+    actionParams.insert("actionTypeId", mockAsyncActionTypeId.toString());
+    request.insert("id", 4);
+    request.insert("method", "Integrations.ExecuteAction");
+    request.insert("params", actionParams);
+    batch.append(request);
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    m_mockTcpServer->injectData(clientId, QJsonDocument::fromVariant(batch).toJson(QJsonDocument::Compact));
+
+    // The sync replies arrive in one frame, the async reply on its own once the action finished
+    QVariantList syncReplies;
+    QVariantMap asyncReply;
+    while (asyncReply.isEmpty() && spy.wait()) {
+        for (int i = 0; i < spy.count(); i++) {
+            if (spy.at(i).at(0).toUuid() != clientId) {
+                continue;
+            }
+            QVariant reply = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray()).toVariant();
+            if (reply.type() == QVariant::List) {
+                QVERIFY2(syncReplies.isEmpty(), "Sync replies were not sent in a single frame");
+                syncReplies = reply.toList();
+            } else if (reply.toMap().value("id").toInt() == 4) {
+                asyncReply = reply.toMap();
+            }
+        }
+        spy.clear();
+    }
+
+    QCOMPARE(syncReplies.count(), 3);
+    QCOMPARE(syncReplies.at(0).toMap().value("id").toInt(), 1);
+    QCOMPARE(syncReplies.at(0).toMap().value("status").toString(), QString("success"));
+    QCOMPARE(syncReplies.at(1).toMap().value("id").toInt(), 2);
+    QCOMPARE(syncReplies.at(1).toMap().value("status").toString(), QString("success"));
+    QCOMPARE(syncReplies.at(2).toMap().value("id").toInt(), 3);
+    QCOMPARE(syncReplies.at(2).toMap().value("status").toString(), QString("error"));
+    QCOMPARE(asyncReply.value("status").toString(), QString("success"));
+    QCOMPARE(asyncReply.value("params").toMap().value("thingError").toString(), enumValueName(Thing::ThingErrorNoError));
+
+    // An empty batch is an error
+    spy.clear();
+    m_mockTcpServer->injectData(clientId, "[]");
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(QJsonDocument::fromJson(spy.at(0).at(1).toByteArray()).toVariant().toMap().value("status").toString(), QString("error"));
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::testReplyETags()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+    QVariantMap helloParams;
+    helloParams.insert("locale", "de_DE");
+    QVariant response = injectAndWait("JSONRPC.Hello", helloParams, clientId);
+    QVariantMap etags = response.toMap().value("params").toMap().value("etags").toMap();
+    QVERIFY2(etags.contains("JSONRPC.Introspect"), "Introspect ETag missing in Hello reply");
+    QVERIFY2(etags.contains("Integrations.GetVendors"), "GetVendors ETag missing in Hello reply");
+    QVERIFY2(etags.contains("Integrations.GetThingClasses"), "GetThingClasses ETag missing in Hello reply");
+    QVERIFY2(etags.contains("Integrations.GetPlugins"), "GetPlugins ETag missing in Hello reply");
+
+    // Without ifNoneMatch the data is returned along with the same ETag
+    response = injectAndWait("Integrations.GetThingClasses", QVariantMap(), clientId);
+    QVariantMap replyParams = response.toMap().value("params").toMap();
+    QCOMPARE(replyParams.value("etag").toString(), etags.value("Integrations.GetThingClasses").toString());
+    QVERIFY(!replyParams.value("thingClasses").toList().isEmpty());
+    QVERIFY(!replyParams.contains("notModified"));
+
+    // A matching ETag skips the data
+    QVariantMap params;
+    params.insert("ifNoneMatch", etags.value("Integrations.GetThingClasses"));
+    response = injectAndWait("Integrations.GetThingClasses", params, clientId);
+    replyParams = response.toMap().value("params").toMap();
+    QCOMPARE(replyParams.value("notModified").toBool(), true);
+    QCOMPARE(replyParams.value("thingError").toString(), enumValueName(Thing::ThingErrorNoError));
+    QVERIFY(!replyParams.contains("thingClasses"));
+
+    // A stale ETag returns the data
+    params.insert("ifNoneMatch", "stale");
+    response = injectAndWait("Integrations.GetVendors", params, clientId);
+    replyParams = response.toMap().value("params").toMap();
+    QCOMPARE(replyParams.value("etag").toString(), etags.value("Integrations.GetVendors").toString());
+    QVERIFY(!replyParams.value("vendors").toList().isEmpty());
+
+    // The ETag depends on the locale
+    helloParams.insert("locale", "en_US");
+    response = injectAndWait("JSONRPC.Hello", helloParams, clientId);
+    QVariantMap englishETags = response.toMap().value("params").toMap().value("etags").toMap();
+    QVERIFY(englishETags.value("Integrations.GetThingClasses") != etags.value("Integrations.GetThingClasses"));
+    QCOMPARE(englishETags.value("JSONRPC.Introspect"), etags.value("JSONRPC.Introspect"));
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::testSendQueues()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+
+    // Every connected client is listed, the mock transport never queues any messages
+    QVariant response = injectAndWait("System.GetSendQueues", QVariantMap(), clientId);
+    QVariantList sendQueues = response.toMap().value("params").toMap().value("sendQueues").toList();
+    QStringList clientIds;
+    foreach (const QVariant &sendQueueVariant, sendQueues) {
+        QVariantMap sendQueue = sendQueueVariant.toMap();
+        clientIds.append(sendQueue.value("clientId").toUuid().toString());
+        QCOMPARE(sendQueue.value("queuedMessages").toInt(), 0);
+        QCOMPARE(sendQueue.value("queuedBytes").toInt(), 0);
+        QCOMPARE(sendQueue.value("droppedNotifications").toInt(), 0);
+        QCOMPARE(sendQueue.value("coalescedNotifications").toInt(), 0);
+    }
+    QVERIFY2(clientIds.contains(clientId.toString()), "Send queue of the client missing");
+    QVERIFY2(clientIds.contains(m_clientId.toString()), "Send queue of the test client missing");
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+
+    response = injectAndWait("System.GetSendQueues");
+    sendQueues = response.toMap().value("params").toMap().value("sendQueues").toList();
+    foreach (const QVariant &sendQueueVariant, sendQueues) {
+        QVERIFY2(sendQueueVariant.toMap().value("clientId").toUuid() != clientId, "Send queue of a disconnected client listed");
+    }
+}
+
+void TestJSONRPC::testCompression()
+{
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+
+    // The Hello reply is still uncompressed
+    QVariantMap params;
+    params.insert("compression", enumValueName(JsonRPCServerImplementation::MessageCompressionDeflate));
+    QVariant response = injectAndWait("JSONRPC.Hello", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("compression").toString(), enumValueName(JsonRPCServerImplementation::MessageCompressionDeflate));
+
+    QVariantMap call;
+    call.insert("id", 1);
+    call.insert("token", m_apiToken);
+    call.insert("method", "Integrations.GetThingClasses");
+    QByteArray request = QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact);
+
+    // Large replies are compressed
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    m_mockTcpServer->injectData(clientId, qCompress(request).prepend('\1'));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    QByteArray payload = spy.first().at(1).toByteArray();
+    QCOMPARE(payload.at(0), '\1');
+    QByteArray data = qUncompress(payload.mid(1));
+    QVERIFY2(data.size() > payload.size(), "Reply has not been compressed");
+    QVariantMap reply = QJsonDocument::fromJson(data).toVariant().toMap();
+    QCOMPARE(reply.value("id").toInt(), 1);
+    QVERIFY(!reply.value("params").toMap().value("thingClasses").toList().isEmpty());
+
+    // Small replies are sent uncompressed
+    call.insert("id", 2);
+    call.insert("method", "JSONRPC.Version");
+    request = QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact);
+    spy.clear();
+    m_mockTcpServer->injectData(clientId, request.prepend('\0'));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    payload = spy.first().at(1).toByteArray();
+    QCOMPARE(payload.at(0), '\0');
+    reply = QJsonDocument::fromJson(payload.mid(1)).toVariant().toMap();
+    QCOMPARE(reply.value("id").toInt(), 2);
+    QCOMPARE(reply.value("status").toString(), QString("success"));
+
+    // Invalid compressed data is rejected
+    spy.clear();
+    m_mockTcpServer->injectData(clientId, QByteArray("\1garbage"));
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QCOMPARE(spy.count(), 1);
+    payload = spy.first().at(1).toByteArray();
+    reply = QJsonDocument::fromJson(payload.mid(1)).toVariant().toMap();
+    QCOMPARE(reply.value("status").toString(), QString("error"));
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+}
+
+void TestJSONRPC::benchmarkNotifications_data()
+{
+    QTest::addColumn<int>("clients");
+
+    QTest::newRow("1 client") << 1;
+    QTest::newRow("10 clients") << 10;
+    QTest::newRow("30 clients") << 30;
+}
+
+void TestJSONRPC::benchmarkNotifications()
+{
+    QFETCH(int, clients);
+
+    // Connect the clients with two different locales and subscribe them to JSONRPC notifications
+    QList<QUuid> clientIds;
+    for (int i = 0; i < clients; i++) {
+        QUuid clientId = QUuid::createUuid();
+        emit m_mockTcpServer->clientConnected(clientId);
+
+        QVariantMap params;
+        params.insert("locale", i % 2 == 0 ? "en_US" : "de_DE");
+        QVariant response = injectAndWait("JSONRPC.Hello", params, clientId);
+        QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+        params.clear();
+        params.insert("namespaces", QVariantList() << "JSONRPC");
+        response = injectAndWait("JSONRPC.SetNotificationStatus", params, clientId);
+        QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+        clientIds.append(clientId);
+    }
+
+    QVariantMap params;
+    params.insert("connected", false);
+    params.insert("connectionState", enumValueName(CloudManager::CloudConnectionStateDisabled));
+
+    // Make sure each subscribed client gets exactly one notification
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    emit NymeaCore::instance()->jsonRPCServer()->CloudConnectedChanged(params);
+    QList<QUuid> receivers;
+    for (int i = 0; i < spy.count(); i++) {
+        QVariantMap notification = QJsonDocument::fromJson(spy.at(i).at(1).toByteArray()).toVariant().toMap();
+        QCOMPARE(notification.value("notification").toString(), QString("JSONRPC.CloudConnectedChanged"));
+        QCOMPARE(notification.value("params").toMap(), params);
+        receivers.append(spy.at(i).at(0).toUuid());
+    }
+    foreach (const QUuid &clientId, clientIds) {
+        QCOMPARE(receivers.count(clientId), 1);
+    }
+
+    QBENCHMARK {
+        emit NymeaCore::instance()->jsonRPCServer()->CloudConnectedChanged(params);
+    }
+
+    foreach (const QUuid &clientId, clientIds) {
+        emit m_mockTcpServer->clientDisconnected(clientId);
+    }
+}
+
+void TestJSONRPC::benchmarkValidation()
+{
+    QVariantMap api = injectAndWait("JSONRPC.Introspect").toMap().value("params").toMap();
+    JsonValidator validator;
+    validator.compile(api);
+
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("thingId", m_mockThingId);
+    stateDescriptor.insert("stateTypeId", mockIntStateTypeId);
+    stateDescriptor.insert("operator", enumValueName(Types::ValueOperatorGreater));
+    stateDescriptor.insert("value", 20);
+    QVariantMap childEvaluator;
+    childEvaluator.insert("stateDescriptor", stateDescriptor);
+    QVariantMap stateEvaluator;
+    stateEvaluator.insert("operator", enumValueName(Types::StateOperatorAnd));
+    stateEvaluator.insert("childEvaluators", QVariantList() << childEvaluator << childEvaluator);
+
+    QVariantMap ruleActionParam;
+    ruleActionParam.insert("paramTypeId", mockWithParamsActionParam1ParamTypeId);
+    ruleActionParam.insert("value", 5);
+    QVariantMap action;
+    action.insert("thingId", m_mockThingId);
+    action.insert("actionTypeId", mockWithParamsActionTypeId);
+    action.insert("ruleActionParams", QVariantList() << ruleActionParam);
+
+    QVariantMap params;
+    params.insert("name", "Validation benchmark");
+    params.insert("stateEvaluator", stateEvaluator);
+    params.insert("actions", QVariantList() << action);
+
+    JsonValidator::Result result = validator.validateParams(params, "Rules.AddRule");
+    QVERIFY2(result.success(), qUtf8Printable(result.errorString() + " in " + result.where()));
+
+    // Optional and deprecated keys are resolved, unknown ones and missing required ones are not
+    stateDescriptor.insert("deviceId", m_mockThingId);
+    childEvaluator.insert("stateDescriptor", stateDescriptor);
+    stateEvaluator.insert("childEvaluators", QVariantList() << childEvaluator);
+    params.insert("stateEvaluator", stateEvaluator);
+    QVERIFY(validator.validateParams(params, "Rules.AddRule").success());
+
+    QVariantMap invalidParams = params;
+    invalidParams.remove("name");
+    result = validator.validateParams(invalidParams, "Rules.AddRule");
+    QVERIFY(!result.success());
+    QCOMPARE(result.errorString(), QString("Missing required key: name"));
+
+    invalidParams = params;
+    invalidParams.insert("foo", "bar");
+    QVERIFY(!validator.validateParams(invalidParams, "Rules.AddRule").success());
+
+    stateDescriptor.insert("operator", "ValueOperatorInvalid");
+    childEvaluator.insert("stateDescriptor", stateDescriptor);
+    stateEvaluator.insert("childEvaluators", QVariantList() << childEvaluator);
+    invalidParams = params;
+    invalidParams.insert("stateEvaluator", stateEvaluator);
+    result = validator.validateParams(invalidParams, "Rules.AddRule");
+    QVERIFY(!result.success());
+    QCOMPARE(result.where(), QString("Rules.AddRule, param stateEvaluator.childEvaluators.stateDescriptor.operator."));
+
+    QCOMPARE(validator.statistics().validations, 5ull);
+    QCOMPARE(validator.statistics().failures, 3ull);
+
+    QBENCHMARK {
+        validator.validateParams(params, "Rules.AddRule");
+    }
+}
+
+void TestJSONRPC::benchmarkEncodings_data()
+{
+    QTest::addColumn<QString>("encoding");
+
+    QTest::newRow("JSON") << enumValueName(JsonRPCServerImplementation::MessageEncodingJson);
+    QTest::newRow("CBOR") << enumValueName(JsonRPCServerImplementation::MessageEncodingCbor);
+}
+
+void TestJSONRPC::benchmarkEncodings()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,12,0)
+    QSKIP("CBOR encoding requires Qt 5.12");
+#else
+    QFETCH(QString, encoding);
+    bool cbor = encoding == enumValueName(JsonRPCServerImplementation::MessageEncodingCbor);
+
+    QUuid clientId = QUuid::createUuid();
+    emit m_mockTcpServer->clientConnected(clientId);
+
+    // The Hello reply still uses JSON, everything after it uses the negotiated encoding
+    QVariantMap params;
+    params.insert("encoding", encoding);
+    QVariant response = injectAndWait("JSONRPC.Hello", params, clientId);
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(response.toMap().value("params").toMap().value("encoding").toString(), encoding);
+
+    QVariantMap call;
+    call.insert("id", 1);
+    call.insert("token", m_apiToken);
+    call.insert("method", "Integrations.GetThingClasses");
+    params.clear();
+    params.insert("vendorId", nymeaVendorId.toString());
+    call.insert("params", params);
+    QByteArray request = cbor ? QCborValue(QCborMap::fromVariantMap(call)).toCbor()
+                              : QJsonDocument::fromVariant(call).toJson(QJsonDocument::Compact) + '\n';
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::outgoingData);
+    QByteArray payload;
+    QVariantMap reply;
+    QBENCHMARK {
+        spy.clear();
+        m_mockTcpServer->injectData(clientId, request);
+        if (spy.count() == 0) {
+            spy.wait();
+        }
+        QCOMPARE(spy.count(), 1);
+        payload = spy.first().at(1).toByteArray();
+        reply = cbor ? QCborValue::fromCbor(payload).toMap().toVariantMap()
+                     : QJsonDocument::fromJson(payload).toVariant().toMap();
+    }
+    QCOMPARE(reply.value("id").toInt(), 1);
+    QCOMPARE(reply.value("status").toString(), QString("success"));
+    QVERIFY(!reply.value("params").toMap().value("thingClasses").toList().isEmpty());
+    qDebug() << encoding << "payload size:" << payload.size() << "bytes";
+
+    emit m_mockTcpServer->clientDisconnected(clientId);
+#endif
+}
+
 #include "testjsonrpc.moc"
 
 QTEST_MAIN(TestJSONRPC)
@@ -83,6 +83,8 @@ private slots:
 
     void testLimits();
 
+    void aggregatedValues();
+
     // this has to be the last test
     void removeThing();
 };
@@ -709,6 +711,92 @@ void TestLogging::testLimits()
     response = injectAndWait("Logging.GetLogEntries", params).toMap();
     QCOMPARE(response.value("params").toMap().value("count").toInt(), 10);
     QCOMPARE(response.value("params").toMap().value("logEntries").toList().count(), 10);
+
+    // Page through all entries using the cursor, should return 20, 20 and 10 entries
+    QStringList values;
+    QList<int> pageSizes;
+    QString cursor;
+    do {
+        params.clear();
+        params.insert("limit", 20);
+        if (!cursor.isEmpty()) {
+            params.insert("cursor", cursor);
+        }
+        response = injectAndWait("Logging.GetLogEntries", params).toMap();
+        verifyLoggingError(response);
+        QVariantList entries = response.value("params").toMap().value("logEntries").toList();
+        pageSizes.append(entries.count());
+        foreach (const QVariant &entry, entries) {
+            values.append(entry.toMap().value("value").toString());
+        }
+        cursor = response.value("params").toMap().value("nextCursor").toString();
+    } while (!cursor.isEmpty() && pageSizes.count() < 10);
+
+    QCOMPARE(pageSizes, QList<int>() << 20 << 20 << 10);
+    QCOMPARE(values.toSet().count(), 50);
+
+    // Invalid cursor
+    params.clear();
+    params.insert("cursor", "foobar");
+    response = injectAndWait("Logging.GetLogEntries", params).toMap();
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
+}
+
+void TestLogging::aggregatedValues()
+{
+    clearLoggingDatabase();
+
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QList<int> stateValues = QList<int>() << 11 << 22 << 33 << 44;
+    foreach (int stateValue, stateValues) {
+        spy.clear();
+        QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockIntStateTypeId.toString()).arg(stateValue)));
+        QNetworkReply *reply = nam.get(request);
+        connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        spy.wait();
+    }
+
+    waitForDBSync();
+
+    QVariantMap params;
+    params.insert("thingId", m_mockThingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    params.insert("resolution", enumValueName(Logging::AggregationResolution1Day));
+    QVariant response = injectAndWait("Logging.GetAggregatedValues", params);
+    verifyLoggingError(response);
+
+    // All values have been written within a few milliseconds, but may still end up in two buckets around midnight
+    QVariantList buckets = response.toMap().value("params").toMap().value("aggregatedValues").toList();
+    QVERIFY2(buckets.count() >= 1 && buckets.count() <= 2, "Unexpected number of buckets");
+
+    int count = 0;
+    double sum = 0;
+    double minimum = buckets.first().toMap().value("minimum").toDouble();
+    double maximum = buckets.first().toMap().value("maximum").toDouble();
+    foreach (const QVariant &bucket, buckets) {
+        QVariantMap bucketMap = bucket.toMap();
+        count += bucketMap.value("count").toInt();
+        sum += bucketMap.value("average").toDouble() * bucketMap.value("count").toInt();
+        minimum = qMin(minimum, bucketMap.value("minimum").toDouble());
+        maximum = qMax(maximum, bucketMap.value("maximum").toDouble());
+    }
+    QCOMPARE(count, 4);
+    QCOMPARE(minimum, 11.0);
+    QCOMPARE(maximum, 44.0);
+    QCOMPARE(sum / count, 27.5);
+    QCOMPARE(buckets.last().toMap().value("last").toInt(), 44);
+
+    // A time range in the past doesn't contain any values
+    params.insert("endDate", QDateTime::currentDateTime().addDays(-2).toTime_t());
+    response = injectAndWait("Logging.GetAggregatedValues", params);
+    verifyLoggingError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("aggregatedValues").toList().count(), 0);
+
+    // Start after end
+    params.insert("startDate", QDateTime::currentDateTime().addDays(-1).toTime_t());
+    response = injectAndWait("Logging.GetAggregatedValues", params);
+    verifyLoggingError(response, Logging::LoggingErrorInvalidFilterParameter);
 }
 
 void TestLogging::removeThing()
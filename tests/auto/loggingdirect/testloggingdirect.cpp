@@ -41,6 +41,10 @@ public:
     TestLoggingDirect(QObject* parent = nullptr);
 
 private slots:
+    void batchedWrites();
+    void readWhileLogging();
+    void retentionPolicy();
+
     void benchmarkDB_data();
     void benchmarkDB();
 
@@ -56,6 +60,92 @@ TestLoggingDirect::TestLoggingDirect(QObject *parent): QObject(parent)
     QCoreApplication::instance()->setOrganizationName("nymea-test");
 }
 
+void TestLoggingDirect::batchedWrites()
+{
+    engine->setMaxLogEntries(20000, 10);
+    engine->clearDatabase();
+    engine->setWriteBatching(100, 500);
+
+    // A burst of entries must end up in the DB completely and not be dropped
+    QSignalSpy addedSpy(engine, &LogEngine::logEntryAdded);
+    for (int i = 0; i < 2000; i++) {
+        engine->logSystemEvent(QDateTime::currentDateTime(), i % 2 == 0);
+    }
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+    QCOMPARE(addedSpy.count(), 2000);
+
+    LogEntriesFetchJob *job = engine->fetchLogEntries();
+    QSignalSpy fetchSpy(job, &LogEntriesFetchJob::finished);
+    fetchSpy.wait();
+    QCOMPARE(job->results().count(), 2000);
+}
+
+void TestLoggingDirect::readWhileLogging()
+{
+    engine->setMaxLogEntries(20000, 10);
+    engine->clearDatabase();
+    engine->setWriteBatching(0, 10);
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+
+    for (int i = 0; i < 100; i++) {
+        engine->logSystemEvent(QDateTime::currentDateTime(), true);
+    }
+
+    // Entries keep coming in while the read waits, so there is always a batch being written
+    LogEntriesFetchJob *job = engine->fetchLogEntries();
+    int resultCount = -1;
+    connect(job, &LogEntriesFetchJob::finished, this, [&resultCount, job](){
+        resultCount = job->results().count();
+    });
+    QElapsedTimer timer;
+    timer.start();
+    while (resultCount < 0 && timer.elapsed() < 5000) {
+        engine->logSystemEvent(QDateTime::currentDateTime(), true);
+        qApp->processEvents();
+    }
+    QVERIFY2(resultCount >= 100, "The read did not finish or missed entries logged before it");
+
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+    engine->setWriteBatching(250, 500);
+}
+
+void TestLoggingDirect::retentionPolicy()
+{
+    engine->setMaxLogEntries(20000, 10);
+    engine->clearDatabase();
+
+    QDateTime now = QDateTime::currentDateTime();
+    for (int i = 0; i < 1500; i++) {
+        engine->logSystemEvent(now.addDays(-10), true);
+    }
+    for (int i = 0; i < 100; i++) {
+        engine->logSystemEvent(now, true);
+    }
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+
+    // Old entries are deleted in chunks by the housekeeping
+    engine->setRetentionPolicy(Logging::LoggingSourceSystem, 7);
+    QTest::qWait(0);
+    while (engine->jobsRunning()) {
+        qApp->processEvents();
+    }
+
+    LogEntriesFetchJob *job = engine->fetchLogEntries();
+    QSignalSpy fetchSpy(job, &LogEntriesFetchJob::finished);
+    fetchSpy.wait();
+    QCOMPARE(job->results().count(), 100);
+
+    engine->setRetentionPolicy(Logging::LoggingSourceSystem, 0);
+}
+
 void TestLoggingDirect::benchmarkDB_data() {
     QTest::addColumn<int>("prefill");
     QTest::addColumn<int>("maxSize");
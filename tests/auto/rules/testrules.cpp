@@ -33,6 +33,7 @@
 #include "servers/mocktcpserver.h"
 #include "nymeacore.h"
 #include "jsonrpc/jsonhandler.h"
+#include "ruleengine/compiledstateevaluator.h"
 
 using namespace nymeaserver;
 
@@ -136,6 +137,12 @@ private slots:
 
     void testHousekeeping_data();
     void testHousekeeping();
+
+    void benchmarkEvaluateEvent_data();
+    void benchmarkEvaluateEvent();
+
+    void benchmarkEvaluateStates_data();
+    void benchmarkEvaluateStates();
 };
 
 void TestRules::cleanupMockHistory() {
@@ -3256,5 +3263,91 @@ void TestRules::testHousekeeping()
     }
 }
 
+void TestRules::benchmarkEvaluateEvent_data()
+{
+    QTest::addColumn<int>("ruleCount");
+
+    QTest::newRow("10 rules") << 10;
+    QTest::newRow("100 rules") << 100;
+    QTest::newRow("500 rules") << 500;
+}
+
+void TestRules::benchmarkEvaluateEvent()
+{
+    QFETCH(int, ruleCount);
+
+    RuleEngine *ruleEngine = NymeaCore::instance()->ruleEngine();
+
+    // One rule reacting on the event, the others on other events and states of the same thing
+    QList<RuleId> ruleIds;
+    for (int i = 0; i < ruleCount; i++) {
+        Rule rule;
+        rule.setId(RuleId::createRuleId());
+        rule.setName(QString("Benchmark rule %1").arg(i));
+        if (i == 0) {
+            rule.setEventDescriptors(QList<EventDescriptor>() << EventDescriptor(mockEvent1EventTypeId, m_mockThingId));
+        } else if (i % 2 == 0) {
+            rule.setEventDescriptors(QList<EventDescriptor>() << EventDescriptor(mockEvent2EventTypeId, m_mockThingId));
+        } else {
+            rule.setStateEvaluator(StateEvaluator(StateDescriptor(mockIntStateTypeId, m_mockThingId, i, Types::ValueOperatorGreater)));
+        }
+        rule.setActions(QList<RuleAction>() << RuleAction(mockWithoutParamsActionTypeId, m_mockThingId));
+        QCOMPARE(ruleEngine->addRule(rule), RuleEngine::RuleErrorNoError);
+        ruleIds.append(rule.id());
+    }
+
+    Event event(mockEvent1EventTypeId, m_mockThingId);
+    // Settle the newly added rules
+    ruleEngine->evaluateEvent(event);
+
+    QBENCHMARK {
+        QCOMPARE(ruleEngine->evaluateEvent(event).count(), 1);
+    }
+
+    foreach (const RuleId &ruleId, ruleIds) {
+        QCOMPARE(ruleEngine->removeRule(ruleId), RuleEngine::RuleErrorNoError);
+    }
+}
+
+void TestRules::benchmarkEvaluateStates_data()
+{
+    QTest::addColumn<int>("descriptorCount");
+    QTest::addColumn<bool>("compiled");
+
+    QTest::newRow("10 descriptors, interpreted") << 10 << false;
+    QTest::newRow("10 descriptors, compiled") << 10 << true;
+    QTest::newRow("100 descriptors, interpreted") << 100 << false;
+    QTest::newRow("100 descriptors, compiled") << 100 << true;
+}
+
+void TestRules::benchmarkEvaluateStates()
+{
+    QFETCH(int, descriptorCount);
+    QFETCH(bool, compiled);
+
+    // Nested groups of descriptors which are all true, so each of them gets evaluated
+    StateEvaluator stateEvaluator;
+    for (int i = 0; i < descriptorCount / 2; i++) {
+        QList<StateEvaluator> children;
+        children << StateEvaluator(StateDescriptor(mockIntStateTypeId, m_mockThingId, -1000 - i, Types::ValueOperatorGreater));
+        children << StateEvaluator(StateDescriptor(mockIntStateTypeId, m_mockThingId, 1000000 + i, Types::ValueOperatorLessOrEqual));
+        stateEvaluator.appendEvaluator(StateEvaluator(children, Types::StateOperatorAnd));
+    }
+
+    CompiledStateEvaluator compiledStateEvaluator(stateEvaluator, NymeaCore::instance()->thingManager());
+    QVERIFY(stateEvaluator.evaluate());
+    QCOMPARE(compiledStateEvaluator.evaluate(), stateEvaluator.evaluate());
+
+    if (compiled) {
+        QBENCHMARK {
+            compiledStateEvaluator.evaluate();
+        }
+    } else {
+        QBENCHMARK {
+            stateEvaluator.evaluate();
+        }
+    }
+}
+
 #include "testrules.moc"
 QTEST_MAIN(TestRules)
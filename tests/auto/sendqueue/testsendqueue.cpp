@@ -0,0 +1,181 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QtTest>
+
+#include "servers/sendqueue.h"
+
+using namespace nymeaserver;
+
+class TestSendQueue: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void watermarks();
+    void coalesceInPlace();
+    void dropOldestNotifications();
+    void coalesceDisabledForDropOldest();
+    void repliesAreNeverDropped();
+
+private:
+    SendQueue::Message message(SendQueue::MessageType type, const QByteArray &data, const QByteArray &coalescingKey = QByteArray());
+};
+
+SendQueue::Message TestSendQueue::message(SendQueue::MessageType type, const QByteArray &data, const QByteArray &coalescingKey)
+{
+    SendQueue::Message message;
+    message.type = type;
+    message.data = data;
+    message.coalescingKey = coalescingKey;
+    return message;
+}
+
+void TestSendQueue::watermarks()
+{
+    SendQueue::Configuration configuration;
+    configuration.highWatermark = 100;
+    configuration.lowWatermark = 20;
+    SendQueue queue(configuration);
+
+    QVERIFY(queue.canWrite(0));
+    QVERIFY(queue.canWrite(99));
+
+    // Blocked once the high watermark is reached...
+    QVERIFY(!queue.canWrite(100));
+    // ...and stays blocked until drained below the low watermark
+    QVERIFY(!queue.canWrite(50));
+    QVERIFY(!queue.canWrite(21));
+    QVERIFY(queue.canWrite(20));
+
+    // Between the watermarks, writing continues
+    QVERIFY(queue.canWrite(50));
+    QVERIFY(!queue.canWrite(150));
+    QVERIFY(queue.canWrite(0));
+}
+
+void TestSendQueue::coalesceInPlace()
+{
+    SendQueue queue;
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "state a 1", "a"));
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "state b 1", "b"));
+    queue.enqueue(message(SendQueue::MessageTypeReply, "reply"));
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "state a 22", "a"));
+
+    // The newer notification replaces the queued one and keeps its position
+    SendQueue::Statistics statistics = queue.statistics();
+    QCOMPARE(statistics.queuedMessages, 3);
+    QCOMPARE(statistics.coalescedNotifications, quint64(1));
+    QCOMPARE(statistics.droppedNotifications, quint64(0));
+    QCOMPARE(queue.size(), qint64(QByteArray("state a 22state b 1reply").size()));
+
+    QCOMPARE(queue.takeFirst().data, QByteArray("state a 22"));
+    QCOMPARE(queue.takeFirst().data, QByteArray("state b 1"));
+    QCOMPARE(queue.takeFirst().data, QByteArray("reply"));
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.size(), qint64(0));
+
+    // Once sent, a notification with the same key is queued again
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "state a 3", "a"));
+    QCOMPARE(queue.statistics().queuedMessages, 1);
+    QCOMPARE(queue.statistics().coalescedNotifications, quint64(1));
+}
+
+void TestSendQueue::dropOldestNotifications()
+{
+    SendQueue::Configuration configuration;
+    configuration.maxQueueSize = 30;
+    configuration.overflowPolicy = SendQueue::OverflowPolicyDropOldest;
+    SendQueue queue(configuration);
+
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "notification 1"));
+    queue.enqueue(message(SendQueue::MessageTypeReply, "reply 1"));
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "notification 2"));
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "notification 3"));
+
+    // The oldest notifications make room, the reply stays
+    SendQueue::Statistics statistics = queue.statistics();
+    QCOMPARE(statistics.droppedNotifications, quint64(2));
+    QCOMPARE(statistics.queuedMessages, 2);
+    QVERIFY(queue.size() <= configuration.maxQueueSize);
+
+    QCOMPARE(queue.takeFirst().data, QByteArray("reply 1"));
+    QCOMPARE(queue.takeFirst().data, QByteArray("notification 3"));
+    QVERIFY(queue.isEmpty());
+}
+
+void TestSendQueue::coalesceDisabledForDropOldest()
+{
+    SendQueue::Configuration configuration;
+    configuration.overflowPolicy = SendQueue::OverflowPolicyDropOldest;
+    SendQueue queue(configuration);
+
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "state a 1", "a"));
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "state a 2", "a"));
+
+    QCOMPARE(queue.statistics().queuedMessages, 2);
+    QCOMPARE(queue.statistics().coalescedNotifications, quint64(0));
+}
+
+void TestSendQueue::repliesAreNeverDropped()
+{
+    SendQueue::Configuration configuration;
+    configuration.highWatermark = 100;
+    configuration.lowWatermark = 20;
+    configuration.maxQueueSize = 30;
+    SendQueue queue(configuration);
+
+    // The connection is over its high watermark, so everything ends up in the queue
+    QVERIFY(!queue.canWrite(200));
+
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "notification", "a"));
+    queue.enqueue(message(SendQueue::MessageTypeReply, QByteArray(25, 'r')));
+    queue.enqueue(message(SendQueue::MessageTypeReply, QByteArray(25, 's')));
+
+    // Only the notification is dropped, even though the replies alone exceed the maximum size
+    SendQueue::Statistics statistics = queue.statistics();
+    QCOMPARE(statistics.droppedNotifications, quint64(1));
+    QCOMPARE(statistics.queuedMessages, 2);
+    QCOMPARE(queue.size(), qint64(50));
+
+    // A new notification can't make room for itself at the expense of the replies
+    queue.enqueue(message(SendQueue::MessageTypeNotification, "notification", "a"));
+    QCOMPARE(queue.statistics().droppedNotifications, quint64(2));
+    QCOMPARE(queue.statistics().queuedMessages, 2);
+
+    QVERIFY(!queue.canWrite(50));
+    QVERIFY(queue.canWrite(0));
+    QCOMPARE(queue.takeFirst().data, QByteArray(25, 'r'));
+    QCOMPARE(queue.takeFirst().data, QByteArray(25, 's'));
+    QVERIFY(queue.isEmpty());
+}
+
+#include "testsendqueue.moc"
+QTEST_MAIN(TestSendQueue)
@@ -31,6 +31,7 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "jsonrpc/devicehandler.h"
+#include "nymeasettings.h"
 
 using namespace nymeaserver;
 
@@ -45,6 +46,8 @@ private slots:
     void getStateValue();
 
     void save_load_states();
+
+    void writeBehindStates();
 };
 
 void TestStates::getStateTypes()
@@ -140,5 +143,35 @@ void TestStates::save_load_states()
     QCOMPARE(response.toMap().value("params").toMap().value("value").toBool(), mockDeviceClass.getStateType(mockBoolStateTypeId).defaultValue().toBool());
 }
 
+void TestStates::writeBehindStates()
+{
+    Thing* device = NymeaCore::instance()->thingManager()->findConfiguredThings(mockThingClassId).first();
+    ThingId thingId = device->id();
+    int port = device->paramValue(mockThingHttpportParamTypeId).toInt();
+
+    QString key = QString("%1/%2/value").arg(thingId.toString()).arg(mockIntStateTypeId.toString());
+    int newIntValue = NymeaSettings(NymeaSettings::SettingsRoleThingStates).value(key).toInt() + 42;
+
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(port).arg(mockIntStateTypeId.toString()).arg(newIntValue)));
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    spy.wait();
+    QCOMPARE(device->stateValue(mockIntStateTypeId).toInt(), newIntValue);
+
+    // The change is held back until the sync timer fires
+    QVERIFY(NymeaSettings(NymeaSettings::SettingsRoleThingStates).value(key).toInt() != newIntValue);
+
+    // Shutting down stores it anyway
+    restartServer();
+
+    QVariantMap params;
+    params.insert("deviceId", thingId);
+    params.insert("stateTypeId", mockIntStateTypeId);
+    QVariant response = injectAndWait("Devices.GetStateValue", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("value").toInt(), newIntValue);
+}
+
 #include "teststates.moc"
 QTEST_MAIN(TestStates)
@@ -100,6 +100,8 @@ private slots:
 
     void unauthenticatedCallAfterTokenRemove();
 
+    void unauthenticatedCallAfterUserRemove();
+
     void changePassword();
 
     void authenticateAfterPasswordChangeOK();
@@ -523,5 +525,30 @@ void TestUsermanager::unauthenticatedCallAfterTokenRemove()
     restartServer();
 }
 
+void TestUsermanager::unauthenticatedCallAfterUserRemove()
+{
+    authenticate();
+
+    // Verifies the token for this connection
+    QVariant response = injectAndWait("Users.GetUserInfo");
+    QCOMPARE(response.toMap().value("status").toString(), QString("success"));
+
+    QCOMPARE(NymeaCore::instance()->userManager()->removeUser("valid@user.test"), UserManager::UserErrorNoError);
+    QVERIFY(!NymeaCore::instance()->userManager()->verifyToken(m_apiToken));
+
+    QSignalSpy spy(m_mockTcpServer, &MockTcpServer::connectionTerminated);
+
+    response = injectAndWait("Users.GetUserInfo");
+    QCOMPARE(response.toMap().value("status").toString(), QString("unauthorized"));
+
+    if (spy.count() == 0) {
+        spy.wait();
+    }
+    QVERIFY2(spy.count() == 1, "Connection should be terminated!");
+
+    // need to restart as our connection dies
+    restartServer();
+}
+
 #include "testusermanager.moc"
 QTEST_MAIN(TestUsermanager)
@@ -32,6 +32,7 @@
 #include "nymeacore.h"
 
 #include <QXmlReader>
+#include <QCryptographicHash>
 
 using namespace nymeaserver;
 
@@ -48,6 +49,8 @@ private slots:
 
     void multiPackageMessage();
 
+    void pipelinedRequests();
+
     void checkAllowedMethodCall_data();
     void checkAllowedMethodCall();
 
@@ -57,6 +60,10 @@ private slots:
     void getFiles_data();
     void getFiles();
 
+    void getCachedFiles();
+
+    void getLargeFile();
+
     void getServerDescription();
 
     void getIcons_data();
@@ -194,6 +201,47 @@ void TestWebserver::multiPackageMessage()
     socket->deleteLater();
 }
 
+void TestWebserver::pipelinedRequests()
+{
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TestWebserver::onSslErrors);
+    socket->connectToHostEncrypted("127.0.0.1", 3333);
+    QSignalSpy encryptedSpy(socket, SIGNAL(encrypted()));
+    bool encrypted = encryptedSpy.wait();
+    QVERIFY2(encrypted, "could not created encrypted webserver connection.");
+
+    QSignalSpy disconnectedSpy(socket, SIGNAL(disconnected()));
+
+    // Three requests in one package, the last one asks to close the connection
+    QByteArray requestData;
+    requestData.append("GET /server.xml HTTP/1.1\r\n");
+    requestData.append("User-Agent: nymea webserver test\r\n\r\n");
+    requestData.append("PUT / HTTP/1.1\r\n");
+    requestData.append("User-Agent: nymea webserver test\r\n");
+    requestData.append("Content-Length: 5\r\n\r\n");
+    requestData.append("nymea");
+    requestData.append("GET /server.xml HTTP/1.1\r\n");
+    requestData.append("User-Agent: nymea webserver test\r\n");
+    requestData.append("Connection: close\r\n\r\n");
+
+    quint64 count = socket->write(requestData);
+    QVERIFY2(count > 0, "could not write to webserver.");
+
+    // The server closes the connection after the last reply
+    disconnectedSpy.wait();
+    QVERIFY2(disconnectedSpy.count() == 1, "expected the webserver to close the connection");
+    QByteArray data = socket->readAll();
+
+    QCOMPARE(data.count("HTTP/1.1 200 Ok\r\n"), 2);
+    QCOMPARE(data.count("HTTP/1.1 501 Not Implemented\r\n"), 1);
+    QCOMPARE(data.count("Connection: Keep-Alive\r\n"), 2);
+    QCOMPARE(data.count("Connection: close\r\n"), 1);
+    QVERIFY(data.indexOf("HTTP/1.1 501") < data.lastIndexOf("HTTP/1.1 200"));
+
+    socket->deleteLater();
+}
+
 void TestWebserver::checkAllowedMethodCall_data()
 {
     QTest::addColumn<QString>("method");
@@ -367,6 +415,123 @@ void TestWebserver::getFiles()
     reply->deleteLater();
 }
 
+void TestWebserver::getCachedFiles()
+{
+    // The public folder is the test directory
+    QString fileName = QCoreApplication::applicationDirPath() + "/cachetest.html";
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("<html>Cached</html>");
+    file.close();
+    QFile gzipFile(fileName + ".gz");
+    QVERIFY(gzipFile.open(QFile::WriteOnly | QFile::Truncate));
+    gzipFile.write("gzipped");
+    gzipFile.close();
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request(QUrl("https://localhost:3333/cachetest.html"));
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->readAll(), QByteArray("<html>Cached</html>"));
+    QCOMPARE(reply->header(QNetworkRequest::ContentTypeHeader).toString(), QString("text/html; charset=\"utf-8\";"));
+    QByteArray etag = reply->rawHeader("ETag");
+    QVERIFY(!etag.isEmpty());
+    QVERIFY(reply->hasRawHeader("Last-Modified"));
+    reply->deleteLater();
+
+    // A matching ETag returns 304 without content
+    clientSpy.clear();
+    request.setRawHeader("If-None-Match", etag);
+    reply = nam.get(request);
+    clientSpy.wait();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 304);
+    QCOMPARE(reply->rawHeader("ETag"), etag);
+    QVERIFY(reply->readAll().isEmpty());
+    reply->deleteLater();
+
+    // The precompressed variant is sent if accepted, with its own ETag
+    clientSpy.clear();
+    request.setRawHeader("If-None-Match", etag);
+    request.setRawHeader("Accept-Encoding", "deflate, gzip");
+    reply = nam.get(request);
+    clientSpy.wait();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->rawHeader("Content-Encoding"), QByteArray("gzip"));
+    QVERIFY(reply->rawHeader("ETag") != etag);
+    QCOMPARE(reply->readAll(), QByteArray("gzipped"));
+    reply->deleteLater();
+
+    // Modifying the file invalidates the cached data. The gzip variant is outdated now.
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("<html>Modified</html>");
+    file.close();
+    clientSpy.clear();
+    request.setRawHeader("If-None-Match", etag);
+    reply = nam.get(request);
+    clientSpy.wait();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVERIFY(!reply->hasRawHeader("Content-Encoding"));
+    QVERIFY(reply->rawHeader("ETag") != etag);
+    QCOMPARE(reply->readAll(), QByteArray("<html>Modified</html>"));
+    reply->deleteLater();
+
+    // Updating only the gzip variant invalidates the cached data as well
+    QVERIFY(gzipFile.open(QFile::WriteOnly | QFile::Truncate));
+    gzipFile.write("gzipped again");
+    gzipFile.close();
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->rawHeader("Content-Encoding"), QByteArray("gzip"));
+    QCOMPARE(reply->readAll(), QByteArray("gzipped again"));
+    reply->deleteLater();
+
+    QVERIFY(QFile::remove(fileName));
+    QVERIFY(QFile::remove(fileName + ".gz"));
+}
+
+void TestWebserver::getLargeFile()
+{
+    // Files larger than the asset cache are streamed from disk
+    QString fileName = QCoreApplication::applicationDirPath() + "/largefile.bin";
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    for (int i = 0; i < 160; i++) {
+        QByteArray block(64 * 1024, static_cast<char>(i));
+        hash.addData(block);
+        file.write(block);
+    }
+    file.close();
+
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request(QUrl("https://localhost:3333/largefile.bin"));
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait(20000);
+    QCOMPARE(clientSpy.count(), 1);
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->header(QNetworkRequest::ContentLengthHeader).toLongLong(), file.size());
+    QVERIFY(reply->hasRawHeader("ETag"));
+    QByteArray data = reply->readAll();
+    QCOMPARE(data.size(), file.size());
+    QCOMPARE(QCryptographicHash::hash(data, QCryptographicHash::Md5), hash.result());
+    reply->deleteLater();
+
+    QVERIFY(QFile::remove(fileName));
+}
+
 void TestWebserver::getServerDescription()
 {
     QNetworkAccessManager nam;